@@ -0,0 +1,21 @@
+# Generates the robot geometry header and the leg workspace map from the
+# CONFIG_SPIDER_GEOM_* values (tools/robot_geometry.py), for the app and the
+# tests building the gait sources.
+set(SPIDER_GEOMETRY_DIR ${CMAKE_BINARY_DIR}/spider_geometry)
+set(SPIDER_GEOMETRY_TOOLS ${CMAKE_CURRENT_LIST_DIR}/../tools)
+
+add_custom_command(
+  OUTPUT ${SPIDER_GEOMETRY_DIR}/robot_geometry.h
+         ${SPIDER_GEOMETRY_DIR}/reach_map_data.c
+  COMMAND ${CMAKE_COMMAND} -E make_directory ${SPIDER_GEOMETRY_DIR}
+  COMMAND ${PYTHON_EXECUTABLE} ${SPIDER_GEOMETRY_TOOLS}/robot_geometry.py
+          --config ${DOTCONFIG}
+          --header ${SPIDER_GEOMETRY_DIR}/robot_geometry.h
+          --reach-map ${SPIDER_GEOMETRY_DIR}/reach_map_data.c
+  DEPENDS ${DOTCONFIG} ${SPIDER_GEOMETRY_TOOLS}/robot_geometry.py
+          ${SPIDER_GEOMETRY_TOOLS}/reach_map.py
+  COMMENT "Generating the robot geometry")
+
+target_sources(app PRIVATE ${SPIDER_GEOMETRY_DIR}/robot_geometry.h
+                           ${SPIDER_GEOMETRY_DIR}/reach_map_data.c)
+target_include_directories(app PRIVATE ${SPIDER_GEOMETRY_DIR})
@@ -0,0 +1,27 @@
+#ifndef BOOT_REPORT_H
+#define BOOT_REPORT_H
+
+#include <stdint.h>
+
+/**
+ * @brief Milestones from power-on to the first command, in boot order
+ */
+enum boot_stage
+{
+        BOOT_STAGE_MAIN,          // main() entered
+        BOOT_STAGE_STATE,         // robot state initialised
+        BOOT_STAGE_SERVOS,        // PWM driver ready
+        BOOT_STAGE_STANCE,        // safe stance set, motion threads released
+        BOOT_STAGE_WIFI,          // associated to the access point
+        BOOT_STAGE_IPV4,          // IPv4 address configured
+        BOOT_STAGE_LISTENING,     // TCP server accepting connections
+        BOOT_STAGE_FIRST_COMMAND, // first command accepted
+        BOOT_STAGE_COUNT,
+};
+
+void boot_mark(enum boot_stage stage);
+int64_t boot_stage_us(enum boot_stage stage);
+const char* boot_stage_name(enum boot_stage stage);
+void boot_report_log(void);
+
+#endif // !BOOT_REPORT_H
@@ -0,0 +1,28 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include "spider_robot.h"
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+struct cmd_queue_stats
+{
+        uint32_t queued;
+        uint32_t coalesced;
+        uint32_t dropped;   // refused, the lane stayed full
+        uint32_t cancelled; // flushed by a stop command
+        uint32_t pending[CMD_LANE_COUNT];
+        uint32_t high_water[CMD_LANE_COUNT];
+};
+
+int cmd_queue_put(const struct tcp_command* cmd, enum cmd_lane lane,
+                  k_timeout_t timeout, uint32_t* merged_id);
+int cmd_queue_get(struct tcp_command* cmd, k_timeout_t timeout);
+int cmd_queue_wait_urgent(k_timeout_t timeout);
+void cmd_queue_flush(enum cmd_lane lane,
+                     void (*on_drop)(const struct tcp_command* cmd));
+void cmd_queue_count_dropped(void);
+void cmd_queue_get_stats(struct cmd_queue_stats* stats);
+void cmd_queue_reset_stats(void);
+
+#endif // !COMMAND_QUEUE_H
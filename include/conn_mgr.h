@@ -0,0 +1,33 @@
+#ifndef CONN_MGR_H
+#define CONN_MGR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+enum conn_state
+{
+        CONN_DISCONNECTED, // waiting for the next attempt (backoff)
+        CONN_CONNECTING,   // link requested, waiting for it to come up
+        CONN_WAIT_IPV4,    // link up, waiting for an address
+        CONN_READY,        // sockets can be bound
+};
+
+struct conn_mgr_stats
+{
+        uint32_t attempts;
+        uint32_t failures;
+        uint32_t link_losses;
+        int64_t last_recovery_us; // from link loss to ready again
+        int64_t max_recovery_us;
+};
+
+void conn_mgr_start(void);
+int conn_mgr_wait_ready(k_timeout_t timeout);
+bool conn_mgr_is_ready(void);
+uint32_t conn_mgr_generation(void);
+enum conn_state conn_mgr_state(void);
+uint32_t conn_mgr_backoff_ms(uint32_t attempt);
+void conn_mgr_get_stats(struct conn_mgr_stats* stats);
+
+#endif // !CONN_MGR_H
@@ -0,0 +1,50 @@
+#ifndef GAIT_ASSET_H
+#define GAIT_ASSET_H
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Commands running a stored gait: "g.<name> [times]"
+#define GAIT_ASSET_PREFIX "g."
+#define GAIT_ASSET_NAME_SIZE 12
+
+/**
+ * @brief A gait stored in flash, as listed
+ */
+struct gait_asset_info
+{
+        char name[GAIT_ASSET_NAME_SIZE];
+        uint32_t size;      // header and keyframes, bytes
+        uint16_t keyframes; // per repetition
+};
+
+#if defined(CONFIG_SPIDER_GAIT_ASSETS)
+
+int gait_asset_store(const uint8_t* data, size_t len,
+                     struct gait_asset_info* info);
+int gait_asset_upload_start(size_t size);
+int gait_asset_upload_append(const uint8_t* data, size_t len);
+int gait_asset_upload_commit(struct gait_asset_info* info);
+int gait_asset_foreach(void (*fn)(const struct gait_asset_info* info,
+                                  void* arg),
+                       void* arg);
+int gait_asset_erase(void);
+const char* gait_asset_command(const char* command);
+int gait_asset_run(const char* name, unsigned int step);
+
+#else
+
+// Compiled out: no command names a stored gait
+static inline const char* gait_asset_command(const char* command)
+{
+    return NULL;
+}
+static inline int gait_asset_run(const char* name, unsigned int step)
+{
+    return -ENOTSUP;
+}
+
+#endif // CONFIG_SPIDER_GAIT_ASSETS
+
+#endif // !GAIT_ASSET_H
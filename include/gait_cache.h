@@ -0,0 +1,56 @@
+#ifndef GAIT_CACHE_H
+#define GAIT_CACHE_H
+
+#include "servos.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Memory used by the compiled gaits and what they saved so far
+ */
+struct gait_cache_stats
+{
+        uint32_t clips;      // steps compiled
+        uint32_t frames;     // servo frames stored, NB_SERVOS bytes each
+        uint32_t bytes;      // frames and clip descriptors
+        uint32_t compile_us; // time taken by gait_cache_compile()
+        uint32_t plays;      // steps played from the cache
+        uint32_t misses;     // steps of a cached gait computed live
+        uint32_t ik_saved;   // IK calls the plays did not run
+};
+
+#if defined(CONFIG_SPIDER_GAIT_CACHE)
+
+void gait_cache_compile(void);
+void gait_cache_run(void (*gait)(unsigned int), unsigned int step);
+void gait_cache_enable(bool enable);
+bool gait_cache_recording(void);
+void gait_cache_record_reach(void);
+bool gait_cache_next_frame(uint8_t frame[NB_LEGS][NB_JOINTS],
+                           uint32_t* moving_legs);
+bool gait_cache_playing(void);
+void gait_cache_get_stats(struct gait_cache_stats* stats);
+void gait_cache_invalidate(void);
+
+#else
+
+// Compiled out: every gait is computed live
+static inline void gait_cache_compile(void) {}
+static inline void gait_cache_run(void (*gait)(unsigned int),
+                                  unsigned int step)
+{
+    gait(step);
+}
+static inline bool gait_cache_recording(void) { return false; }
+static inline void gait_cache_record_reach(void) {}
+static inline bool gait_cache_next_frame(uint8_t frame[NB_LEGS][NB_JOINTS],
+                                         uint32_t* moving_legs)
+{
+    return false;
+}
+static inline bool gait_cache_playing(void) { return false; }
+static inline void gait_cache_invalidate(void) {}
+
+#endif // CONFIG_SPIDER_GAIT_CACHE
+
+#endif // !GAIT_CACHE_H
@@ -0,0 +1,52 @@
+#ifndef LOG_LIMIT_H
+#define LOG_LIMIT_H
+
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+/**
+ * @brief Occurrences of a recurring error at one call site
+ */
+struct log_limit
+{
+        int64_t next_ms; // reports suppressed until this uptime
+        uint32_t count;  // occurrences since the last report
+};
+
+/**
+ * @brief counts an occurrence of the error. Each call site is hit from a
+ * single thread.
+ *
+ * @return the occurrences to report now, 0 if the last report is more recent
+ * than CONFIG_SPIDER_LOG_LIMIT_MS
+ */
+static inline uint32_t log_limit_hit(struct log_limit* limit)
+{
+    int64_t now_ms = k_uptime_get();
+
+    limit->count++;
+    if (now_ms < limit->next_ms)
+        return 0;
+
+    uint32_t count = limit->count;
+    limit->count = 0;
+    limit->next_ms = now_ms + CONFIG_SPIDER_LOG_LIMIT_MS;
+    return count;
+}
+
+/**
+ * @brief logs an error that can repeat on every motor tick at most once per
+ * CONFIG_SPIDER_LOG_LIMIT_MS, with the number of times it happened since the
+ * previous report. The counter belongs to the calling line.
+ */
+#define LOG_ERR_LIMITED(fmt, ...)                                              \
+    do                                                                         \
+    {                                                                          \
+        static struct log_limit _log_limit;                                    \
+        uint32_t _count = log_limit_hit(&_log_limit);                          \
+        if (_count > 0)                                                        \
+            LOG_ERR(fmt " (%u times)", ##__VA_ARGS__, _count);                 \
+    } while (0)
+
+#endif // !LOG_LIMIT_H
@@ -0,0 +1,71 @@
+#ifndef PROFILING_H
+#define PROFILING_H
+
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+/**
+ * @brief Phases of the motor tick and stages of the command latency, timed
+ * with the cycle counter
+ */
+enum prof_phase
+{
+        PROF_TICK_PERIOD, // start of a tick to the start of the next one
+        PROF_TICK,        // whole tick, mutex wait included
+        PROF_MUTEX_WAIT,  // waiting for g_state_mutex
+        PROF_IK,          // cartesian_to_polar() for the 4 legs
+        PROF_SERVO_WRITE, // servo writes (I2C) of the 4 legs
+        // Latency of a command, stage by stage from its reception
+        PROF_LAT_ENQUEUE,     // received by the server -> queued
+        PROF_LAT_DEQUEUE,     // queued -> taken by the gait thread
+        PROF_LAT_FIRST_SITE,  // taken -> first set_site()
+        PROF_LAT_FIRST_SERVO, // first set_site() -> first servo moved
+        PROF_LAT_TOTAL,       // received -> first servo moved
+        PROF_PHASE_COUNT,
+};
+
+struct prof_summary
+{
+        uint32_t count;
+        uint32_t min_ns;
+        uint32_t max_ns;
+        uint32_t mean_ns;
+        uint32_t p99_ns; // upper bound of the bucket holding the 99th pct
+};
+
+#if defined(CONFIG_SPIDER_PROFILING)
+
+static inline uint32_t prof_start(void) { return k_cycle_get_32(); }
+
+/**
+ * @brief cycles elapsed since prof_start(), wraps correctly.
+ */
+static inline uint32_t prof_elapsed(uint32_t start)
+{
+    return k_cycle_get_32() - start;
+}
+
+void prof_add(enum prof_phase phase, uint32_t cycles);
+void prof_cmd_dequeued(uint32_t rx_cycles, uint32_t enqueued_cycles);
+void prof_first_site(void);
+void prof_first_servo(void);
+void prof_get(enum prof_phase phase, struct prof_summary* summary);
+void prof_reset(void);
+const char* prof_phase_name(enum prof_phase phase);
+
+#else
+
+// Compiled out: the calls and the cycle counter reads vanish
+static inline uint32_t prof_start(void) { return 0; }
+static inline uint32_t prof_elapsed(uint32_t start) { return 0; }
+static inline void prof_add(enum prof_phase phase, uint32_t cycles) {}
+static inline void prof_cmd_dequeued(uint32_t rx_cycles,
+                                     uint32_t enqueued_cycles)
+{
+}
+static inline void prof_first_site(void) {}
+static inline void prof_first_servo(void) {}
+
+#endif // CONFIG_SPIDER_PROFILING
+
+#endif // !PROFILING_H
@@ -0,0 +1,26 @@
+#ifndef REACH_MAP_H
+#define REACH_MAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Grid of the leg workspace map generated by tools/reach_map.py. A
+ * cell covers cell_mm in w, the horizontal distance of the foot signed by x,
+ * and in z.
+ */
+struct reach_map_info
+{
+        double length_a, length_b, length_c; // Leg it was computed for
+        int w_min, z_min;                    // Corner of the grid, mm
+        int cell_mm;
+        int cols, rows;
+};
+
+extern const struct reach_map_info reach_map_info;
+extern const uint32_t reach_map_bits[];
+
+int reach_map_init(double length_a, double length_b, double length_c);
+bool reach_map_reachable(double x, double y, double z);
+
+#endif // !REACH_MAP_H
@@ -0,0 +1,33 @@
+#ifndef ROBOT_SETTINGS_H
+#define ROBOT_SETTINGS_H
+
+#include <stdbool.h>
+
+/**
+ * @brief A tunable parameter of g_config, as listed
+ */
+struct robot_param_value
+{
+        const char* name;
+        double value;   // in use
+        double pending; // applied before the next command
+        bool is_pending;
+};
+
+#if defined(CONFIG_SPIDER_SETTINGS)
+
+int robot_settings_init(void);
+int robot_settings_set(const char* name, double value);
+int robot_settings_reset(void);
+int robot_settings_get(int index, struct robot_param_value* param);
+void robot_settings_apply(void);
+
+#else
+
+// Compiled out: g_config keeps the values it was built with
+static inline int robot_settings_init(void) { return 0; }
+static inline void robot_settings_apply(void) {}
+
+#endif // CONFIG_SPIDER_SETTINGS
+
+#endif // !ROBOT_SETTINGS_H
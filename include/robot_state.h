@@ -12,54 +12,93 @@ extern const double KEEP;
 extern struct k_mutex g_state_mutex;
 extern struct k_sem motion_finished;
 
+// Posted once the robot holds its boot stance, motion threads wait on it
+#define ROBOT_READY BIT(0)
+extern struct k_event robot_ready;
+
+// Tunable at runtime with CONFIG_SPIDER_SETTINGS, const in flash otherwise
+#if defined(CONFIG_SPIDER_SETTINGS)
+#define ROBOT_TUNABLE
+#else
+#define ROBOT_TUNABLE const
+#endif
+
 /**
- * @typedef robot_state_t
- * @brief structure to hold global configs and leg positions
- *
+ * @brief Dimensions of the robot and gait parameters. The link lengths come
+ * first, the motor tick reads them on every IK and they share a cache line.
+ * Only the posture and speeds are tunable (robot_settings.c), the lengths are
+ * fixed by the hardware.
  */
-typedef struct robot_state_t
+struct robot_config
 {
-
-        // --- IMMUTABLE CONSTANTS (Calculated at Runtime, but fixed) ---
-        // Physical Dimensions (Read-only once initialized)
+        // Physical dimensions
         double length_a, length_b, length_c;
         double length_side, z_absolute;
 
-        // Movement Parameters (Read-only once initialized)
-        double z_default, z_up, z_boot;
+        // Movement parameters
+        double z_default, z_up;
         double x_default, x_offset;
         double y_start, y_step;
 
-        // Derived Turn Constants (Calculated in init function)
-        double temp_a, temp_b, temp_c;
-        double temp_alpha;
-        double turn_x0, turn_y0, turn_x1, turn_y1;
-
-        // Speed Constants
+        // Speeds
         double speed_multiple;
         double spot_turn_speed;
         double leg_move_speed;
-
         double body_move_speed;
         double stand_seat_speed;
+};
 
-        // --- MUTABLE STATE (Volatile variables used by Control Thread) ---
-         double site_now[4][3];    // Real-time coordinates
-         double site_expect[4][3]; // Expected coordinates
-
-        double temp_speed[4][3]; // Each axis' speed
-        double move_speed;
+/**
+ * @brief Constants derived from the config, generated at build time by
+ * tools/robot_geometry.py and recomputed by robot_derive() when the posture
+ * is tuned
+ */
+struct robot_derived
+{
+        double z_boot;
 
-        // Marker to ensure initialization has run
-        bool initialized;
+        // Turn sites
+        double temp_a, temp_b, temp_c;
+        double temp_alpha;
+        double turn_x0, turn_y0, turn_x1, turn_y1;
+};
 
+/**
+ * @typedef robot_state_t
+ * @brief motion state shared by the gait thread, which sets the targets, and
+ * the motor tick, which moves the legs towards them. Protected by
+ * g_state_mutex. Only mutable data lives here, the arrays the motor tick walks
+ * first, so that it stays compact and a snapshot is a single copy.
+ */
+typedef struct robot_state_t
+{
+        double site_now[4][3];    // Real-time coordinates
+        double site_expect[4][3]; // Expected coordinates
+        double temp_speed[4][3];  // Each axis' speed
+        double move_speed;
+        uint32_t keyframe; // Bumped each time all the legs reach their target
+
+        // Joint space moves (set_site_joint()): alpha, beta, gamma in degrees
+        uint32_t joint_ticks[4]; // Ticks left to reach joint_expect
+        bool joint_mode[4];      // Leg follows the joint angles, not the sites
+        double joint_now[4][3];
+        double joint_expect[4][3];
+        double joint_speed[4][3];
 } robot_state_t;
 
-// --- GLOBAL INSTANCE DECLARATION ---
+// --- GLOBAL INSTANCES ---
+extern ROBOT_TUNABLE struct robot_config g_config;
+extern ROBOT_TUNABLE struct robot_derived g_derived;
 extern robot_state_t g_state;
 
 void init_robot_state(void);
 void print_robot_state(void);
-void set_site(int leg, double x, double y, double z);
+void robot_state_snapshot(robot_state_t* snapshot);
+#if defined(CONFIG_SPIDER_SETTINGS)
+extern const struct robot_config robot_config_default;
+void robot_derive(const struct robot_config* config,
+                  struct robot_derived* derived);
+#endif
+int set_site(int leg, double x, double y, double z);
 
 #endif
@@ -18,3 +18,6 @@
 int init_servos(void);
 void set_angle(uint8_t leg_id, uint8_t joint_id, uint8_t angle);
 void center_all_servos(void);
+void commit_servo_frame(void);
+void relax_all_servos(void);
+void resume_servos(void);
@@ -0,0 +1,26 @@
+#ifndef SERVOS_SIM_H
+#define SERVOS_SIM_H
+
+#include "servos.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Last angle written to each joint by the simulated backend
+ */
+extern uint8_t servo_sim_angles[NB_LEGS][NB_JOINTS];
+extern uint32_t servo_sim_writes;
+extern uint32_t servo_sim_frames;
+extern bool servo_sim_relaxed; // between relax_all_servos() and resume_servos()
+// Time every frame takes to be written, a stalled I2C bus when not 0
+extern uint32_t servo_sim_stall_ms;
+
+/**
+ * @brief Called with the joint angles at the end of every motor tick
+ */
+typedef void (*servo_frame_hook_t)(
+    const uint8_t angles[NB_LEGS][NB_JOINTS]);
+
+void servo_sim_set_frame_hook(servo_frame_hook_t hook);
+
+#endif // !SERVOS_SIM_H
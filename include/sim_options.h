@@ -0,0 +1,10 @@
+#ifndef SIM_OPTIONS_H
+#define SIM_OPTIONS_H
+
+/**
+ * @brief native_sim command line options, NULL when not given
+ */
+extern char* sim_frames_path; // --frames=<file>: per tick joint angles (CSV)
+extern char* sim_commands;    // --cmds="sf 2;tl 1": run then exit
+
+#endif // !SIM_OPTIONS_H
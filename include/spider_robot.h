@@ -1,11 +1,18 @@
 #ifndef GAIT
 #define GAIT
 
+#include "servos.h"
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
 /*=====================================================================*
  *                       Gait moves & cmds
  *=====================================================================*/
-void set_site(int leg, double x, double y, double z);
+int set_site(int leg, double x, double y, double z);
+int set_site_joint(int leg, double x, double y, double z);
+bool all_legs_reached(void);
 void wait_all_reach(void);
+void init_stance(void);
 
 void sit(unsigned int step);
 void stand(unsigned int step);
@@ -15,30 +22,210 @@ void turn_right(unsigned int step);
 void step_back(unsigned int step);
 void hand_shake(unsigned int step);
 void hand_wave(unsigned int step);
+void end_keyframes(void);
+void safe_stance(void);
+
+// Gestures, in mm: the body leans away from the raised leg
+#define GESTURE_BODY_SHIFT 15
+#define WAVE_Z 50.0
+#define SHAKE_X_BACK 30.0
+#define SHAKE_Z_UP 55.0
+#define SHAKE_Z_DOWN 10.0
+
+void begin_command(void);
+void cancel_command(void);
+bool command_cancelled(void);
+bool end_command(void);
+
+/**
+ * @brief Priority lanes of the command queue, served in declaration order
+ */
+enum cmd_lane
+{
+        CMD_LANE_URGENT, // stop / pose changes
+        CMD_LANE_NORMAL, // walking gaits
+        CMD_LANE_LOW,    // gestures
+        CMD_LANE_COUNT,
+};
 
 struct cmd_entry
 {
         const char* name;
         void (*fn)(unsigned int step);
+        enum cmd_lane lane;
 };
 
+const struct cmd_entry* find_command(const char* name);
+
 /*=====================================================================*
  *                          TCP command
  *=====================================================================*/
 #define RX_BUF_SIZE 32
 
+/**
+ * @brief Outcome reported to the client for every command it sends
+ */
+enum cmd_ack
+{
+        CMD_ACK_ACCEPTED,
+        CMD_ACK_REJECTED,
+        CMD_ACK_QUEUE_FULL,
+        CMD_ACK_COALESCED,
+        CMD_ACK_FAULTED,
+};
+
 struct tcp_command
 {
         char command[RX_BUF_SIZE];
         int times;
+        uint32_t id;           // Sequence number echoed back in ACK/DONE
+        int64_t enqueued_us;   // Uptime when the command entered the queue
+        int64_t execute_at_us; // Uptime at which to start, 0 for asap
+        uint32_t rx_cycles;       // Cycle count when its bytes were received
+        uint32_t enqueued_cycles; // Cycle count when it entered the queue
+};
+
+/**
+ * @brief Posted by the gait thread once a command has been executed
+ */
+struct cmd_completion
+{
+        char command[RX_BUF_SIZE];
+        uint32_t id;
+        int64_t enqueued_us;
+        int64_t started_us;
+        int64_t finished_us;
+        bool cancelled;    // Dropped by a stop command or cut by a safe stop
+        uint32_t ik_calls; // Inverse kinematics solved while it ran
 };
-extern struct k_msgq tcp_command_q;
+extern struct k_msgq cmd_completion_q;
+
+static inline int64_t cmd_timestamp_us(void)
+{
+        return (int64_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+extern uint16_t tcp_server_port;
+
+/*=====================================================================*
+ *                            Threads
+ *=====================================================================*/
+#if defined(CONFIG_SPIDER_SMP_PINNING)
+// Started by main() once pinned to their core
+#define SPIDER_THREAD_DELAY SYS_FOREVER_MS
+#else
+#define SPIDER_THREAD_DELAY 0
+#endif
+
+#if defined(CONFIG_SPIDER_SCHED_EDF)
+// One static priority, the threads are ordered by their deadlines
+#define SPIDER_EDF_PRIORITY 5
+
+/**
+ * @brief sets the deadline of the calling thread, an uptime in us. Once
+ * passed, it makes the thread the most urgent of its priority.
+ */
+static inline void sched_deadline_at(int64_t deadline_us)
+{
+    int64_t delay_us = MAX(deadline_us - cmd_timestamp_us(), 1);
+
+    k_thread_deadline_set(k_current_get(),
+                          (int)k_us_to_cyc_ceil32((uint32_t)delay_us));
+}
+
+#else
+
+// Fixed priorities: the deadlines are only accounted
+static inline void sched_deadline_at(int64_t deadline_us) {}
+
+#endif // CONFIG_SPIDER_SCHED_EDF
+
+extern const k_tid_t motor_thread_id;
+extern const k_tid_t gait_thread_id;
+extern const k_tid_t tcp_server_thread_id;
+
+/*=====================================================================*
+ *                          Motor loop
+ *=====================================================================*/
+void motors_align_phase(int64_t origin_us);
+int64_t motors_next_tick_us(int64_t after_us);
+
+/**
+ * @brief Deadlines met and missed by the control threads, whatever the
+ * scheduling: a tick must end before the next tick starts, a keyframe must be
+ * written before the tick following the one reaching the previous keyframe
+ */
+struct deadline_stats
+{
+        uint32_t ticks;
+        uint32_t tick_misses;
+        uint32_t keyframes;
+        uint32_t keyframe_misses;
+};
+
+void motors_count_keyframe(bool missed);
+void motors_get_deadline_stats(struct deadline_stats* stats);
+void motors_reset_deadline_stats(void);
+
+/**
+ * @brief Motor ticks that missed their deadline, and the safe stops they
+ * caused
+ */
+struct tick_monitor_stats
+{
+        uint32_t late;    // ended after the next tick was due
+        uint32_t skipped; // not run at all, mutex timeout or overrun
+        uint32_t streak;  // late or skipped in a row, 0 once on time
+        uint32_t faults;  // safe stops
+        bool faulted;     // motion commands refused
+};
+
+#if defined(CONFIG_SPIDER_TICK_MONITOR)
+
+bool motors_faulted(void);
+void motors_get_monitor_stats(struct tick_monitor_stats* stats);
+
+#else
+
+// Compiled out: the gaits go on whatever the ticks
+static inline bool motors_faulted(void) { return false; }
+
+#endif // CONFIG_SPIDER_TICK_MONITOR
+
+/**
+ * @brief Time the motor thread spent without ticking, the servos holding or
+ * relaxed
+ */
+struct motors_idle_stats
+{
+        uint32_t entries;       // quiet periods that stopped the ticks
+        uint64_t idle_us;       // the current one included
+        uint64_t ticks_skipped; // NB_SERVOS PWM writes each
+        bool idle;
+};
+
+#if defined(CONFIG_SPIDER_IDLE)
+
+void motors_wake(void);
+void motors_get_idle_stats(struct motors_idle_stats* stats);
+
+#else
+
+// Compiled out: the motor thread ticks forever
+static inline void motors_wake(void) {}
+
+#endif // CONFIG_SPIDER_IDLE
 
 /*=====================================================================*
  *                           Kinematics
  *=====================================================================*/
 void cartesian_to_polar(double* alpha, double* beta, double* gamma, double x,
                         double y, double z);
+void polar_to_cartesian(double* x, double* y, double* z, double alpha,
+                        double beta, double gamma);
 void polar_to_servo(int leg, double alpha, double beta, double gamma);
+uint32_t motors_step(uint8_t frame[NB_LEGS][NB_JOINTS], bool* moved);
+uint32_t motors_tick(void);
+uint32_t ik_call_count(void);
 
 #endif // !GAIT
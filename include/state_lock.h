@@ -0,0 +1,51 @@
+#ifndef STATE_LOCK_H
+#define STATE_LOCK_H
+
+#include "robot_state.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+/**
+ * @brief g_state_mutex usage accounted to one state_lock() call site
+ */
+struct lock_site_stats
+{
+        const char* file;
+        int line;
+        uint32_t acquired;
+        uint32_t timeouts; // state_lock() gave up waiting
+        uint64_t wait_cycles;
+        uint32_t max_wait_cycles;
+        uint64_t hold_cycles;
+        uint32_t max_hold_cycles;
+        bool registered;
+};
+
+#if defined(CONFIG_SPIDER_LOCK_STATS)
+
+int state_lock_at(struct lock_site_stats* site, k_timeout_t timeout);
+int state_unlock_at(void);
+int lock_stats_worst(struct lock_site_stats* worst, int max);
+void lock_stats_reset(void);
+
+/**
+ * @brief takes g_state_mutex, the wait and the hold time are accounted to the
+ * calling line.
+ */
+#define state_lock(timeout)                                                    \
+    ({                                                                         \
+        static struct lock_site_stats _lock_site = {.file = __FILE__,          \
+                                                    .line = __LINE__};         \
+        state_lock_at(&_lock_site, timeout);                                   \
+    })
+#define state_unlock() state_unlock_at()
+
+#else
+
+#define state_lock(timeout) k_mutex_lock(&g_state_mutex, timeout)
+#define state_unlock() k_mutex_unlock(&g_state_mutex)
+
+#endif // CONFIG_SPIDER_LOCK_STATS
+
+#endif // !STATE_LOCK_H
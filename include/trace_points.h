@@ -0,0 +1,35 @@
+#ifndef TRACE_POINTS_H
+#define TRACE_POINTS_H
+
+/*
+ * Named events marking the progress of a gait, emitted through the Zephyr
+ * tracing backend (CTF) when CONFIG_SPIDER_TRACE_POINTS is set and compiled
+ * out otherwise. tools/gait_trace.py rebuilds the timeline from them, the
+ * names below are what it looks for.
+ */
+#if defined(CONFIG_SPIDER_TRACE_POINTS)
+#include <zephyr/tracing/tracing.h>
+#define TRACE_POINT(name, arg0, arg1)                                          \
+    sys_trace_named_event(name, (uint32_t)(arg0), (uint32_t)(arg1))
+#else
+#define TRACE_POINT(name, arg0, arg1)                                          \
+    do                                                                         \
+    {                                                                          \
+        (void)(arg0);                                                          \
+        (void)(arg1);                                                          \
+    } while (0)
+#endif
+
+// Gait thread: new target for a leg, part of keyframe `kf`
+#define TRACE_KEYFRAME_SET(leg, kf) TRACE_POINT("keyframe_set", leg, kf)
+// Motor thread: a leg arrived on the target of keyframe `kf`
+#define TRACE_TARGET_REACHED(leg, kf) TRACE_POINT("target_reached", leg, kf)
+// Gait thread: saw every leg on target and resumes the gait
+#define TRACE_GAIT_WAKE(kf) TRACE_POINT("gait_wake", kf, 0)
+// Gait thread: took a command out of the queue / finished it
+#define TRACE_CMD_DEQUEUED(id, times) TRACE_POINT("cmd_dequeued", id, times)
+#define TRACE_CMD_DONE(id) TRACE_POINT("cmd_done", id, 0)
+// Motor thread: servos written for tick `tick`, `moving` legs not on target
+#define TRACE_SERVO_FRAME(tick, moving) TRACE_POINT("servo_frame", tick, moving)
+
+#endif // !TRACE_POINTS_H
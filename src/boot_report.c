@@ -0,0 +1,67 @@
+/*======================================================================
+ * File:    boot_report.c
+ * Date:    2026-10-19
+ * Purpose: Records the uptime at which each boot milestone is reached so the
+ *time from power-on to accepting the first command can be broken down and
+ *compared between firmware versions.
+ *====================================================================*/
+#include "boot_report.h"
+#include "spider_robot.h"
+#include "zephyr/kernel.h"
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(boot_report, CONFIG_SPIDER_LOG_LEVEL);
+
+static const char* const stage_names[BOOT_STAGE_COUNT] = {
+    [BOOT_STAGE_MAIN] = "main",
+    [BOOT_STAGE_STATE] = "state",
+    [BOOT_STAGE_SERVOS] = "servos",
+    [BOOT_STAGE_STANCE] = "stance",
+    [BOOT_STAGE_WIFI] = "wifi",
+    [BOOT_STAGE_IPV4] = "ipv4",
+    [BOOT_STAGE_LISTENING] = "listening",
+    [BOOT_STAGE_FIRST_COMMAND] = "first_command",
+};
+
+// 0 means not reached yet
+static int64_t stage_us[BOOT_STAGE_COUNT];
+
+/**
+ * @brief records the first time a stage is reached, later calls (e.g. after a
+ * WiFi reconnection) are ignored.
+ */
+void boot_mark(enum boot_stage stage)
+{
+    if (stage_us[stage] != 0)
+        return;
+
+    stage_us[stage] = MAX(cmd_timestamp_us(), 1);
+    if (stage == BOOT_STAGE_FIRST_COMMAND)
+        boot_report_log();
+}
+
+int64_t boot_stage_us(enum boot_stage stage) { return stage_us[stage]; }
+
+const char* boot_stage_name(enum boot_stage stage)
+{
+    return stage_names[stage];
+}
+
+void boot_report_log(void)
+{
+    int64_t previous = 0;
+
+    LOG_INF("--- Boot time breakdown ---");
+    for (int stage = 0; stage < BOOT_STAGE_COUNT; stage++)
+    {
+        if (stage_us[stage] == 0)
+        {
+            LOG_INF("  %-14s not reached", stage_names[stage]);
+            continue;
+        }
+        // Network and motion stages overlap, deltas are between milestones
+        LOG_INF("  %-14s %8lld us (+%lld us)", stage_names[stage],
+                stage_us[stage], stage_us[stage] - previous);
+        previous = stage_us[stage];
+    }
+}
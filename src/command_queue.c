@@ -0,0 +1,236 @@
+/*======================================================================
+ * File:    command_queue.c
+ * Date:    2026-10-19
+ * Purpose: Replaces the single drop-on-full message queue between the TCP
+ *server and the gait thread with one bounded lane per priority. Urgent
+ *commands are always served first, a gait repeated while still pending is
+ *merged into the waiting one and producers block (instead of dropping) while
+ *their lane is full.
+ *====================================================================*/
+#include "command_queue.h"
+#include "zephyr/kernel.h"
+#include "zephyr/sys/util.h"
+#include <errno.h>
+#include <string.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(command_queue, CONFIG_SPIDER_LOG_LEVEL);
+
+// The lane depths are at most 255 (Kconfig.spider)
+struct lane_ring
+{
+    struct tcp_command* slots;
+    uint8_t depth;
+    uint8_t head;
+    uint8_t count;
+};
+
+static struct tcp_command urgent_slots[CONFIG_SPIDER_CMD_URGENT_DEPTH];
+static struct tcp_command normal_slots[CONFIG_SPIDER_CMD_NORMAL_DEPTH];
+static struct tcp_command low_slots[CONFIG_SPIDER_CMD_LOW_DEPTH];
+
+static struct lane_ring lanes[CMD_LANE_COUNT] = {
+    [CMD_LANE_URGENT] = {urgent_slots, ARRAY_SIZE(urgent_slots)},
+    [CMD_LANE_NORMAL] = {normal_slots, ARRAY_SIZE(normal_slots)},
+    [CMD_LANE_LOW] = {low_slots, ARRAY_SIZE(low_slots)},
+};
+
+static struct cmd_queue_stats stats;
+
+static K_MUTEX_DEFINE(queue_lock);
+static K_CONDVAR_DEFINE(queue_not_empty);
+static K_CONDVAR_DEFINE(queue_not_full);
+
+static struct tcp_command* lane_tail(struct lane_ring* ring)
+{
+    if (ring->count == 0)
+        return NULL;
+    return &ring->slots[(ring->head + ring->count - 1) % ring->depth];
+}
+
+/**
+ * @brief merges cmd into the last pending command of the lane if it is the
+ * same gait and the summed repeat count stays within bounds.
+ *
+ * @return true if the command was absorbed
+ */
+static bool try_coalesce(struct lane_ring* ring, enum cmd_lane lane,
+                         const struct tcp_command* cmd)
+{
+    struct tcp_command* tail = lane_tail(ring);
+
+    if (lane == CMD_LANE_URGENT || tail == NULL)
+        return false;
+    // Scheduled commands must start on their own
+    if (tail->execute_at_us != 0 || cmd->execute_at_us != 0)
+        return false;
+    if (strcmp(tail->command, cmd->command) != 0)
+        return false;
+    if (tail->times + cmd->times > CONFIG_SPIDER_CMD_COALESCE_MAX_TIMES)
+        return false;
+
+    tail->times += cmd->times;
+    return true;
+}
+
+/**
+ * @brief queues a command in its lane, waiting up to timeout for room.
+ *
+ * @param cmd
+ * @param lane
+ * @param timeout how long the producer accepts to be held back
+ * @param merged_id set to the id of the pending command cmd was merged into
+ * @return 0 if queued, 1 if coalesced, -EAGAIN if the lane stayed full, the
+ * caller may try again or give up with cmd_queue_count_dropped()
+ */
+int cmd_queue_put(const struct tcp_command* cmd, enum cmd_lane lane,
+                  k_timeout_t timeout, uint32_t* merged_id)
+{
+    struct lane_ring* ring = &lanes[lane];
+    int ret = 0;
+
+    k_mutex_lock(&queue_lock, K_FOREVER);
+
+    if (try_coalesce(ring, lane, cmd))
+    {
+        if (merged_id != NULL)
+            *merged_id = lane_tail(ring)->id;
+        stats.coalesced++;
+        ret = 1;
+        goto out;
+    }
+
+    while (ring->count == ring->depth)
+    {
+        if (k_condvar_wait(&queue_not_full, &queue_lock, timeout) != 0)
+        {
+            ret = -EAGAIN;
+            goto out;
+        }
+        // The gait thread may have left a mergeable command behind
+        if (try_coalesce(ring, lane, cmd))
+        {
+            if (merged_id != NULL)
+                *merged_id = lane_tail(ring)->id;
+            stats.coalesced++;
+            ret = 1;
+            goto out;
+        }
+    }
+
+    ring->slots[(ring->head + ring->count) % ring->depth] = *cmd;
+    ring->count++;
+    stats.queued++;
+    stats.high_water[lane] = MAX(stats.high_water[lane], ring->count);
+    k_condvar_signal(&queue_not_empty);
+
+out:
+    k_mutex_unlock(&queue_lock);
+    return ret;
+}
+
+/**
+ * @brief pops the oldest command of the highest priority non-empty lane.
+ *
+ * @return 0 on success, -EAGAIN if nothing arrived before timeout
+ */
+int cmd_queue_get(struct tcp_command* cmd, k_timeout_t timeout)
+{
+    k_mutex_lock(&queue_lock, K_FOREVER);
+
+    while (true)
+    {
+        for (int lane = 0; lane < CMD_LANE_COUNT; lane++)
+        {
+            struct lane_ring* ring = &lanes[lane];
+
+            if (ring->count == 0)
+                continue;
+
+            *cmd = ring->slots[ring->head];
+            ring->head = (ring->head + 1) % ring->depth;
+            ring->count--;
+            k_condvar_broadcast(&queue_not_full);
+            k_mutex_unlock(&queue_lock);
+            return 0;
+        }
+
+        if (k_condvar_wait(&queue_not_empty, &queue_lock, timeout) != 0)
+        {
+            k_mutex_unlock(&queue_lock);
+            return -EAGAIN;
+        }
+    }
+}
+
+/**
+ * @brief waits for an urgent command to be queued, the gait thread holding a
+ * scheduled one meanwhile. The command is left in the queue.
+ *
+ * @param timeout absolute, unchanged across the wake ups of other lanes
+ * @return 0 if an urgent command is pending, -EAGAIN if none came in time
+ */
+int cmd_queue_wait_urgent(k_timeout_t timeout)
+{
+    int ret = 0;
+
+    k_mutex_lock(&queue_lock, K_FOREVER);
+    while (lanes[CMD_LANE_URGENT].count == 0)
+    {
+        if (k_condvar_wait(&queue_not_empty, &queue_lock, timeout) != 0)
+        {
+            ret = -EAGAIN;
+            break;
+        }
+    }
+    k_mutex_unlock(&queue_lock);
+    return ret;
+}
+
+/**
+ * @brief drops every pending command of a lane.
+ *
+ * @param lane
+ * @param on_drop called (with the queue locked) for each dropped command, may
+ * be NULL
+ */
+void cmd_queue_flush(enum cmd_lane lane,
+                     void (*on_drop)(const struct tcp_command* cmd))
+{
+    struct lane_ring* ring = &lanes[lane];
+
+    k_mutex_lock(&queue_lock, K_FOREVER);
+    for (int i = 0; on_drop != NULL && i < ring->count; i++)
+        on_drop(&ring->slots[(ring->head + i) % ring->depth]);
+    stats.cancelled += lanes[lane].count;
+    lanes[lane].head = 0;
+    lanes[lane].count = 0;
+    k_condvar_broadcast(&queue_not_full);
+    k_mutex_unlock(&queue_lock);
+}
+
+/**
+ * @brief counts a command its producer gave up queueing.
+ */
+void cmd_queue_count_dropped(void)
+{
+    k_mutex_lock(&queue_lock, K_FOREVER);
+    stats.dropped++;
+    k_mutex_unlock(&queue_lock);
+}
+
+void cmd_queue_get_stats(struct cmd_queue_stats* out)
+{
+    k_mutex_lock(&queue_lock, K_FOREVER);
+    *out = stats;
+    for (int lane = 0; lane < CMD_LANE_COUNT; lane++)
+        out->pending[lane] = lanes[lane].count;
+    k_mutex_unlock(&queue_lock);
+}
+
+void cmd_queue_reset_stats(void)
+{
+    k_mutex_lock(&queue_lock, K_FOREVER);
+    memset(&stats, 0, sizeof(stats));
+    k_mutex_unlock(&queue_lock);
+}
@@ -0,0 +1,427 @@
+/*======================================================================
+ * File:    conn_mgr.c
+ * Date:    2026-10-19
+ * Purpose: Keeps the robot reachable. Brings the link up (WiFi association or
+ *interface up), waits for an IPv4 address, and after a link loss retries with
+ *an exponential backoff and re-acquires the DHCP lease. The TCP server
+ *watches the generation counter to know when its sockets must be rebound.
+ *Runs entirely from net_mgmt callbacks and the system work queue, the motion
+ *threads are never involved.
+ *====================================================================*/
+#include "conn_mgr.h"
+#include "boot_report.h"
+#include "spider_robot.h"
+#include "zephyr/kernel.h"
+#include "zephyr/sys/util.h"
+#include <string.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/dhcpv4.h>
+#include <zephyr/net/net_event.h>
+#include <zephyr/net/net_if.h>
+#include <zephyr/net/net_mgmt.h>
+#include <zephyr/net/wifi_mgmt.h>
+
+LOG_MODULE_REGISTER(conn_mgr, CONFIG_SPIDER_LOG_LEVEL);
+
+#define CONN_READY_EVENT BIT(0)
+
+static K_MUTEX_DEFINE(conn_lock);
+static K_EVENT_DEFINE(conn_events);
+
+static enum conn_state state = CONN_DISCONNECTED;
+static uint32_t failed_attempts; // consecutive, drives the backoff
+static uint32_t generation;      // bumped on every link loss
+static int64_t link_lost_us;
+static struct conn_mgr_stats stats;
+
+static struct net_mgmt_event_callback link_cb;
+static struct net_mgmt_event_callback ipv4_cb;
+
+static void conn_work_handler(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(conn_work, conn_work_handler);
+
+/**
+ * @brief delay before the next attempt after `attempt` consecutive failures.
+ */
+uint32_t conn_mgr_backoff_ms(uint32_t attempt)
+{
+    uint32_t delay = CONFIG_SPIDER_CONN_BACKOFF_MIN_MS;
+
+    while (attempt-- > 0 && delay < CONFIG_SPIDER_CONN_BACKOFF_MAX_MS)
+        delay *= 2;
+    return MIN(delay, CONFIG_SPIDER_CONN_BACKOFF_MAX_MS);
+}
+
+static bool iface_has_ipv4(struct net_if* iface)
+{
+    return net_if_ipv4_get_global_addr(iface, NET_ADDR_ANY_STATE) != NULL;
+}
+
+/**
+ * @brief assigns the address configured with CONFIG_SPIDER_STATIC_IPV4 instead
+ * of waiting for a DHCP lease.
+ */
+static void set_static_ipv4(struct net_if* iface)
+{
+#if defined(CONFIG_SPIDER_STATIC_IPV4)
+    struct in_addr addr, netmask, gw;
+
+    if (net_addr_pton(AF_INET, CONFIG_SPIDER_STATIC_IPV4_ADDR, &addr) < 0 ||
+        net_addr_pton(AF_INET, CONFIG_SPIDER_STATIC_IPV4_NETMASK, &netmask) <
+            0 ||
+        net_addr_pton(AF_INET, CONFIG_SPIDER_STATIC_IPV4_GW, &gw) < 0)
+    {
+        LOG_ERR("Invalid static IPv4 configuration");
+        return;
+    }
+
+    if (IS_ENABLED(CONFIG_NET_DHCPV4))
+        net_dhcpv4_stop(iface);
+
+    // Triggers NET_EVENT_IPV4_ADDR_ADD like a DHCP lease would
+    if (net_if_ipv4_addr_add(iface, &addr, NET_ADDR_MANUAL, 0) == NULL)
+    {
+        LOG_ERR("Failed to set static IPv4 address");
+        return;
+    }
+    net_if_ipv4_set_netmask_by_addr(iface, &addr, &netmask);
+    net_if_ipv4_set_gw(iface, &gw);
+#else
+    (void)iface;
+#endif
+}
+
+#if defined(CONFIG_WIFI)
+static int request_link(struct net_if* iface)
+{
+    struct wifi_connect_req_params wifi_params = {0};
+
+    wifi_params.ssid = CONFIG_MY_WIFI_SSID;
+    wifi_params.psk = CONFIG_MY_WIFI_PSK;
+    wifi_params.ssid_length = strlen(CONFIG_MY_WIFI_SSID);
+    wifi_params.psk_length = strlen(CONFIG_MY_WIFI_PSK);
+    wifi_params.channel = WIFI_CHANNEL_ANY;
+    wifi_params.security = WIFI_SECURITY_TYPE_PSK;
+    wifi_params.band = WIFI_FREQ_BAND_2_4_GHZ;
+    wifi_params.mfp = WIFI_MFP_OPTIONAL;
+
+    LOG_INF("Connecting to SSID: %s", wifi_params.ssid);
+
+    return net_mgmt(NET_REQUEST_WIFI_CONNECT, iface, &wifi_params,
+                    sizeof(struct wifi_connect_req_params));
+}
+
+static int drop_link(struct net_if* iface)
+{
+    return net_mgmt(NET_REQUEST_WIFI_DISCONNECT, iface, NULL, 0);
+}
+#else
+static int request_link(struct net_if* iface)
+{
+    LOG_INF("Bringing interface up");
+    return net_if_up(iface);
+}
+
+static int drop_link(struct net_if* iface)
+{
+    return net_if_down(iface);
+}
+#endif
+
+static void set_ready(void)
+{
+    k_work_cancel_delayable(&conn_work);
+    failed_attempts = 0;
+    state = CONN_READY;
+    boot_mark(BOOT_STAGE_IPV4);
+    if (link_lost_us != 0)
+    {
+        stats.last_recovery_us = cmd_timestamp_us() - link_lost_us;
+        stats.max_recovery_us =
+            MAX(stats.max_recovery_us, stats.last_recovery_us);
+        LOG_INF("Network recovered in %lld us", stats.last_recovery_us);
+        link_lost_us = 0;
+    }
+    k_event_post(&conn_events, CONN_READY_EVENT);
+}
+
+static void schedule_attempt(void)
+{
+    uint32_t delay = conn_mgr_backoff_ms(failed_attempts);
+
+    state = CONN_DISCONNECTED;
+    LOG_INF("Next connection attempt in %u ms", delay);
+    k_work_reschedule(&conn_work, K_MSEC(delay));
+}
+
+static void on_link_up(struct net_if* iface)
+{
+    k_mutex_lock(&conn_lock, K_FOREVER);
+    if (state == CONN_READY || state == CONN_WAIT_IPV4)
+        goto out;
+
+    // The attempt goes on until an address is obtained
+    k_work_reschedule(&conn_work,
+                      K_MSEC(CONFIG_SPIDER_CONN_ATTEMPT_TIMEOUT_MS));
+    state = CONN_WAIT_IPV4;
+    boot_mark(BOOT_STAGE_WIFI);
+
+    if (IS_ENABLED(CONFIG_SPIDER_STATIC_IPV4))
+        set_static_ipv4(iface);
+    else if (IS_ENABLED(CONFIG_NET_DHCPV4) && generation > 0)
+        net_dhcpv4_restart(iface); // the previous lease may be gone
+
+    // Static and loopback addresses survive a link loss
+    if ((IS_ENABLED(CONFIG_SPIDER_STATIC_IPV4) ||
+         !IS_ENABLED(CONFIG_NET_DHCPV4)) &&
+        iface_has_ipv4(iface))
+        set_ready();
+out:
+    k_mutex_unlock(&conn_lock);
+}
+
+static void on_link_down(void)
+{
+    k_mutex_lock(&conn_lock, K_FOREVER);
+    if (state == CONN_READY || state == CONN_WAIT_IPV4)
+    {
+        LOG_ERR("Link lost");
+        k_event_clear(&conn_events, CONN_READY_EVENT);
+        generation++;
+        stats.link_losses++;
+        link_lost_us = cmd_timestamp_us();
+        schedule_attempt();
+    }
+    k_mutex_unlock(&conn_lock);
+}
+
+static void on_connect_failed(void)
+{
+    k_mutex_lock(&conn_lock, K_FOREVER);
+    if (state == CONN_CONNECTING)
+    {
+        failed_attempts++;
+        stats.failures++;
+        schedule_attempt();
+    }
+    k_mutex_unlock(&conn_lock);
+}
+
+static void on_ipv4_ready(void)
+{
+    k_mutex_lock(&conn_lock, K_FOREVER);
+    if (state == CONN_WAIT_IPV4)
+        set_ready();
+    k_mutex_unlock(&conn_lock);
+}
+
+/**
+ * @brief the link came up but no address came with it: drops the link so
+ * that the next attempt, after the backoff, associates and requests a lease
+ * again.
+ */
+static void on_ipv4_timeout(struct net_if* iface)
+{
+    k_mutex_lock(&conn_lock, K_FOREVER);
+    if (state != CONN_WAIT_IPV4)
+    {
+        k_mutex_unlock(&conn_lock);
+        return;
+    }
+    failed_attempts++;
+    stats.failures++;
+    schedule_attempt();
+    k_mutex_unlock(&conn_lock);
+
+    // The link down event finds the attempt already scheduled
+    int ret = drop_link(iface);
+    if (ret < 0)
+        LOG_ERR("Link drop failed (%d)", ret);
+}
+
+/**
+ * @brief fires either to start an attempt (after the backoff) or when an
+ * attempt took too long to bring the link up or to get an address.
+ */
+static void conn_work_handler(struct k_work* work)
+{
+    (void)work;
+    struct net_if* iface = net_if_get_default();
+
+    k_mutex_lock(&conn_lock, K_FOREVER);
+    if (state == CONN_CONNECTING)
+    {
+        LOG_WRN("Connection attempt timed out");
+        k_mutex_unlock(&conn_lock);
+        on_connect_failed();
+        return;
+    }
+    if (state == CONN_WAIT_IPV4)
+    {
+        LOG_WRN("No IPv4 address in time");
+        k_mutex_unlock(&conn_lock);
+        on_ipv4_timeout(iface);
+        return;
+    }
+    if (state != CONN_DISCONNECTED)
+    {
+        k_mutex_unlock(&conn_lock);
+        return;
+    }
+
+    state = CONN_CONNECTING;
+    stats.attempts++;
+    k_work_reschedule(&conn_work,
+                      K_MSEC(CONFIG_SPIDER_CONN_ATTEMPT_TIMEOUT_MS));
+    k_mutex_unlock(&conn_lock);
+
+    int ret = request_link(iface);
+    if (ret == -EALREADY)
+        on_link_up(iface);
+    else if (ret < 0)
+    {
+        LOG_ERR("Link request failed (%d)", ret);
+        on_connect_failed();
+    }
+}
+
+/**
+ * @brief Network management event handler.
+ *
+ * Handles WiFi connect/disconnect (or interface up/down without WiFi) and
+ * IPv4 address events.
+ *
+ * @param event_cb Event callback structure.
+ * @param mgmt_event Network management event type.
+ * @param iface Network interface pointer.
+ */
+static void net_event_handler(struct net_mgmt_event_callback* event_cb,
+                              uint64_t mgmt_event, struct net_if* iface)
+{
+    switch (mgmt_event)
+    {
+#if defined(CONFIG_WIFI)
+        case NET_EVENT_WIFI_CONNECT_RESULT:
+        {
+            const struct wifi_status* status =
+                (const struct wifi_status*)event_cb->info;
+            if (status->status == 0)
+            {
+                LOG_INF("Wifi connected!");
+                on_link_up(iface);
+            }
+            else
+            {
+                LOG_ERR("Wifi connection failed (%d)", status->status);
+                on_connect_failed();
+            }
+            break;
+        }
+        case NET_EVENT_WIFI_DISCONNECT_RESULT:
+        {
+            const struct wifi_status* status =
+                (const struct wifi_status*)event_cb->info;
+            if (status->status)
+                LOG_DBG("Wifi disconnection request (%d)", status->status);
+            else
+            {
+                LOG_ERR("Wifi diconnected");
+                on_link_down();
+            }
+            break;
+        }
+#else
+        case NET_EVENT_IF_UP:
+            on_link_up(iface);
+            break;
+        case NET_EVENT_IF_DOWN:
+            on_link_down();
+            break;
+#endif
+        case NET_EVENT_IPV4_ADDR_ADD:
+        case NET_EVENT_IPV4_DHCP_BOUND:
+        {
+            char buf[NET_IPV4_ADDR_LEN];
+            struct in_addr* addr =
+                net_if_ipv4_get_global_addr(iface, NET_ADDR_ANY_STATE);
+
+            if (addr != NULL)
+                LOG_INF("IPv4 address: %s",
+                        net_addr_ntop(AF_INET, addr, buf, sizeof(buf)));
+            on_ipv4_ready();
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief registers the event callbacks and starts the first attempt.
+ * Offloaded interfaces (native_sim) use the host network and are ready
+ * right away.
+ */
+void conn_mgr_start(void)
+{
+    struct net_if* iface = net_if_get_default();
+
+    if (iface != NULL && net_if_is_socket_offloaded(iface))
+    {
+        k_mutex_lock(&conn_lock, K_FOREVER);
+        set_ready();
+        k_mutex_unlock(&conn_lock);
+        return;
+    }
+
+#if defined(CONFIG_WIFI)
+    net_mgmt_init_event_callback(&link_cb, net_event_handler,
+                                 NET_EVENT_WIFI_CONNECT_RESULT |
+                                     NET_EVENT_WIFI_DISCONNECT_RESULT);
+#else
+    net_mgmt_init_event_callback(&link_cb, net_event_handler,
+                                 NET_EVENT_IF_UP | NET_EVENT_IF_DOWN);
+#endif
+    net_mgmt_init_event_callback(&ipv4_cb, net_event_handler,
+                                 NET_EVENT_IPV4_ADDR_ADD |
+                                     NET_EVENT_IPV4_DHCP_BOUND);
+
+    net_mgmt_add_event_callback(&link_cb);
+    net_mgmt_add_event_callback(&ipv4_cb);
+
+    k_work_reschedule(&conn_work, K_NO_WAIT);
+}
+
+int conn_mgr_wait_ready(k_timeout_t timeout)
+{
+    if (k_event_wait(&conn_events, CONN_READY_EVENT, false, timeout) == 0)
+        return -EAGAIN;
+    return 0;
+}
+
+bool conn_mgr_is_ready(void)
+{
+    return (k_event_test(&conn_events, CONN_READY_EVENT) != 0);
+}
+
+uint32_t conn_mgr_generation(void)
+{
+    k_mutex_lock(&conn_lock, K_FOREVER);
+    uint32_t gen = generation;
+    k_mutex_unlock(&conn_lock);
+    return gen;
+}
+
+enum conn_state conn_mgr_state(void)
+{
+    k_mutex_lock(&conn_lock, K_FOREVER);
+    enum conn_state current = state;
+    k_mutex_unlock(&conn_lock);
+    return current;
+}
+
+void conn_mgr_get_stats(struct conn_mgr_stats* out)
+{
+    k_mutex_lock(&conn_lock, K_FOREVER);
+    *out = stats;
+    k_mutex_unlock(&conn_lock);
+}
@@ -5,17 +5,58 @@
  *including walking, turning, and gesture behaviors. locks the g_state mutex and
  *sets the expected positions of the legs
  *====================================================================*/
+#include "gait_cache.h"
+#include "profiling.h"
+#include "reach_map.h"
 #include "robot_state.h"
 #include "servos.h"
 #include "spider_robot.h"
+#include "state_lock.h"
+#include "trace_points.h"
+#include <errno.h>
 #include <math.h>
+#include <string.h>
 #include <zephyr/logging/log.h>
-
-LOG_MODULE_REGISTER(gait, LOG_LEVEL_DBG);
-
-void set_site(int leg, double x, double y, double z)
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_REGISTER(gait, CONFIG_SPIDER_LOG_LEVEL);
+
+// Tick by which the next keyframe must be written, 0 between commands. Gait
+// thread only
+static int64_t keyframe_due_us;
+// Set while safe_stance() moves the legs, under g_state_mutex
+static bool safe_stopping;
+// Command run by the gait thread, cancelled by a safe stop. Cleared once it is
+// over, so it doesn't go on after the recovery
+static atomic_t cmd_active;
+static atomic_t cmd_cancelled;
+
+/**
+ * @brief sets the position the leg moves to on the next motor ticks, at the
+ * current move speed. Called with g_state_mutex held.
+ *
+ * @return 0, -EDOM if the target is out of the leg's reach, which cancels
+ * the command, or -ECANCELED once the command was cancelled: the leg then
+ * keeps its previous target
+ */
+int set_site(int leg, double x, double y, double z)
 {
     double length_x = 0, length_y = 0, length_z = 0;
+    double target_x = (x != KEEP) ? x : g_state.site_expect[leg][0];
+    double target_y = (y != KEEP) ? y : g_state.site_expect[leg][1];
+    double target_z = (z != KEEP) ? z : g_state.site_expect[leg][2];
+
+    if (command_cancelled() && !safe_stopping)
+        return -ECANCELED;
+
+    // Stop rather than go on without this leg's keyframe
+    if (!reach_map_reachable(target_x, target_y, target_z))
+    {
+        LOG_ERR("Leg %d can't reach (%.1f, %.1f, %.1f)", leg, target_x,
+                target_y, target_z);
+        cancel_command();
+        return -EDOM;
+    }
 
     if (x != KEEP)
         length_x = x - g_state.site_now[leg][0];
@@ -27,7 +68,11 @@ void set_site(int leg, double x, double y, double z)
     double length =
         sqrt(pow(length_x, 2) + pow(length_y, 2) + pow(length_z, 2));
 
-    double speed_factor = g_state.move_speed * g_state.speed_multiple / length;
+    // A leg already on its target must not get a NaN speed (0 / 0), the motor
+    // thread would never see it arrive
+    double speed_factor =
+        (length > 0) ? g_state.move_speed * g_config.speed_multiple / length
+                     : 0;
     g_state.temp_speed[leg][0] = length_x * speed_factor;
     g_state.temp_speed[leg][1] = length_y * speed_factor;
     g_state.temp_speed[leg][2] = length_z * speed_factor;
@@ -38,56 +83,254 @@ void set_site(int leg, double x, double y, double z)
         g_state.site_expect[leg][1] = y;
     if (z != KEEP)
         g_state.site_expect[leg][2] = z;
+    g_state.joint_mode[leg] = false;
+
+    TRACE_KEYFRAME_SET(leg, g_state.keyframe);
+    prof_first_site();
+    return 0;
+}
+
+/**
+ * @brief set_site() for the moves whose foot path doesn't matter (sitting,
+ * standing, body shifts). With CONFIG_SPIDER_JOINT_INTERP the angles are
+ * solved at both ends of the move only and the motor tick interpolates them,
+ * in as many ticks as the straight move would take. The leg must be on its
+ * previous target.
+ *
+ * @return see set_site()
+ */
+int set_site_joint(int leg, double x, double y, double z)
+{
+    double start[NB_JOINTS];
+    bool was_joint = g_state.joint_mode[leg];
+
+    if (was_joint)
+        memcpy(start, g_state.joint_now[leg], sizeof(start));
+
+    int ret = set_site(leg, x, y, z);
+    if (ret != 0 || !IS_ENABLED(CONFIG_SPIDER_JOINT_INTERP))
+        return ret;
+
+    double* now = g_state.site_now[leg];
+    double* expect = g_state.site_expect[leg];
+    double* end = g_state.joint_expect[leg];
+    double length = sqrt(pow(expect[0] - now[0], 2) +
+                         pow(expect[1] - now[1], 2) +
+                         pow(expect[2] - now[2], 2));
+    double step = g_state.move_speed * g_config.speed_multiple;
+
+    // Resting legs keep the angles of their last joint space move
+    if (!was_joint)
+        cartesian_to_polar(&start[0], &start[1], &start[2], now[0], now[1],
+                           now[2]);
+    if (length > 0)
+        cartesian_to_polar(&end[0], &end[1], &end[2], expect[0], expect[1],
+                           expect[2]);
+    else
+        memcpy(end, start, sizeof(start));
+
+    // Counted rather than compared, the sums of the steps are not exact
+    uint32_t ticks = (length > 0 && step > 0) ? (uint32_t)ceil(length / step)
+                                               : 0;
+    for (int joint = 0; joint < NB_JOINTS; joint++)
+    {
+        g_state.joint_now[leg][joint] = (ticks > 0) ? start[joint] : end[joint];
+        g_state.joint_speed[leg][joint] =
+            (ticks > 0) ? (end[joint] - start[joint]) / ticks : 0;
+    }
+    g_state.joint_ticks[leg] = ticks;
+    g_state.joint_mode[leg] = true;
+    return 0;
+}
+
+/**
+ * @brief true once every leg is on its target. Called with g_state_mutex
+ * held.
+ */
+bool all_legs_reached(void)
+{
+    for (int leg = 0; leg < NB_LEGS; leg++)
+    {
+        for (int joint = 0; joint < NB_JOINTS; joint++)
+        {
+            if (g_state.site_now[leg][joint] != g_state.site_expect[leg][joint])
+                return false;
+        }
+    }
+    return true;
 }
 
 void wait_all_reach(void)
 {
-    while (true)
+    // Compiling a gait: the ticks are run right away and recorded
+    if (gait_cache_recording())
     {
-        bool motion_is_complete = true;
+        gait_cache_record_reach();
+        return;
+    }
+
+    int64_t now = cmd_timestamp_us();
+    if (keyframe_due_us != 0)
+        motors_count_keyframe(now > keyframe_due_us);
+    // Already reached: the next keyframe is due on the next tick
+    int64_t deadline_us = motors_next_tick_us(now);
 
-        if (k_mutex_lock(&g_state_mutex, K_MSEC(10)) != 0)
+    // The motor ticks may have stopped while the robot stood still
+    motors_wake();
+    while (true)
+    {
+        // The keyframes left are refused, end the command now
+        if (command_cancelled())
+            break;
+        if (state_lock(K_MSEC(10)) != 0)
         {
             LOG_ERR("wait_all_reach: Failed to lock mutex");
             k_msleep(20);
             continue;
         }
 
-        for (int leg = 0; leg < NB_LEGS; leg++)
+        bool motion_is_complete = all_legs_reached();
+        if (motion_is_complete)
         {
-            for (int joint = 0; joint < NB_JOINTS; joint++)
-            {
-                if (g_state.site_now[leg][joint] !=
-                    g_state.site_expect[leg][joint])
-                {
-                    motion_is_complete = false;
-                    break;
-                }
-            }
-            if (!motion_is_complete)
-                break;
+            TRACE_GAIT_WAKE(g_state.keyframe);
+            g_state.keyframe++;
         }
 
-        k_mutex_unlock(&g_state_mutex);
+        state_unlock();
 
         if (motion_is_complete)
             break;
 
+        // If reached on the next tick, the next keyframe is due on the one
+        // after
+        deadline_us =
+            motors_next_tick_us(motors_next_tick_us(cmd_timestamp_us()));
+        sched_deadline_at(deadline_us);
         k_msleep(2); // WARN: how frequent should this be checked
     }
+    keyframe_due_us = deadline_us;
+}
+
+/**
+ * @brief the command is over: the first keyframe of the next one is not due
+ * on any tick.
+ */
+void end_keyframes(void)
+{
+    keyframe_due_us = 0;
+}
+
+/**
+ * @brief a command starts on the gait thread: it can be cancelled until
+ * end_command().
+ */
+void begin_command(void)
+{
+    atomic_clear(&cmd_cancelled);
+    atomic_set(&cmd_active, 1);
+}
+
+/**
+ * @brief cancels the command being run, if any: its keyframes left are
+ * refused and its steps left are not started.
+ */
+void cancel_command(void)
+{
+    if (atomic_get(&cmd_active))
+        atomic_set(&cmd_cancelled, 1);
+}
+
+/**
+ * @brief true once the command being run was cancelled, and after a safe
+ * stop until the motor ticks recover.
+ */
+bool command_cancelled(void)
+{
+    return atomic_get(&cmd_cancelled) || motors_faulted();
+}
+
+/**
+ * @brief the command is over.
+ *
+ * @return true if it was cancelled
+ */
+bool end_command(void)
+{
+    atomic_clear(&cmd_active);
+    end_keyframes();
+    return atomic_clear(&cmd_cancelled) != 0;
+}
+
+/**
+ * @brief targets the boot (sitting) stance. Called with g_state_mutex held.
+ */
+static void set_boot_sites(void)
+{
+    set_site(0, g_config.x_default - g_config.x_offset,
+             g_config.y_start + g_config.y_step, g_derived.z_boot);
+    set_site(1, g_config.x_default - g_config.x_offset,
+             g_config.y_start + g_config.y_step, g_derived.z_boot);
+    set_site(2, g_config.x_default + g_config.x_offset, g_config.y_start,
+             g_derived.z_boot);
+    set_site(3, g_config.x_default + g_config.x_offset, g_config.y_start,
+             g_derived.z_boot);
+}
+
+/**
+ * @brief puts the legs in the boot (sitting) stance right away, without
+ * interpolation, so the first motor tick already holds a safe pose.
+ */
+void init_stance(void)
+{
+    state_lock(K_FOREVER);
+    set_boot_sites();
+
+    for (int leg = 0; leg < NB_LEGS; leg++)
+        for (int joint = 0; joint < NB_JOINTS; joint++)
+            g_state.site_now[leg][joint] = g_state.site_expect[leg][joint];
+    state_unlock();
+    // Written by the next tick
+    motors_wake();
+}
+
+/**
+ * @brief sits down at the sitting speed from wherever the legs are, after the
+ * motor ticks missed their deadlines. The gait being run can't move the legs
+ * until they recover. Called with g_state_mutex held, by the motor thread.
+ */
+void safe_stance(void)
+{
+    // site_now of a joint space move is only set on its last tick: stop the
+    // leg where its angles are
+    for (int leg = 0; leg < NB_LEGS; leg++)
+    {
+        if (!g_state.joint_mode[leg] || g_state.joint_ticks[leg] == 0)
+            continue;
+        polar_to_cartesian(&g_state.site_now[leg][0],
+                           &g_state.site_now[leg][1],
+                           &g_state.site_now[leg][2],
+                           g_state.joint_now[leg][0],
+                           g_state.joint_now[leg][1],
+                           g_state.joint_now[leg][2]);
+        g_state.joint_ticks[leg] = 0;
+    }
+    safe_stopping = true;
+    g_state.move_speed = g_config.stand_seat_speed;
+    set_boot_sites();
+    safe_stopping = false;
 }
 
 void sit(unsigned int step)
 {
     (void)step;
 
-    k_mutex_lock(&g_state_mutex, K_FOREVER);
-    g_state.move_speed = g_state.stand_seat_speed;
+    state_lock(K_FOREVER);
+    g_state.move_speed = g_config.stand_seat_speed;
     for (int leg = 0; leg < NB_LEGS; leg++)
     {
-        set_site(leg, KEEP, KEEP, g_state.z_boot);
+        set_site_joint(leg, KEEP, KEEP, g_derived.z_boot);
     }
-    k_mutex_unlock(&g_state_mutex);
+    state_unlock();
     wait_all_reach();
 }
 
@@ -95,11 +338,11 @@ void stand(unsigned int step)
 {
     (void)step;
 
-    k_mutex_lock(&g_state_mutex, K_FOREVER);
-    g_state.move_speed = g_state.stand_seat_speed;
+    state_lock(K_FOREVER);
+    g_state.move_speed = g_config.stand_seat_speed;
     for (int leg = 0; leg < NB_LEGS; leg++)
-        set_site(leg, KEEP, KEEP, g_state.z_default);
-    k_mutex_unlock(&g_state_mutex);
+        set_site_joint(leg, KEEP, KEEP, g_config.z_default);
+    state_unlock();
 
     wait_all_reach();
 }
@@ -108,80 +351,82 @@ void step_forward(unsigned int step)
 {
     double local_leg_move_speed, local_body_move_speed;
 
-    k_mutex_lock(&g_state_mutex, K_FOREVER);
-    local_leg_move_speed = g_state.leg_move_speed;
-    local_body_move_speed = g_state.body_move_speed;
-    k_mutex_unlock(&g_state_mutex);
+    state_lock(K_FOREVER);
+    local_leg_move_speed = g_config.leg_move_speed;
+    local_body_move_speed = g_config.body_move_speed;
+    state_unlock();
 
-    while (step-- > 0)
+    while (step-- > 0 && !command_cancelled())
     {
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         bool leg_2_is_home =
-            (fabs(g_state.site_now[2][1] - g_state.y_start) < EPSILON);
-        k_mutex_unlock(&g_state_mutex);
+            (fabs(g_state.site_now[2][1] - g_config.y_start) < EPSILON);
+        state_unlock();
 
         if (leg_2_is_home)
         {
             /*********************************/
             /* Move Leg 2           */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
             g_state.move_speed = local_leg_move_speed;
-            set_site(2, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(2, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(2, g_state.x_default + g_state.x_offset,
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(2, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(2, g_state.x_default + g_state.x_offset,
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(2, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step,
+                     g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
             /*********************************/
             /* Shift Body           */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
             g_state.move_speed = local_body_move_speed;
-            set_site(0, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
+            set_site(0, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
 
-            set_site(1, g_state.x_default + g_state.x_offset,
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_default);
-            set_site(2, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
-            set_site(3, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(1, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step,
+                     g_config.z_default);
+            set_site(2, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
+            set_site(3, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
             /*********************************/
             /* Move Leg 1           */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
             g_state.move_speed = local_leg_move_speed;
-            set_site(1, g_state.x_default + g_state.x_offset,
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(1, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(1, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(1, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(1, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
+            state_lock(K_FOREVER);
+            set_site(1, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
 
-            k_mutex_unlock(&g_state_mutex);
+            state_unlock();
             wait_all_reach();
         }
         else
@@ -189,63 +434,65 @@ void step_forward(unsigned int step)
             /*********************************/
             /* Move Leg 0           */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
             g_state.move_speed = local_leg_move_speed;
-            set_site(0, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(0, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
+            state_unlock();
 
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.x_default + g_state.x_offset,
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_up);
+            state_lock(K_FOREVER);
+            set_site(0, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step, g_config.z_up);
 
-            k_mutex_unlock(&g_state_mutex);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.x_default + g_state.x_offset,
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(0, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step,
+                     g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
             /*********************************/
             /* Shift Body           */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
             g_state.move_speed = local_body_move_speed;
-            set_site(0, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
-            set_site(1, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
-            set_site(2, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
-            set_site(3, g_state.x_default + g_state.x_offset,
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(0, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
+            set_site(1, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
+            set_site(2, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
+            set_site(3, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step,
+                     g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
             /*********************************/
             /* Move Leg 3           */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
             g_state.move_speed = local_leg_move_speed;
-            set_site(3, g_state.x_default + g_state.x_offset,
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(3, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(3, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(3, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(3, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(3, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
+            state_unlock();
             wait_all_reach();
         }
     }
@@ -254,17 +501,17 @@ void step_forward(unsigned int step)
 void turn_left(unsigned int step)
 {
     double local_spot_turn_speed;
-    k_mutex_lock(&g_state_mutex, K_FOREVER);
-    local_spot_turn_speed = g_state.spot_turn_speed;
-    k_mutex_unlock(&g_state_mutex);
+    state_lock(K_FOREVER);
+    local_spot_turn_speed = g_config.spot_turn_speed;
+    state_unlock();
 
-    while (step-- > 0)
+    while (step-- > 0 && !command_cancelled())
     {
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         bool leg_3_is_home =
 
-            (fabs(g_state.site_now[3][1] - g_state.y_start) < EPSILON);
-        k_mutex_unlock(&g_state_mutex);
+            (fabs(g_state.site_now[3][1] - g_config.y_start) < EPSILON);
+        state_unlock();
 
         if (leg_3_is_home)
 
@@ -273,67 +520,67 @@ void turn_left(unsigned int step)
 
             /* Phase 1: Move Legs 3 & 1      */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
             g_state.move_speed = local_spot_turn_speed;
-            set_site(3, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(3, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.turn_x1 - g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
+            state_lock(K_FOREVER);
+            set_site(0, g_derived.turn_x1 - g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
 
-            set_site(1, g_state.turn_x0 - g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
-            set_site(2, g_state.turn_x1 + g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
-            set_site(3, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(1, g_derived.turn_x0 - g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
+            set_site(2, g_derived.turn_x1 + g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
+            set_site(3, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(3, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(3, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.turn_x1 + g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
-            set_site(1, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
-            set_site(2, g_state.turn_x1 - g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
-            set_site(3, g_state.turn_x0 - g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(0, g_derived.turn_x1 + g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
+            set_site(1, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
+            set_site(2, g_derived.turn_x1 - g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
+            set_site(3, g_derived.turn_x0 - g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(1, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(1, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
-            set_site(1, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
-            set_site(2, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
-            set_site(3, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
+            state_lock(K_FOREVER);
+            set_site(0, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
+            set_site(1, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
+            set_site(2, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
+            set_site(3, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
 
-            k_mutex_unlock(&g_state_mutex);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(1, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(1, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
+            state_unlock();
             wait_all_reach();
         }
         else
@@ -341,66 +588,66 @@ void turn_left(unsigned int step)
             /*********************************/
             /* Phase 2: Move Legs 0 & 2      */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
             g_state.move_speed = local_spot_turn_speed;
-            set_site(0, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(0, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_up);
-            set_site(1, g_state.turn_x1 + g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
-            set_site(2, g_state.turn_x0 - g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
-            set_site(3, g_state.turn_x1 - g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(0, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_up);
+            set_site(1, g_derived.turn_x1 + g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
+            set_site(2, g_derived.turn_x0 - g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
+            set_site(3, g_derived.turn_x1 - g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
+            state_lock(K_FOREVER);
+            set_site(0, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
 
-            k_mutex_unlock(&g_state_mutex);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.turn_x0 - g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
-            set_site(1, g_state.turn_x1 - g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
-            set_site(2, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
-            set_site(3, g_state.turn_x1 + g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(0, g_derived.turn_x0 - g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
+            set_site(1, g_derived.turn_x1 - g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
+            set_site(2, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
+            set_site(3, g_derived.turn_x1 + g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(2, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(2, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
-            set_site(1, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
-            set_site(2, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
-            set_site(3, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(0, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
+            set_site(1, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
+            set_site(2, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
+            set_site(3, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(2, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(2, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
+            state_unlock();
             wait_all_reach();
         }
     }
@@ -409,86 +656,86 @@ void turn_left(unsigned int step)
 void turn_right(unsigned int step)
 {
     double local_spot_turn_speed;
-    k_mutex_lock(&g_state_mutex, K_FOREVER);
-    local_spot_turn_speed = g_state.spot_turn_speed;
-    k_mutex_unlock(&g_state_mutex);
+    state_lock(K_FOREVER);
+    local_spot_turn_speed = g_config.spot_turn_speed;
+    state_unlock();
 
-    while (step-- > 0)
+    while (step-- > 0 && !command_cancelled())
     {
 
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         bool leg_2_is_home =
-            (fabs(g_state.site_now[2][1] - g_state.y_start) < EPSILON);
+            (fabs(g_state.site_now[2][1] - g_config.y_start) < EPSILON);
 
-        k_mutex_unlock(&g_state_mutex);
+        state_unlock();
 
         if (leg_2_is_home)
         {
             /*********************************/
             /* Phase 1: Move Legs 2 & 0      */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
             g_state.move_speed = local_spot_turn_speed;
-            set_site(2, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(2, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
 
-            set_site(0, g_state.turn_x0 - g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
-            set_site(1, g_state.turn_x1 - g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
-            set_site(2, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_up);
-            set_site(3, g_state.turn_x1 + g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(0, g_derived.turn_x0 - g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
+            set_site(1, g_derived.turn_x1 - g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
+            set_site(2, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_up);
+            set_site(3, g_derived.turn_x1 + g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(2, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(2, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
-            set_site(1, g_state.turn_x1 + g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
-            set_site(2, g_state.turn_x0 - g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
+            state_lock(K_FOREVER);
+            set_site(0, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
+            set_site(1, g_derived.turn_x1 + g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
+            set_site(2, g_derived.turn_x0 - g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
 
-            set_site(3, g_state.turn_x1 - g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(3, g_derived.turn_x1 - g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_up);
+            state_lock(K_FOREVER);
+            set_site(0, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_up);
 
-            k_mutex_unlock(&g_state_mutex);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
-            set_site(1, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
-            set_site(2, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
-            set_site(3, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(0, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
+            set_site(1, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
+            set_site(2, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
+            set_site(3, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(0, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
+            state_unlock();
             wait_all_reach();
         }
         else
@@ -496,67 +743,67 @@ void turn_right(unsigned int step)
             /*********************************/
             /* Phase 2: Move Legs 1 & 3      */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
             g_state.move_speed = local_spot_turn_speed;
-            set_site(1, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
+            set_site(1, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
 
-            k_mutex_unlock(&g_state_mutex);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.turn_x1 + g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
-            set_site(1, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_up);
-            set_site(2, g_state.turn_x1 - g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
-            set_site(3, g_state.turn_x0 - g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(0, g_derived.turn_x1 + g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
+            set_site(1, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_up);
+            set_site(2, g_derived.turn_x1 - g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
+            set_site(3, g_derived.turn_x0 - g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(1, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(1, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.turn_x1 - g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
-            set_site(1, g_state.turn_x0 - g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
-            set_site(2, g_state.turn_x1 + g_state.x_offset, g_state.turn_y1,
-                     g_state.z_default);
-            set_site(3, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(0, g_derived.turn_x1 - g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
+            set_site(1, g_derived.turn_x0 - g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
+            set_site(2, g_derived.turn_x1 + g_config.x_offset,
+                     g_derived.turn_y1, g_config.z_default);
+            set_site(3, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(3, g_state.turn_x0 + g_state.x_offset, g_state.turn_y0,
-                     g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(3, g_derived.turn_x0 + g_config.x_offset,
+                     g_derived.turn_y0, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
-            set_site(1, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
-            set_site(2, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
-            set_site(3, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(0, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
+            set_site(1, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
+            set_site(2, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
+            set_site(3, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
 
-            set_site(3, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(3, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
+            state_unlock();
             wait_all_reach();
         }
     }
@@ -565,83 +812,84 @@ void turn_right(unsigned int step)
 void step_back(unsigned int step)
 {
     double local_leg_move_speed, local_body_move_speed;
-    k_mutex_lock(&g_state_mutex, K_FOREVER);
-    local_leg_move_speed = g_state.leg_move_speed;
-    local_body_move_speed = g_state.body_move_speed;
-    k_mutex_unlock(&g_state_mutex);
+    state_lock(K_FOREVER);
+    local_leg_move_speed = g_config.leg_move_speed;
+    local_body_move_speed = g_config.body_move_speed;
+    state_unlock();
 
-    while (step-- > 0)
+    while (step-- > 0 && !command_cancelled())
     {
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         bool leg_3_is_home =
-            (fabs(g_state.site_now[3][1] - g_state.y_start) < EPSILON);
-        k_mutex_unlock(&g_state_mutex);
+            (fabs(g_state.site_now[3][1] - g_config.y_start) < EPSILON);
+        state_unlock();
 
         if (leg_3_is_home)
         {
             /*********************************/
             /* Move Leg 3                    */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
             g_state.move_speed = local_leg_move_speed;
-            set_site(3, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
+            set_site(3, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
 
-            k_mutex_unlock(&g_state_mutex);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(3, g_state.x_default + g_state.x_offset,
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(3, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(3, g_state.x_default + g_state.x_offset,
-
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(3, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step,
+                     g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
             /*********************************/
             /* Shift Body Backward           */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
             g_state.move_speed = local_body_move_speed;
-            set_site(0, g_state.x_default + g_state.x_offset,
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_default);
-            set_site(1, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
-            set_site(2, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
+            set_site(0, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step,
+                     g_config.z_default);
+            set_site(1, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
+            set_site(2, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
 
-            set_site(3, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(3, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
             /*********************************/
             /* Move Leg 0                    */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
 
             g_state.move_speed = local_leg_move_speed;
-            set_site(0, g_state.x_default + g_state.x_offset,
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(0, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(0, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
+            state_unlock();
 
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(0, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
+            state_unlock();
             wait_all_reach();
         }
 
@@ -650,64 +898,66 @@ void step_back(unsigned int step)
             /*********************************/
             /* Move Leg 1                    */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
             g_state.move_speed = local_leg_move_speed;
-            set_site(1, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(1, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(1, g_state.x_default + g_state.x_offset,
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(1, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(1, g_state.x_default + g_state.x_offset,
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_default);
+            state_lock(K_FOREVER);
+            set_site(1, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step,
+                     g_config.z_default);
 
-            k_mutex_unlock(&g_state_mutex);
+            state_unlock();
             wait_all_reach();
 
             /*********************************/
             /* Shift Body Backward           */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
             g_state.move_speed = local_body_move_speed;
-            set_site(0, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
-            set_site(1, g_state.x_default - g_state.x_offset,
-                     g_state.y_start + g_state.y_step, g_state.z_default);
-            set_site(2, g_state.x_default + g_state.x_offset,
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_default);
-            set_site(3, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
-            k_mutex_unlock(&g_state_mutex);
+            set_site(0, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
+            set_site(1, g_config.x_default - g_config.x_offset,
+                     g_config.y_start + g_config.y_step, g_config.z_default);
+            set_site(2, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step,
+                     g_config.z_default);
+            set_site(3, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
+            state_unlock();
             wait_all_reach();
 
             /*********************************/
             /* Move Leg 2                    */
             /*********************************/
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
+            state_lock(K_FOREVER);
             g_state.move_speed = local_leg_move_speed;
-            set_site(2, g_state.x_default + g_state.x_offset,
-                     g_state.y_start + 2 * g_state.y_step, g_state.z_up);
+            set_site(2, g_config.x_default + g_config.x_offset,
+                     g_config.y_start + 2 * g_config.y_step, g_config.z_up);
 
-            k_mutex_unlock(&g_state_mutex);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(2, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_up);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(2, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_up);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(2, g_state.x_default + g_state.x_offset, g_state.y_start,
-                     g_state.z_default);
+            state_lock(K_FOREVER);
+            set_site(2, g_config.x_default + g_config.x_offset,
+                     g_config.y_start, g_config.z_default);
 
-            k_mutex_unlock(&g_state_mutex);
+            state_unlock();
             wait_all_reach();
         }
     }
@@ -715,24 +965,24 @@ void step_back(unsigned int step)
 
 void body_left(unsigned int i)
 {
-    k_mutex_lock(&g_state_mutex, K_FOREVER);
-    set_site(0, g_state.site_now[0][0] + i, KEEP, KEEP);
-    set_site(1, g_state.site_now[1][0] + i, KEEP, KEEP);
-    set_site(2, g_state.site_now[2][0] - i, KEEP, KEEP);
-    set_site(3, g_state.site_now[3][0] - i, KEEP, KEEP);
-    k_mutex_unlock(&g_state_mutex);
+    state_lock(K_FOREVER);
+    set_site_joint(0, g_state.site_now[0][0] + i, KEEP, KEEP);
+    set_site_joint(1, g_state.site_now[1][0] + i, KEEP, KEEP);
+    set_site_joint(2, g_state.site_now[2][0] - i, KEEP, KEEP);
+    set_site_joint(3, g_state.site_now[3][0] - i, KEEP, KEEP);
+    state_unlock();
 
     wait_all_reach();
 }
 
 void body_right(int i)
 {
-    k_mutex_lock(&g_state_mutex, K_FOREVER);
-    set_site(0, g_state.site_now[0][0] - i, KEEP, KEEP);
-    set_site(1, g_state.site_now[1][0] - i, KEEP, KEEP);
-    set_site(2, g_state.site_now[2][0] + i, KEEP, KEEP);
-    set_site(3, g_state.site_now[3][0] + i, KEEP, KEEP);
-    k_mutex_unlock(&g_state_mutex);
+    state_lock(K_FOREVER);
+    set_site_joint(0, g_state.site_now[0][0] - i, KEEP, KEEP);
+    set_site_joint(1, g_state.site_now[1][0] - i, KEEP, KEEP);
+    set_site_joint(2, g_state.site_now[2][0] + i, KEEP, KEEP);
+    set_site_joint(3, g_state.site_now[3][0] + i, KEEP, KEEP);
+    state_unlock();
 
     wait_all_reach();
 }
@@ -742,102 +992,102 @@ void hand_wave(unsigned int step)
     double x_tmp, y_tmp, z_tmp;
     double local_body_move_speed;
 
-    k_mutex_lock(&g_state_mutex, K_FOREVER);
+    state_lock(K_FOREVER);
     bool leg_3_is_home =
-        (fabs(g_state.site_now[3][1] - g_state.y_start) < EPSILON);
-    local_body_move_speed = g_state.body_move_speed;
-    k_mutex_unlock(&g_state_mutex);
+        (fabs(g_state.site_now[3][1] - g_config.y_start) < EPSILON);
+    local_body_move_speed = g_config.body_move_speed;
+    state_unlock();
 
     if (leg_3_is_home)
     {
         /*********************************/
         /* Wave with Leg 2 (Front-Left)  */
         /*********************************/
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         g_state.move_speed = 1.0;
-        k_mutex_unlock(&g_state_mutex);
-        body_right(15);
+        state_unlock();
+        body_right(GESTURE_BODY_SHIFT);
 
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         x_tmp = g_state.site_now[2][0];
 
         y_tmp = g_state.site_now[2][1];
         z_tmp = g_state.site_now[2][2];
-        k_mutex_unlock(&g_state_mutex);
+        state_unlock();
 
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         g_state.move_speed = local_body_move_speed;
-        k_mutex_unlock(&g_state_mutex);
+        state_unlock();
 
-        for (int j = 0; j < step; j++)
+        for (int j = 0; j < step && !command_cancelled(); j++)
         {
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(2, g_state.turn_x1, g_state.turn_y1, 50.0);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(2, g_derived.turn_x1, g_derived.turn_y1, WAVE_Z);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(2, g_state.turn_x0, g_state.turn_y0, 50.0);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(2, g_derived.turn_x0, g_derived.turn_y0, WAVE_Z);
+            state_unlock();
             wait_all_reach();
         }
 
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         set_site(2, x_tmp, y_tmp, z_tmp);
-        k_mutex_unlock(&g_state_mutex);
+        state_unlock();
         wait_all_reach();
 
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         g_state.move_speed = 1.0;
-        k_mutex_unlock(&g_state_mutex);
-        body_left(15); // This function is already thread-safe
+        state_unlock();
+        body_left(GESTURE_BODY_SHIFT); // This function is already thread-safe
     }
     else
     {
         /*********************************/
         /* Wave with Leg 0 (Front-Right) */
         /*********************************/
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         g_state.move_speed = 1.0;
 
-        k_mutex_unlock(&g_state_mutex);
-        body_left(15);
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_unlock();
+        body_left(GESTURE_BODY_SHIFT);
+        state_lock(K_FOREVER);
 
         x_tmp = g_state.site_now[0][0];
         y_tmp = g_state.site_now[0][1];
         z_tmp = g_state.site_now[0][2];
-        k_mutex_unlock(&g_state_mutex);
+        state_unlock();
 
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         g_state.move_speed = local_body_move_speed;
 
-        k_mutex_unlock(&g_state_mutex);
+        state_unlock();
 
-        for (int j = 0; j < step; j++)
+        for (int j = 0; j < step && !command_cancelled(); j++)
         {
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.turn_x1, g_state.turn_y1, 50.0);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(0, g_derived.turn_x1, g_derived.turn_y1, WAVE_Z);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.turn_x0, g_state.turn_y0, 50.0);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(0, g_derived.turn_x0, g_derived.turn_y0, WAVE_Z);
+            state_unlock();
             wait_all_reach();
         }
 
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         set_site(0, x_tmp, y_tmp, z_tmp);
-        k_mutex_unlock(&g_state_mutex);
+        state_unlock();
         wait_all_reach();
 
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
 
         g_state.move_speed = 1.0;
-        k_mutex_unlock(&g_state_mutex);
+        state_unlock();
 
-        body_right(15);
+        body_right(GESTURE_BODY_SHIFT);
     }
 }
 
@@ -846,102 +1096,102 @@ void hand_shake(unsigned int step)
     double x_tmp, y_tmp, z_tmp;
     double local_body_move_speed;
 
-    k_mutex_lock(&g_state_mutex, K_FOREVER);
+    state_lock(K_FOREVER);
     bool leg_3_is_home =
-        (fabs(g_state.site_now[3][1] - g_state.y_start) < EPSILON);
-    local_body_move_speed = g_state.body_move_speed;
-    k_mutex_unlock(&g_state_mutex);
+        (fabs(g_state.site_now[3][1] - g_config.y_start) < EPSILON);
+    local_body_move_speed = g_config.body_move_speed;
+    state_unlock();
 
     if (leg_3_is_home)
     {
         /*************************************/
         /* Shake with Leg 2 (Front-Left)     */
         /*************************************/
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         g_state.move_speed = 1.0;
-        k_mutex_unlock(&g_state_mutex);
-        body_right(15);
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_unlock();
+        body_right(GESTURE_BODY_SHIFT);
+        state_lock(K_FOREVER);
         x_tmp = g_state.site_now[2][0];
         y_tmp = g_state.site_now[2][1];
         z_tmp = g_state.site_now[2][2];
-        k_mutex_unlock(&g_state_mutex);
+        state_unlock();
 
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         g_state.move_speed = local_body_move_speed;
 
-        k_mutex_unlock(&g_state_mutex);
+        state_unlock();
 
-        for (int j = 0; j < step; j++)
+        for (int j = 0; j < step && !command_cancelled(); j++)
         {
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(2, g_state.x_default - 30.0,
-                     g_state.y_start + 2.0 * g_state.y_step, 55.0);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(2, g_config.x_default - SHAKE_X_BACK,
+                     g_config.y_start + 2.0 * g_config.y_step, SHAKE_Z_UP);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(2, g_state.x_default - 30.0,
-                     g_state.y_start + 2.0 * g_state.y_step, 10.0);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(2, g_config.x_default - SHAKE_X_BACK,
+                     g_config.y_start + 2.0 * g_config.y_step, SHAKE_Z_DOWN);
+            state_unlock();
             wait_all_reach();
         }
 
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         set_site(2, x_tmp, y_tmp, z_tmp);
-        k_mutex_unlock(&g_state_mutex);
+        state_unlock();
         wait_all_reach();
 
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         g_state.move_speed = 1.0;
-        k_mutex_unlock(&g_state_mutex);
-        body_left(15);
+        state_unlock();
+        body_left(GESTURE_BODY_SHIFT);
     }
     else
     {
         /*************************************/
         /* Shake with Leg 0 (Front-Right)    */
         /*************************************/
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         g_state.move_speed = 1.0;
-        k_mutex_unlock(&g_state_mutex);
-        body_left(15);
+        state_unlock();
+        body_left(GESTURE_BODY_SHIFT);
 
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         x_tmp = g_state.site_now[0][0];
         y_tmp = g_state.site_now[0][1];
         z_tmp = g_state.site_now[0][2];
-        k_mutex_unlock(&g_state_mutex);
+        state_unlock();
 
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         g_state.move_speed = local_body_move_speed;
-        k_mutex_unlock(&g_state_mutex);
+        state_unlock();
 
-        for (int j = 0; j < step; j++)
+        for (int j = 0; j < step && !command_cancelled(); j++)
         {
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.x_default - 30.0,
-                     g_state.y_start + 2.0 * g_state.y_step, 55.0);
+            state_lock(K_FOREVER);
+            set_site(0, g_config.x_default - SHAKE_X_BACK,
+                     g_config.y_start + 2.0 * g_config.y_step, SHAKE_Z_UP);
 
-            k_mutex_unlock(&g_state_mutex);
+            state_unlock();
             wait_all_reach();
 
-            k_mutex_lock(&g_state_mutex, K_FOREVER);
-            set_site(0, g_state.x_default - 30.0,
-                     g_state.y_start + 2.0 * g_state.y_step, 10.0);
-            k_mutex_unlock(&g_state_mutex);
+            state_lock(K_FOREVER);
+            set_site(0, g_config.x_default - SHAKE_X_BACK,
+                     g_config.y_start + 2.0 * g_config.y_step, SHAKE_Z_DOWN);
+            state_unlock();
             wait_all_reach();
         }
 
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         set_site(0, x_tmp, y_tmp, z_tmp);
 
-        k_mutex_unlock(&g_state_mutex);
+        state_unlock();
         wait_all_reach();
 
-        k_mutex_lock(&g_state_mutex, K_FOREVER);
+        state_lock(K_FOREVER);
         g_state.move_speed = 1.0;
-        k_mutex_unlock(&g_state_mutex);
-        body_right(15);
+        state_unlock();
+        body_right(GESTURE_BODY_SHIFT);
     }
 }
@@ -0,0 +1,682 @@
+/*======================================================================
+ * File:    gait_asset.c
+ * Date:    2026-10-19
+ * Purpose: Stores gaits uploaded over the network in a flash partition and
+ *plays them. A gait asset is a header followed by its keyframes, each one
+ *the coordinates it changes as deltas of quantised positions (format in
+ *tools/gait_asset.py). The partition holds them as an append only log, the
+ *last record of a name replacing the previous ones. Assets are validated in
+ *RAM before being written and streamed from flash while they play.
+ *====================================================================*/
+#include "gait_asset.h"
+#include "reach_map.h"
+#include "robot_state.h"
+#include "spider_robot.h"
+#include "state_lock.h"
+#include "zephyr/kernel.h"
+#include "zephyr/sys/util.h"
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+
+LOG_MODULE_REGISTER(gait_asset, CONFIG_SPIDER_LOG_LEVEL);
+
+// storage_partition is left to the settings, the app doesn't boot through
+// MCUboot and has no use for its swap scratch
+#if FIXED_PARTITION_EXISTS(gait_partition)
+#define GAIT_PARTITION_ID FIXED_PARTITION_ID(gait_partition)
+#elif FIXED_PARTITION_EXISTS(scratch_partition)
+#define GAIT_PARTITION_ID FIXED_PARTITION_ID(scratch_partition)
+#elif !defined(CONFIG_SETTINGS)
+#define GAIT_PARTITION_ID FIXED_PARTITION_ID(storage_partition)
+#else
+#error "CONFIG_SPIDER_GAIT_ASSETS needs a gait_partition next to the settings"
+#endif
+
+#define GAIT_ASSET_MAGIC 0x54494147 // "GAIT"
+#define GAIT_ASSET_VERSION 1
+#define CONTROL_SPEED_MASK 0x03
+#define CONTROL_JOINT BIT(2)
+#define AXES_MASK BIT_MASK(NB_LEGS * NB_JOINTS)
+// Largest flash write block handled, the records are padded to it
+#define MAX_WRITE_ALIGN 32
+#define READ_WINDOW_SIZE 32
+
+/**
+ * @brief Record header, little endian
+ */
+struct gait_asset_header
+{
+        uint32_t magic;
+        uint8_t version;
+        uint8_t quantum; // 1/100 mm
+        uint16_t nb_keyframes;
+        uint16_t data_len; // keyframes, bytes
+        uint16_t crc;      // CRC-16/CCITT of the keyframes
+        char name[GAIT_ASSET_NAME_SIZE];
+} __packed;
+
+BUILD_ASSERT(sizeof(struct gait_asset_header) == 24);
+
+/**
+ * @brief Reads the keyframes of an asset byte by byte, from RAM or through a
+ * small window of flash
+ */
+struct asset_reader
+{
+        const struct flash_area* fa; // NULL: reads mem
+        const uint8_t* mem;
+        off_t off;
+        off_t end;
+        uint8_t window[READ_WINDOW_SIZE];
+        size_t pos;
+        size_t len;
+};
+
+/**
+ * @brief Keyframe being decoded. The coordinates accumulate the deltas, in
+ * quanta
+ */
+struct keyframe
+{
+        uint8_t control;
+        uint16_t axes; // bit NB_JOINTS * leg + axis
+        int16_t quanta[NB_LEGS][NB_JOINTS];
+};
+
+static const double* const move_speeds[] = {
+    &g_config.leg_move_speed,
+    &g_config.body_move_speed,
+    &g_config.stand_seat_speed,
+    &g_config.spot_turn_speed,
+};
+
+// Uploads are validated there before being written, padded to the write block
+static uint8_t asset_buf[ROUND_UP(CONFIG_SPIDER_GAIT_ASSET_MAX_SIZE,
+                                  MAX_WRITE_ALIGN)];
+static size_t upload_size;
+static size_t upload_used;
+
+// Flash writes, and erases against the gait being played
+K_MUTEX_DEFINE(asset_lock);
+static bool playing;
+
+static void reader_init(struct asset_reader* r, const struct flash_area* fa,
+                        const uint8_t* mem, off_t off, size_t len)
+{
+    memset(r, 0, sizeof(*r));
+    r->fa = fa;
+    r->mem = mem;
+    r->off = off;
+    r->end = off + len;
+}
+
+static int read_byte(struct asset_reader* r, uint8_t* byte)
+{
+    if (r->pos == r->len)
+    {
+        size_t len = MIN(sizeof(r->window), r->end - r->off);
+
+        if (len == 0)
+            return -EBADMSG;
+        if (r->fa == NULL)
+            memcpy(r->window, r->mem + r->off, len);
+        else
+        {
+            int ret = flash_area_read(r->fa, r->off, r->window, len);
+            if (ret < 0)
+                return ret;
+        }
+        r->off += len;
+        r->pos = 0;
+        r->len = len;
+    }
+    *byte = r->window[r->pos++];
+    return 0;
+}
+
+static bool reader_done(const struct asset_reader* r)
+{
+    return r->pos == r->len && r->off == r->end;
+}
+
+/**
+ * @brief zigzag LEB128 varint, at most 32 bits
+ */
+static int read_varint(struct asset_reader* r, int32_t* value)
+{
+    uint32_t zigzag = 0;
+
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        uint8_t byte;
+        int ret = read_byte(r, &byte);
+        if (ret < 0)
+            return ret;
+
+        zigzag |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            *value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+            return 0;
+        }
+    }
+    return -EBADMSG;
+}
+
+/**
+ * @brief decodes the next keyframe on top of the previous one
+ *
+ * @return 0, -EBADMSG if the data is malformed, or a flash error
+ */
+static int read_keyframe(struct asset_reader* r, struct keyframe* kf)
+{
+    uint8_t bytes[3];
+
+    for (int i = 0; i < ARRAY_SIZE(bytes); i++)
+    {
+        int ret = read_byte(r, &bytes[i]);
+        if (ret < 0)
+            return ret;
+    }
+    kf->control = bytes[0];
+    kf->axes = sys_get_le16(&bytes[1]);
+    if ((kf->control & ~(CONTROL_SPEED_MASK | CONTROL_JOINT)) != 0 ||
+        (kf->axes & ~AXES_MASK) != 0)
+        return -EBADMSG;
+
+    for (int axis = 0; axis < NB_LEGS * NB_JOINTS; axis++)
+    {
+        int16_t* quanta = &kf->quanta[axis / NB_JOINTS][axis % NB_JOINTS];
+        int32_t delta;
+
+        if ((kf->axes & BIT(axis)) == 0)
+            continue;
+        int ret = read_varint(r, &delta);
+        if (ret < 0)
+            return ret;
+        int64_t sum = (int64_t)*quanta + delta;
+        if (sum < INT16_MIN || sum > INT16_MAX)
+            return -EBADMSG;
+        *quanta = sum;
+    }
+    return 0;
+}
+
+static inline double quanta_to_mm(int16_t quanta, uint8_t quantum)
+{
+    return (double)(quanta * quantum) / 100.0;
+}
+
+static bool name_valid(const char name[GAIT_ASSET_NAME_SIZE])
+{
+    size_t len = strnlen(name, GAIT_ASSET_NAME_SIZE);
+
+    if (len == 0 || len == GAIT_ASSET_NAME_SIZE)
+        return false;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!isgraph((unsigned char)name[i]))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief checks an asset held in RAM: header, CRC, keyframes, and that every
+ * target whose three coordinates are set by the asset is reachable. Targets
+ * keeping a coordinate of the pose the gait starts from are checked by
+ * set_site() when it plays.
+ *
+ * @return 0, -EBADMSG if malformed, -EDOM if a leg can't reach a target
+ */
+static int validate(const uint8_t* data, size_t len,
+                    struct gait_asset_header* hdr)
+{
+    struct asset_reader reader;
+    struct keyframe kf = {0};
+    uint16_t known = 0;
+
+    if (len < sizeof(*hdr))
+        return -EBADMSG;
+    memcpy(hdr, data, sizeof(*hdr));
+    if (sys_le32_to_cpu(hdr->magic) != GAIT_ASSET_MAGIC ||
+        hdr->version != GAIT_ASSET_VERSION || hdr->quantum == 0 ||
+        sys_le16_to_cpu(hdr->data_len) != len - sizeof(*hdr) ||
+        !name_valid(hdr->name))
+        return -EBADMSG;
+
+    const uint8_t* keyframes = data + sizeof(*hdr);
+    size_t data_len = len - sizeof(*hdr);
+    if (crc16_ccitt(0xFFFF, keyframes, data_len) != sys_le16_to_cpu(hdr->crc))
+        return -EBADMSG;
+
+    reader_init(&reader, NULL, keyframes, 0, data_len);
+    for (int i = 0; i < sys_le16_to_cpu(hdr->nb_keyframes); i++)
+    {
+        int ret = read_keyframe(&reader, &kf);
+        if (ret < 0)
+            return ret;
+        known |= kf.axes;
+
+        for (int leg = 0; leg < NB_LEGS; leg++)
+        {
+            uint16_t leg_axes = BIT_MASK(NB_JOINTS) << (NB_JOINTS * leg);
+            const int16_t* q = kf.quanta[leg];
+
+            if ((kf.axes & leg_axes) == 0 || (known & leg_axes) != leg_axes)
+                continue;
+            if (!reach_map_reachable(quanta_to_mm(q[0], hdr->quantum),
+                                     quanta_to_mm(q[1], hdr->quantum),
+                                     quanta_to_mm(q[2], hdr->quantum)))
+            {
+                LOG_WRN("Gait %s: leg %d can't reach keyframe %d", hdr->name,
+                        leg, i);
+                return -EDOM;
+            }
+        }
+    }
+    return reader_done(&reader) ? 0 : -EBADMSG;
+}
+
+static size_t record_size(const struct gait_asset_header* hdr, size_t align)
+{
+    return ROUND_UP(sizeof(*hdr) + sys_le16_to_cpu(hdr->data_len), align);
+}
+
+/**
+ * @brief reads the record at off.
+ *
+ * @return 0 if intact, -EBADMSG if its keyframes are corrupted (an
+ * interrupted write), -ENOENT past the last record
+ */
+static int read_record(const struct flash_area* fa, off_t off,
+                       struct gait_asset_header* hdr)
+{
+    struct asset_reader reader;
+    uint16_t crc = 0xFFFF;
+
+    if (off + sizeof(*hdr) > fa->fa_size ||
+        flash_area_read(fa, off, hdr, sizeof(*hdr)) < 0 ||
+        sys_le32_to_cpu(hdr->magic) != GAIT_ASSET_MAGIC ||
+        off + record_size(hdr, 1) > fa->fa_size)
+        return -ENOENT;
+
+    reader_init(&reader, fa, NULL, off + sizeof(*hdr),
+                sys_le16_to_cpu(hdr->data_len));
+    while (!reader_done(&reader))
+    {
+        uint8_t byte;
+        if (read_byte(&reader, &byte) < 0)
+            return -EBADMSG;
+        crc = crc16_ccitt(crc, &byte, 1);
+    }
+    if (crc != sys_le16_to_cpu(hdr->crc) || !name_valid(hdr->name))
+        return -EBADMSG;
+    return 0;
+}
+
+/**
+ * @brief walks the log, calling fn on the intact records.
+ *
+ * @return offset of the free space following the last record
+ */
+static off_t scan(const struct flash_area* fa,
+                  void (*fn)(off_t off, const struct gait_asset_header* hdr,
+                             void* arg),
+                  void* arg)
+{
+    struct gait_asset_header hdr;
+    size_t align = flash_area_align(fa);
+    off_t off = 0;
+    int ret;
+
+    while ((ret = read_record(fa, off, &hdr)) != -ENOENT)
+    {
+        if (ret == 0 && fn != NULL)
+            fn(off, &hdr, arg);
+        off += record_size(&hdr, align);
+    }
+    return off;
+}
+
+struct find_arg
+{
+        const char* name;
+        off_t off;
+        struct gait_asset_header hdr;
+};
+
+static void find_record(off_t off, const struct gait_asset_header* hdr,
+                        void* arg)
+{
+    struct find_arg* find = arg;
+
+    if (strncmp(hdr->name, find->name, GAIT_ASSET_NAME_SIZE) == 0)
+    {
+        find->off = off;
+        find->hdr = *hdr;
+    }
+}
+
+/**
+ * @brief latest record stored under the name
+ *
+ * @return its offset, -ENOENT if there is none
+ */
+static off_t find(const struct flash_area* fa, const char* name,
+                  struct gait_asset_header* hdr)
+{
+    struct find_arg arg = {.name = name, .off = -ENOENT};
+
+    scan(fa, find_record, &arg);
+    if (arg.off >= 0)
+        *hdr = arg.hdr;
+    return arg.off;
+}
+
+static bool region_erased(const struct flash_area* fa, off_t off, size_t len)
+{
+    uint8_t erased = flash_area_erased_val(fa);
+    uint8_t window[READ_WINDOW_SIZE];
+
+    while (len > 0)
+    {
+        size_t chunk = MIN(len, sizeof(window));
+
+        if (flash_area_read(fa, off, window, chunk) < 0)
+            return false;
+        for (size_t i = 0; i < chunk; i++)
+        {
+            if (window[i] != erased)
+                return false;
+        }
+        off += chunk;
+        len -= chunk;
+    }
+    return true;
+}
+
+static void fill_info(struct gait_asset_info* info,
+                      const struct gait_asset_header* hdr)
+{
+    memcpy(info->name, hdr->name, sizeof(info->name));
+    info->size = sizeof(*hdr) + sys_le16_to_cpu(hdr->data_len);
+    info->keyframes = sys_le16_to_cpu(hdr->nb_keyframes);
+}
+
+/**
+ * @brief validates an asset and appends it to the log, replacing the one
+ * stored under the same name if any.
+ *
+ * @return 0, -EBADMSG or -EDOM if invalid (see validate()), -EFBIG if larger
+ * than CONFIG_SPIDER_GAIT_ASSET_MAX_SIZE, -ENOSPC once the partition is full
+ */
+int gait_asset_store(const uint8_t* data, size_t len,
+                     struct gait_asset_info* info)
+{
+    const struct flash_area* fa;
+    struct gait_asset_header hdr;
+
+    if (len > CONFIG_SPIDER_GAIT_ASSET_MAX_SIZE)
+        return -EFBIG;
+    int ret = validate(data, len, &hdr);
+    if (ret < 0)
+        return ret;
+
+    ret = flash_area_open(GAIT_PARTITION_ID, &fa);
+    if (ret < 0)
+        return ret;
+    k_mutex_lock(&asset_lock, K_FOREVER);
+
+    size_t align = flash_area_align(fa);
+    size_t size = record_size(&hdr, align);
+    off_t off = scan(fa, NULL, NULL);
+    if (align > MAX_WRITE_ALIGN)
+        ret = -ENOTSUP;
+    else if (off + size > fa->fa_size)
+        ret = -ENOSPC;
+    else if (!region_erased(fa, off, size))
+    {
+        // Nothing was ever stored, the partition holds something else
+        if (off == 0)
+            ret = flash_area_erase(fa, 0, fa->fa_size);
+        else
+            ret = -EIO;
+    }
+
+    if (ret == 0)
+    {
+        memmove(asset_buf, data, len);
+        memset(asset_buf + len, flash_area_erased_val(fa), size - len);
+        ret = flash_area_write(fa, off, asset_buf, size);
+    }
+
+    k_mutex_unlock(&asset_lock);
+    flash_area_close(fa);
+    if (ret < 0)
+    {
+        LOG_ERR("Failed storing gait %s (%d)", hdr.name, ret);
+        return ret;
+    }
+
+    fill_info(info, &hdr);
+    LOG_INF("Gait %s stored, %u bytes, %u keyframes", info->name, info->size,
+            info->keyframes);
+    return 0;
+}
+
+/**
+ * @brief starts receiving an asset of that size, dropping any upload left
+ * unfinished.
+ */
+int gait_asset_upload_start(size_t size)
+{
+    if (size < sizeof(struct gait_asset_header) ||
+        size > CONFIG_SPIDER_GAIT_ASSET_MAX_SIZE)
+        return -EFBIG;
+    upload_size = size;
+    upload_used = 0;
+    return 0;
+}
+
+/**
+ * @return the bytes still expected, or -EINVAL if no upload is in progress
+ * or the data overflows it
+ */
+int gait_asset_upload_append(const uint8_t* data, size_t len)
+{
+    if (upload_size == 0 || len > upload_size - upload_used)
+    {
+        upload_size = 0;
+        return -EINVAL;
+    }
+    memcpy(asset_buf + upload_used, data, len);
+    upload_used += len;
+    return upload_size - upload_used;
+}
+
+/**
+ * @brief stores the asset received, see gait_asset_store()
+ */
+int gait_asset_upload_commit(struct gait_asset_info* info)
+{
+    size_t size = upload_size;
+
+    if (size == 0 || upload_used != size)
+        return -EINVAL;
+    upload_size = 0;
+    return gait_asset_store(asset_buf, size, info);
+}
+
+struct foreach_arg
+{
+        const struct flash_area* fa;
+        void (*fn)(const struct gait_asset_info* info, void* arg);
+        void* arg;
+};
+
+static void list_record(off_t off, const struct gait_asset_header* hdr,
+                        void* arg)
+{
+    struct foreach_arg* foreach = arg;
+    struct gait_asset_header latest;
+    struct gait_asset_info info;
+
+    // Replaced by a later upload
+    if (find(foreach->fa, hdr->name, &latest) != off)
+        return;
+    fill_info(&info, hdr);
+    foreach->fn(&info, foreach->arg);
+}
+
+/**
+ * @brief calls fn on every gait stored
+ *
+ * @return the free space left in the partition, bytes, or a negative errno
+ */
+int gait_asset_foreach(void (*fn)(const struct gait_asset_info* info,
+                                  void* arg),
+                       void* arg)
+{
+    struct foreach_arg foreach = {.fn = fn, .arg = arg};
+
+    int ret = flash_area_open(GAIT_PARTITION_ID, &foreach.fa);
+    if (ret < 0)
+        return ret;
+    k_mutex_lock(&asset_lock, K_FOREVER);
+    off_t used = scan(foreach.fa, list_record, &foreach);
+    k_mutex_unlock(&asset_lock);
+    flash_area_close(foreach.fa);
+    return foreach.fa->fa_size - used;
+}
+
+/**
+ * @brief erases every gait stored.
+ *
+ * @return 0, -EBUSY while one is playing
+ */
+int gait_asset_erase(void)
+{
+    const struct flash_area* fa;
+
+    int ret = flash_area_open(GAIT_PARTITION_ID, &fa);
+    if (ret < 0)
+        return ret;
+    k_mutex_lock(&asset_lock, K_FOREVER);
+    ret = playing ? -EBUSY : flash_area_erase(fa, 0, fa->fa_size);
+    k_mutex_unlock(&asset_lock);
+    flash_area_close(fa);
+    return ret;
+}
+
+/**
+ * @brief name of the stored gait a command runs, "g.<name>"
+ *
+ * @return NULL if the command doesn't name a stored gait
+ */
+const char* gait_asset_command(const char* command)
+{
+    const struct flash_area* fa;
+    struct gait_asset_header hdr;
+    const char* name = command + strlen(GAIT_ASSET_PREFIX);
+
+    if (strncmp(command, GAIT_ASSET_PREFIX, strlen(GAIT_ASSET_PREFIX)) != 0 ||
+        strlen(name) >= GAIT_ASSET_NAME_SIZE ||
+        flash_area_open(GAIT_PARTITION_ID, &fa) < 0)
+        return NULL;
+
+    k_mutex_lock(&asset_lock, K_FOREVER);
+    off_t off = find(fa, name, &hdr);
+    k_mutex_unlock(&asset_lock);
+    flash_area_close(fa);
+    return (off >= 0) ? name : NULL;
+}
+
+/**
+ * @brief plays the keyframes of the asset once, streamed from flash. The
+ * coordinates restart from 0 on each repetition.
+ */
+static int play(const struct flash_area* fa, off_t off,
+                const struct gait_asset_header* hdr)
+{
+    struct asset_reader reader;
+    struct keyframe kf = {0};
+
+    reader_init(&reader, fa, NULL, off + sizeof(*hdr),
+                sys_le16_to_cpu(hdr->data_len));
+    for (int i = 0; i < sys_le16_to_cpu(hdr->nb_keyframes); i++)
+    {
+        int ret = read_keyframe(&reader, &kf);
+        if (ret < 0)
+            return ret;
+
+        state_lock(K_FOREVER);
+        g_state.move_speed = *move_speeds[kf.control & CONTROL_SPEED_MASK];
+        for (int leg = 0; leg < NB_LEGS && ret == 0; leg++)
+        {
+            double site[NB_JOINTS];
+
+            if ((kf.axes & (BIT_MASK(NB_JOINTS) << (NB_JOINTS * leg))) == 0)
+                continue;
+            for (int axis = 0; axis < NB_JOINTS; axis++)
+                site[axis] = (kf.axes & BIT(NB_JOINTS * leg + axis))
+                                 ? quanta_to_mm(kf.quanta[leg][axis],
+                                                hdr->quantum)
+                                 : KEEP;
+            if (kf.control & CONTROL_JOINT)
+                ret = set_site_joint(leg, site[0], site[1], site[2]);
+            else
+                ret = set_site(leg, site[0], site[1], site[2]);
+        }
+        state_unlock();
+
+        // Uploaded data: stop rather than go on from an unexpected pose
+        if (ret < 0)
+        {
+            LOG_ERR("Gait %s stopped at keyframe %d (%d)", hdr->name, i, ret);
+            return ret;
+        }
+        wait_all_reach();
+    }
+    return 0;
+}
+
+/**
+ * @brief runs a stored gait.
+ *
+ * @return 0, -ENOENT if there is no gait of that name, or the error that
+ * stopped it
+ */
+int gait_asset_run(const char* name, unsigned int step)
+{
+    const struct flash_area* fa;
+    struct gait_asset_header hdr;
+
+    int ret = flash_area_open(GAIT_PARTITION_ID, &fa);
+    if (ret < 0)
+        return ret;
+
+    k_mutex_lock(&asset_lock, K_FOREVER);
+    off_t off = find(fa, name, &hdr);
+    playing = off >= 0;
+    k_mutex_unlock(&asset_lock);
+
+    if (off < 0)
+    {
+        LOG_WRN("No gait %s stored", name);
+        ret = -ENOENT;
+    }
+    while (off >= 0 && ret == 0 && step-- > 0)
+        ret = play(fa, off, &hdr);
+
+    k_mutex_lock(&asset_lock, K_FOREVER);
+    playing = false;
+    k_mutex_unlock(&asset_lock);
+    flash_area_close(fa);
+    return ret;
+}
@@ -0,0 +1,360 @@
+/*======================================================================
+ * File:    gait_cache.c
+ * Date:    2026-10-19
+ * Purpose: Compiles one step of each walking gait into the servo frames of
+ *its motor ticks at boot, by running the gait with the ticks executed right
+ *away instead of waiting for the motor thread. A gait step only depends on
+ *the pose it starts from, so a step is compiled for every pose the gait goes
+ *through. When a command finds the robot at rest in one of these poses the
+ *motor tick streams the frames to the servos, without any kinematics.
+ *====================================================================*/
+#include "gait_cache.h"
+#include "profiling.h"
+#include "robot_state.h"
+#include "spider_robot.h"
+#include "state_lock.h"
+#include "zephyr/kernel.h"
+#include "zephyr/sys/util.h"
+#include <errno.h>
+#include <string.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(gait_cache, CONFIG_SPIDER_LOG_LEVEL);
+
+/**
+ * @brief one step of a gait, from the rest pose it starts from
+ */
+struct gait_clip
+{
+        void (*gait)(unsigned int step);
+        double start[NB_LEGS][NB_JOINTS];
+        // State the step leaves, restored after its last frame
+        double end[NB_LEGS][NB_JOINTS];
+        bool end_joint_mode[NB_LEGS];
+        double end_move_speed;
+        uint32_t first_frame;
+        uint32_t nb_frames;
+        uint32_t keyframes;
+        uint32_t ik_calls;
+};
+
+static void (*const cached_gaits[])(unsigned int) = {
+    step_forward,
+    step_back,
+    turn_left,
+    turn_right,
+};
+
+static uint8_t frames[CONFIG_SPIDER_GAIT_CACHE_FRAMES][NB_LEGS][NB_JOINTS];
+static struct gait_clip clips[CONFIG_SPIDER_GAIT_CACHE_CLIPS];
+static uint32_t nb_clips;
+static uint32_t nb_frames;
+
+// Compilation, done before the motor thread runs
+static bool compiling;
+static struct gait_clip* recording;
+static bool overflow;
+
+// Under g_state_mutex
+static bool enabled = true;
+static const struct gait_clip* playing;
+static uint32_t play_index;
+static struct gait_cache_stats stats;
+
+static bool is_cached(void (*gait)(unsigned int))
+{
+    for (int i = 0; i < ARRAY_SIZE(cached_gaits); i++)
+    {
+        if (cached_gaits[i] == gait)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief step of the gait starting from the current pose, if the legs rest.
+ * Called with g_state_mutex held.
+ *
+ * A resting leg left in joint space by set_site_joint() holds the angles
+ * solved for its site, the ones the motor tick would solve again otherwise:
+ * the frames don't depend on it.
+ */
+static const struct gait_clip* find_clip(void (*gait)(unsigned int))
+{
+    if (!all_legs_reached())
+        return NULL;
+
+    for (uint32_t i = 0; i < nb_clips; i++)
+    {
+        const struct gait_clip* clip = &clips[i];
+
+        if (clip->gait == gait &&
+            memcmp(clip->start, g_state.site_now, sizeof(clip->start)) == 0)
+            return clip;
+    }
+    return NULL;
+}
+
+bool gait_cache_recording(void) { return compiling; }
+
+/**
+ * @brief wait_all_reach() while compiling: runs the motor ticks until the
+ * legs reach their targets and stores their frames.
+ */
+void gait_cache_record_reach(void)
+{
+    uint8_t frame[NB_LEGS][NB_JOINTS];
+    bool moved = false;
+
+    state_lock(K_FOREVER);
+    while (!all_legs_reached())
+    {
+        motors_step(frame, &moved);
+        if (recording == NULL)
+            continue;
+        if (nb_frames == ARRAY_SIZE(frames))
+        {
+            overflow = true;
+            continue;
+        }
+        memcpy(frames[nb_frames++], frame, sizeof(frame));
+        recording->nb_frames++;
+    }
+    g_state.keyframe++;
+    if (recording != NULL)
+        recording->keyframes++;
+    state_unlock();
+}
+
+/**
+ * @brief compiles one step of the gait from the current pose.
+ *
+ * @return 0, or -ENOMEM once the cache is full
+ */
+static int compile_step(void (*gait)(unsigned int))
+{
+    if (nb_clips == ARRAY_SIZE(clips))
+        return -ENOMEM;
+
+    struct gait_clip* clip = &clips[nb_clips];
+    memset(clip, 0, sizeof(*clip));
+    clip->gait = gait;
+    clip->first_frame = nb_frames;
+
+    state_lock(K_FOREVER);
+    memcpy(clip->start, g_state.site_now, sizeof(clip->start));
+    state_unlock();
+
+    uint32_t ik_calls = ik_call_count();
+    overflow = false;
+    recording = clip;
+    gait(1);
+    recording = NULL;
+    clip->ik_calls = ik_call_count() - ik_calls;
+
+    if (overflow)
+    {
+        nb_frames = clip->first_frame;
+        return -ENOMEM;
+    }
+
+    state_lock(K_FOREVER);
+    memcpy(clip->end, g_state.site_now, sizeof(clip->end));
+    memcpy(clip->end_joint_mode, g_state.joint_mode,
+           sizeof(clip->end_joint_mode));
+    clip->end_move_speed = g_state.move_speed;
+    state_unlock();
+
+    nb_clips++;
+    return 0;
+}
+
+/**
+ * @brief compiles the walking gaits starting from the standing pose. Must run
+ * before the motor thread starts (robot_ready), the robot state is restored
+ * afterwards.
+ */
+void gait_cache_compile(void)
+{
+    // Too big for the caller's stack
+    static robot_state_t boot, standing;
+    int64_t start_us = cmd_timestamp_us();
+    int ret = 0;
+
+    robot_state_snapshot(&boot);
+    compiling = true;
+    stand(1);
+    robot_state_snapshot(&standing);
+
+    for (int i = 0; i < ARRAY_SIZE(cached_gaits) && ret == 0; i++)
+    {
+        const struct gait_clip* clip;
+
+        state_lock(K_FOREVER);
+        g_state = standing;
+        state_unlock();
+
+        // Each step starts from the pose the previous one left, until the
+        // gait comes back to a pose already compiled
+        do
+        {
+            state_lock(K_FOREVER);
+            clip = find_clip(cached_gaits[i]);
+            state_unlock();
+        } while (clip == NULL && (ret = compile_step(cached_gaits[i])) == 0);
+    }
+    if (ret != 0)
+        LOG_WRN("Gait cache full, the remaining steps are computed live");
+
+    compiling = false;
+    state_lock(K_FOREVER);
+    g_state = boot;
+    stats.clips = nb_clips;
+    stats.frames = nb_frames;
+    stats.bytes = nb_frames * sizeof(frames[0]) + nb_clips * sizeof(clips[0]);
+    stats.compile_us = cmd_timestamp_us() - start_us;
+    state_unlock();
+
+    LOG_INF("%u gait steps compiled, %u frames, %u bytes in %u us", stats.clips,
+            stats.frames, stats.bytes, stats.compile_us);
+}
+
+/**
+ * @brief leaves the robot in the state the live step would have left.
+ * Called with g_state_mutex held.
+ */
+static void finish_clip(void)
+{
+    memcpy(g_state.site_now, playing->end, sizeof(g_state.site_now));
+    memcpy(g_state.site_expect, playing->end, sizeof(g_state.site_expect));
+    // The walking gaits move the legs with set_site(), which leaves joint space
+    for (int leg = 0; leg < NB_LEGS; leg++)
+        g_state.joint_mode[leg] &= playing->end_joint_mode[leg];
+    memset(g_state.joint_ticks, 0, sizeof(g_state.joint_ticks));
+    g_state.move_speed = playing->end_move_speed;
+    g_state.keyframe += playing->keyframes;
+    playing = NULL;
+}
+
+/**
+ * @brief motor tick side of the playback. Called with g_state_mutex held.
+ *
+ * @param frame next frame of the clip being played
+ * @param moving_legs NB_LEGS until the last frame, 0 on it
+ * @return false if no clip is being played
+ */
+bool gait_cache_next_frame(uint8_t frame[NB_LEGS][NB_JOINTS],
+                           uint32_t* moving_legs)
+{
+    if (playing == NULL)
+        return false;
+
+    memcpy(frame, frames[playing->first_frame + play_index],
+           sizeof(frames[0]));
+    *moving_legs = NB_LEGS;
+    if (++play_index == playing->nb_frames)
+    {
+        finish_clip();
+        *moving_legs = 0;
+    }
+    return true;
+}
+
+/**
+ * @brief true while the motor tick writes the frames of a step. Called with
+ * g_state_mutex held.
+ */
+bool gait_cache_playing(void)
+{
+    return playing != NULL;
+}
+
+/**
+ * @brief plays one step of the gait if it was compiled from the current pose.
+ *
+ * @return false if it must be computed live
+ */
+static bool play_step(void (*gait)(unsigned int))
+{
+    state_lock(K_FOREVER);
+    const struct gait_clip* clip = enabled ? find_clip(gait) : NULL;
+    if (clip != NULL)
+    {
+        playing = clip;
+        play_index = 0;
+        if (clip->nb_frames == 0)
+            finish_clip();
+        stats.plays++;
+        stats.ik_saved += clip->ik_calls;
+    }
+    else if (enabled)
+        stats.misses++;
+    state_unlock();
+
+    if (clip == NULL)
+        return false;
+    prof_first_site();
+    motors_wake();
+
+    // Polled like wait_all_reach(), the frames are written by the motor tick
+    while (true)
+    {
+        state_lock(K_FOREVER);
+        bool done = playing == NULL;
+        state_unlock();
+
+        if (done)
+            return true;
+        k_msleep(2);
+    }
+}
+
+/**
+ * @brief runs a gait command, step by step from the cache when possible.
+ */
+void gait_cache_run(void (*gait)(unsigned int), unsigned int step)
+{
+    if (!is_cached(gait))
+    {
+        gait(step);
+        return;
+    }
+
+    while (step-- > 0 && !command_cancelled())
+    {
+        if (!play_step(gait))
+            gait(1);
+    }
+}
+
+/**
+ * @brief drops the compiled steps, made with parameters that changed: every
+ * step is computed live until the next boot compiles them again. Called with
+ * g_state_mutex held, between two steps.
+ */
+void gait_cache_invalidate(void)
+{
+    if (nb_clips == 0)
+        return;
+
+    nb_clips = 0;
+    nb_frames = 0;
+    stats.clips = 0;
+    stats.frames = 0;
+    stats.bytes = 0;
+    LOG_INF("Gait cache dropped");
+}
+
+void gait_cache_enable(bool enable)
+{
+    state_lock(K_FOREVER);
+    enabled = enable;
+    state_unlock();
+}
+
+void gait_cache_get_stats(struct gait_cache_stats* out)
+{
+    state_lock(K_FOREVER);
+    *out = stats;
+    state_unlock();
+}
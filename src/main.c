@@ -1,18 +1,56 @@
+#include "boot_report.h"
+#include "gait_cache.h"
+#include "robot_settings.h"
 #include "robot_state.h"
 #include "servos.h"
+#include "spider_robot.h"
 #include <zephyr/device.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/pwm.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 
-LOG_MODULE_REGISTER(ServoApp, LOG_LEVEL_DBG);
+LOG_MODULE_REGISTER(ServoApp, CONFIG_SPIDER_LOG_LEVEL);
 
+#if defined(CONFIG_SPIDER_SMP_PINNING)
+/**
+ * @brief pins a thread to a core and starts it. Every other thread, the
+ * network stack included, stays on CPU 0 (SCHED_CPU_MASK_PIN_ONLY).
+ */
+static void start_pinned(k_tid_t thread, int cpu)
+{
+    int ret = k_thread_cpu_pin(thread, cpu);
+    if (ret < 0)
+        LOG_ERR("Failed pinning %s to CPU %d (%d)", k_thread_name_get(thread),
+                cpu, ret);
+    k_thread_start(thread);
+}
+#endif
+
+/**
+ * @brief brings the motion subsystem up as soon as possible. Networking comes
+ * up on its own in the tcp server thread meanwhile.
+ */
 void main(void)
 {
+    boot_mark(BOOT_STAGE_MAIN);
+#if defined(CONFIG_SPIDER_SMP_PINNING)
+    // The control path alone on its core, away from the network
+    start_pinned(tcp_server_thread_id, CONFIG_SPIDER_NET_CPU);
+    start_pinned(motor_thread_id, CONFIG_SPIDER_CONTROL_CPU);
+    start_pinned(gait_thread_id, CONFIG_SPIDER_CONTROL_CPU);
+#endif
     init_robot_state();
+    robot_settings_init();
+    boot_mark(BOOT_STAGE_STATE);
     if (init_servos() < 0)
         return;
+    boot_mark(BOOT_STAGE_SERVOS);
+
+    init_stance();
+    gait_cache_compile();
+    k_event_post(&robot_ready, ROBOT_READY);
+    boot_mark(BOOT_STAGE_STANCE);
 
     while (true)
     {
@@ -0,0 +1,200 @@
+/*======================================================================
+ * File:    profiling.c
+ * Date:    2026-10-19
+ * Purpose: Aggregates the cycle counts of the motor tick phases and of the
+ *command latency stages into fixed bucket histograms. Buckets are logarithmic
+ *with 4 sub-buckets per power of two, so recording is a few shifts and an
+ *increment and the percentiles are accurate within 25% at any scale.
+ *====================================================================*/
+#include "profiling.h"
+#include "zephyr/kernel.h"
+#include "zephyr/sys/util.h"
+#include <string.h>
+
+#define SUB_BUCKET_BITS 2
+#define SUB_BUCKETS BIT(SUB_BUCKET_BITS)
+#define PROF_BUCKETS ((32 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS)
+
+struct prof_histogram
+{
+        uint32_t count;
+        uint32_t min;
+        uint32_t max;
+        uint64_t sum;
+        uint32_t buckets[PROF_BUCKETS];
+};
+
+static const char* const phase_names[PROF_PHASE_COUNT] = {
+    [PROF_TICK_PERIOD] = "period",
+    [PROF_TICK] = "tick",
+    [PROF_MUTEX_WAIT] = "mutex",
+    [PROF_IK] = "ik",
+    [PROF_SERVO_WRITE] = "servo",
+    [PROF_LAT_ENQUEUE] = "lat_enqueue",
+    [PROF_LAT_DEQUEUE] = "lat_dequeue",
+    [PROF_LAT_FIRST_SITE] = "lat_site",
+    [PROF_LAT_FIRST_SERVO] = "lat_servo",
+    [PROF_LAT_TOTAL] = "lat_total",
+};
+
+/**
+ * @brief stamps of the command being executed, until its first servo move
+ */
+static struct
+{
+        enum
+        {
+                LAT_IDLE,
+                LAT_WAIT_SITE,
+                LAT_WAIT_SERVO,
+        } state;
+        uint32_t rx;
+        uint32_t enqueued;
+        uint32_t dequeued;
+        uint32_t site;
+} lat;
+static struct k_spinlock lat_lock;
+
+static struct prof_histogram histograms[PROF_PHASE_COUNT];
+static struct k_spinlock prof_lock;
+
+static uint32_t bucket_of(uint32_t cycles)
+{
+    if (cycles < SUB_BUCKETS)
+        return cycles;
+
+    int shift = (31 - __builtin_clz(cycles)) - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS +
+           ((cycles >> shift) & (SUB_BUCKETS - 1));
+}
+
+/**
+ * @brief largest value falling in the bucket.
+ */
+static uint64_t bucket_max(uint32_t bucket)
+{
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+
+    int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t base = (uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return base + BIT64(shift) - 1;
+}
+
+static uint32_t cyc_to_ns(uint64_t cycles)
+{
+    return (uint32_t)MIN(k_cyc_to_ns_floor64(cycles), UINT32_MAX);
+}
+
+/**
+ * @brief records one sample, called from the motor thread on every tick.
+ */
+void prof_add(enum prof_phase phase, uint32_t cycles)
+{
+    struct prof_histogram* h = &histograms[phase];
+    k_spinlock_key_t key = k_spin_lock(&prof_lock);
+
+    if (h->count == 0 || cycles < h->min)
+        h->min = cycles;
+    if (cycles > h->max)
+        h->max = cycles;
+    h->count++;
+    h->sum += cycles;
+    h->buckets[bucket_of(cycles)]++;
+
+    k_spin_unlock(&prof_lock, key);
+}
+
+/**
+ * @brief starts following a command taken by the gait thread.
+ *
+ * @param rx_cycles cycle count when its bytes were received
+ * @param enqueued_cycles cycle count when it entered the queue
+ */
+void prof_cmd_dequeued(uint32_t rx_cycles, uint32_t enqueued_cycles)
+{
+    k_spinlock_key_t key = k_spin_lock(&lat_lock);
+    lat.rx = rx_cycles;
+    lat.enqueued = enqueued_cycles;
+    lat.dequeued = k_cycle_get_32();
+    lat.state = LAT_WAIT_SITE;
+    k_spin_unlock(&lat_lock, key);
+}
+
+/**
+ * @brief called by set_site(), only the first call of a command counts.
+ */
+void prof_first_site(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&lat_lock);
+    if (lat.state == LAT_WAIT_SITE)
+    {
+        lat.site = k_cycle_get_32();
+        lat.state = LAT_WAIT_SERVO;
+    }
+    k_spin_unlock(&lat_lock, key);
+}
+
+/**
+ * @brief called by the motor tick when a leg moved, closes the latency of
+ * the command. A command that never moves a leg is not accounted.
+ */
+void prof_first_servo(void)
+{
+    uint32_t now = k_cycle_get_32();
+
+    k_spinlock_key_t key = k_spin_lock(&lat_lock);
+    if (lat.state != LAT_WAIT_SERVO)
+    {
+        k_spin_unlock(&lat_lock, key);
+        return;
+    }
+    uint32_t rx = lat.rx, enqueued = lat.enqueued;
+    uint32_t dequeued = lat.dequeued, site = lat.site;
+    lat.state = LAT_IDLE;
+    k_spin_unlock(&lat_lock, key);
+
+    prof_add(PROF_LAT_ENQUEUE, enqueued - rx);
+    prof_add(PROF_LAT_DEQUEUE, dequeued - enqueued);
+    prof_add(PROF_LAT_FIRST_SITE, site - dequeued);
+    prof_add(PROF_LAT_FIRST_SERVO, now - site);
+    prof_add(PROF_LAT_TOTAL, now - rx);
+}
+
+void prof_get(enum prof_phase phase, struct prof_summary* summary)
+{
+    static struct prof_histogram h; // too big for the caller's stack
+
+    k_spinlock_key_t key = k_spin_lock(&prof_lock);
+    h = histograms[phase];
+    k_spin_unlock(&prof_lock, key);
+
+    memset(summary, 0, sizeof(*summary));
+    if (h.count == 0)
+        return;
+
+    // Rank of the 99th percentile sample, rounded up
+    uint32_t rank = h.count - h.count / 100;
+    uint32_t seen = 0;
+    uint32_t bucket = 0;
+    while (bucket < PROF_BUCKETS - 1 && seen + h.buckets[bucket] < rank)
+        seen += h.buckets[bucket++];
+
+    summary->count = h.count;
+    summary->min_ns = cyc_to_ns(h.min);
+    summary->max_ns = cyc_to_ns(h.max);
+    summary->mean_ns = cyc_to_ns(h.sum / h.count);
+    summary->p99_ns = cyc_to_ns(MIN(bucket_max(bucket), h.max));
+}
+
+void prof_reset(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&prof_lock);
+    memset(histograms, 0, sizeof(histograms));
+    k_spin_unlock(&prof_lock, key);
+}
+
+const char* prof_phase_name(enum prof_phase phase)
+{
+    return phase_names[phase];
+}
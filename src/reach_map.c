@@ -0,0 +1,58 @@
+/*======================================================================
+ * File:    reach_map.c
+ * Date:    2026-10-19
+ * Purpose: Tells in constant time whether a foot target can be reached, from
+ *the bitmap of the leg workspace generated at build time by
+ *tools/robot_geometry.py (reach_map_data.c). Targets outside of it would make
+ *cartesian_to_polar() take the acos of values beyond [-1, 1].
+ *====================================================================*/
+#include "reach_map.h"
+#include "robot_state.h"
+#include "zephyr/sys/util.h"
+#include <errno.h>
+#include <math.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(reach_map, CONFIG_SPIDER_LOG_LEVEL);
+
+static bool map_valid;
+
+/**
+ * @brief checks that the map was generated for these legs.
+ *
+ * @return 0 if it can be used, -EINVAL otherwise (every target is then
+ * accepted)
+ */
+int reach_map_init(double length_a, double length_b, double length_c)
+{
+    const struct reach_map_info* info = &reach_map_info;
+
+    map_valid = fabs(info->length_a - length_a) < EPSILON &&
+                fabs(info->length_b - length_b) < EPSILON &&
+                fabs(info->length_c - length_c) < EPSILON;
+    if (!map_valid)
+    {
+        LOG_ERR("Reachability map computed for other legs");
+        return -EINVAL;
+    }
+    return 0;
+}
+
+bool reach_map_reachable(double x, double y, double z)
+{
+    const struct reach_map_info* info = &reach_map_info;
+
+    if (!map_valid)
+        return true;
+
+    double w = (x >= 0 ? 1 : -1) * sqrt(x * x + y * y);
+    double col = floor((w - info->w_min) / info->cell_mm);
+    double row = floor((z - info->z_min) / info->cell_mm);
+
+    // Written so that NaN coordinates are out of the grid too
+    if (!(col >= 0 && col < info->cols && row >= 0 && row < info->rows))
+        return false;
+
+    uint32_t bit = (uint32_t)row * info->cols + (uint32_t)col;
+    return (reach_map_bits[bit / 32] & BIT(bit % 32)) != 0;
+}
@@ -0,0 +1,331 @@
+/*======================================================================
+ * File:    robot_settings.c
+ * Date:    2026-10-19
+ * Purpose: Makes the speeds and posture of g_config tunable at runtime through
+ *the settings subsystem, which persists them. A new value is staged and only
+ *copied into g_config before the next command, so that a gait never mixes
+ *old and new parameters. The values derived from the posture are computed
+ *again and the compiled gait steps, made with the old ones, dropped.
+ *====================================================================*/
+#include "robot_settings.h"
+#include "gait_cache.h"
+#include "reach_map.h"
+#include "robot_state.h"
+#include "spider_robot.h"
+#include "state_lock.h"
+#include "zephyr/kernel.h"
+#include "zephyr/sys/util.h"
+#include <errno.h>
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+
+LOG_MODULE_REGISTER(robot_settings, CONFIG_SPIDER_LOG_LEVEL);
+
+#define SETTINGS_SUBTREE "spider"
+#define SETTINGS_KEY_SIZE 32
+
+/**
+ * @brief A field of g_config that can be tuned, and its bounds
+ */
+struct robot_param
+{
+        const char* name; // also its settings key, under SETTINGS_SUBTREE
+        size_t offset;
+        double min, max;
+        bool posture; // the derived values and the reach depend on it
+};
+
+#define PARAM(field, min, max, posture)                                        \
+    {#field, offsetof(struct robot_config, field), min, max, posture}
+
+static const struct robot_param params[] = {
+    // mm per motor tick, before speed_multiple
+    PARAM(speed_multiple, 0.1, 4.0, false),
+    PARAM(spot_turn_speed, 0.1, 20.0, false),
+    PARAM(leg_move_speed, 0.1, 20.0, false),
+    PARAM(body_move_speed, 0.1, 20.0, false),
+    PARAM(stand_seat_speed, 0.1, 20.0, false),
+    // mm, checked against the leg workspace as well
+    PARAM(z_default, -150.0, 0.0, true),
+    PARAM(z_up, -150.0, 0.0, true),
+    PARAM(x_default, 0.0, 150.0, true),
+    PARAM(x_offset, 0.0, 50.0, true),
+    PARAM(y_start, -50.0, 50.0, true),
+    PARAM(y_step, 1.0, 80.0, true),
+};
+
+// Under g_state_mutex
+static struct robot_config pending;
+static bool has_pending;
+
+static double* param_field(struct robot_config* config,
+                           const struct robot_param* param)
+{
+    return (double*)((uint8_t*)config + param->offset);
+}
+
+static double param_value(const struct robot_config* config,
+                          const struct robot_param* param)
+{
+    return *(const double*)((const uint8_t*)config + param->offset);
+}
+
+static const struct robot_param* find_param(const char* name)
+{
+    for (int i = 0; i < ARRAY_SIZE(params); i++)
+    {
+        if (strcmp(name, params[i].name) == 0)
+            return &params[i];
+    }
+    return NULL;
+}
+
+static bool in_range(const struct robot_param* param, double value)
+{
+    // NaN fails both
+    return value >= param->min && value <= param->max;
+}
+
+/**
+ * @brief checks that the legs can reach every site the built-in gaits use
+ * with this posture: the stance and step sites at the three heights and
+ * shifted by the gestures, the turn sites, and the raised leg of the
+ * gestures.
+ *
+ * @return 0, or -EDOM
+ */
+static int check_posture(const struct robot_config* config)
+{
+    struct robot_derived derived;
+
+    if (config->z_up <= config->z_default)
+        return -EDOM;
+    robot_derive(config, &derived);
+    if (!isfinite(derived.turn_x0) || !isfinite(derived.turn_y0))
+        return -EDOM;
+
+    const double stance[][2] = {
+        {config->x_default - config->x_offset, config->y_start},
+        {config->x_default - config->x_offset,
+         config->y_start + config->y_step},
+        {config->x_default - config->x_offset,
+         config->y_start + 2 * config->y_step},
+        {config->x_default + config->x_offset, config->y_start},
+        {config->x_default + config->x_offset,
+         config->y_start + config->y_step},
+        {config->x_default + config->x_offset,
+         config->y_start + 2 * config->y_step},
+    };
+    for (int i = 0; i < ARRAY_SIZE(stance); i++)
+    {
+        double x = stance[i][0];
+        double y = stance[i][1];
+
+        if (!reach_map_reachable(x, y, config->z_default) ||
+            !reach_map_reachable(x, y, config->z_up) ||
+            !reach_map_reachable(x, y, derived.z_boot) ||
+            !reach_map_reachable(x - GESTURE_BODY_SHIFT, y,
+                                 config->z_default) ||
+            !reach_map_reachable(x + GESTURE_BODY_SHIFT, y,
+                                 config->z_default))
+            return -EDOM;
+    }
+
+    const double turn[][2] = {
+        {derived.turn_x0, derived.turn_y0},
+        {derived.turn_x1, derived.turn_y1},
+    };
+    for (int i = 0; i < ARRAY_SIZE(turn); i++)
+    {
+        if (!reach_map_reachable(turn[i][0], turn[i][1], config->z_default) ||
+            !reach_map_reachable(turn[i][0], turn[i][1], config->z_up) ||
+            !reach_map_reachable(turn[i][0], turn[i][1], WAVE_Z))
+            return -EDOM;
+    }
+
+    double shake_x = config->x_default - SHAKE_X_BACK;
+    double shake_y = config->y_start + 2 * config->y_step;
+    if (!reach_map_reachable(shake_x, shake_y, SHAKE_Z_UP) ||
+        !reach_map_reachable(shake_x, shake_y, SHAKE_Z_DOWN))
+        return -EDOM;
+    return 0;
+}
+
+/**
+ * @brief stages a value, on top of the ones already pending. Called with
+ * g_state_mutex held.
+ */
+static void stage(const struct robot_param* param, double value)
+{
+    if (!has_pending)
+        pending = g_config;
+    *param_field(&pending, param) = value;
+    has_pending = true;
+}
+
+/**
+ * @brief copies the staged values into g_config. Called with g_state_mutex
+ * held, before a command starts: the gaits read them once per command.
+ */
+void robot_settings_apply(void)
+{
+    bool posture = false;
+
+    if (!has_pending)
+        return;
+    has_pending = false;
+    if (memcmp(&pending, &g_config, sizeof(pending)) == 0)
+        return;
+
+    for (int i = 0; i < ARRAY_SIZE(params); i++)
+    {
+        if (params[i].posture && param_value(&pending, &params[i]) !=
+                                     param_value(&g_config, &params[i]))
+            posture = true;
+    }
+    g_config = pending;
+    if (posture)
+        robot_derive(&g_config, &g_derived);
+    // Compiled with the previous parameters
+    gait_cache_invalidate();
+    LOG_INF("Settings applied");
+}
+
+/**
+ * @brief tunes a parameter, from the next command on, and stores it. Called
+ * from the server thread.
+ *
+ * @return 0, -ENOENT if there is no such parameter, -ERANGE if the value is
+ * out of its bounds, -EDOM if a leg couldn't reach the sites of the gaits
+ * anymore, or the error of the settings backend
+ */
+int robot_settings_set(const char* name, double value)
+{
+    const struct robot_param* param = find_param(name);
+    struct robot_config config;
+    char key[SETTINGS_KEY_SIZE];
+
+    if (param == NULL)
+        return -ENOENT;
+    if (!in_range(param, value))
+        return -ERANGE;
+
+    state_lock(K_FOREVER);
+    config = has_pending ? pending : g_config;
+    state_unlock();
+
+    // Outside the mutex, this thread is the only one staging values
+    *param_field(&config, param) = value;
+    if (param->posture && check_posture(&config) < 0)
+        return -EDOM;
+
+    state_lock(K_FOREVER);
+    stage(param, value);
+    state_unlock();
+
+    snprintk(key, sizeof(key), SETTINGS_SUBTREE "/%s", name);
+    int ret = settings_save_one(key, &value, sizeof(value));
+    if (ret < 0)
+        LOG_ERR("Failed saving %s (%d)", key, ret);
+    return ret;
+}
+
+/**
+ * @brief goes back to the values the firmware was built with, from the next
+ * command on, and forgets the stored ones.
+ */
+int robot_settings_reset(void)
+{
+    char key[SETTINGS_KEY_SIZE];
+    int ret = 0;
+
+    state_lock(K_FOREVER);
+    for (int i = 0; i < ARRAY_SIZE(params); i++)
+        stage(&params[i], param_value(&robot_config_default, &params[i]));
+    state_unlock();
+
+    for (int i = 0; i < ARRAY_SIZE(params) && ret == 0; i++)
+    {
+        snprintk(key, sizeof(key), SETTINGS_SUBTREE "/%s", params[i].name);
+        ret = settings_delete(key);
+    }
+    return ret;
+}
+
+/**
+ * @brief the index-th parameter
+ *
+ * @return 0, -ENOENT past the last one
+ */
+int robot_settings_get(int index, struct robot_param_value* param)
+{
+    if (index < 0 || index >= ARRAY_SIZE(params))
+        return -ENOENT;
+
+    state_lock(K_FOREVER);
+    param->name = params[index].name;
+    param->value = param_value(&g_config, &params[index]);
+    param->pending =
+        has_pending ? param_value(&pending, &params[index]) : param->value;
+    state_unlock();
+    param->is_pending = param->pending != param->value;
+    return 0;
+}
+
+/**
+ * @brief stages a value stored by a previous run
+ */
+static int settings_set(const char* key, size_t len, settings_read_cb read_cb,
+                        void* cb_arg)
+{
+    const struct robot_param* param = find_param(key);
+    double value;
+
+    if (param == NULL || len != sizeof(value))
+        return -ENOENT;
+    int ret = read_cb(cb_arg, &value, sizeof(value));
+    if (ret < 0)
+        return ret;
+    if (!in_range(param, value))
+    {
+        LOG_WRN("Stored %s out of bounds, ignored", key);
+        return 0;
+    }
+
+    state_lock(K_FOREVER);
+    stage(param, value);
+    state_unlock();
+    return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(spider, SETTINGS_SUBTREE, NULL, settings_set,
+                               NULL, NULL);
+
+/**
+ * @brief loads the stored parameters. Must run before the gaits are compiled
+ * and the motor thread starts (robot_ready), they are applied right away.
+ */
+int robot_settings_init(void)
+{
+    int ret = settings_subsys_init();
+    if (ret < 0)
+    {
+        LOG_ERR("Settings unavailable (%d), using the defaults", ret);
+        return ret;
+    }
+    ret = settings_load_subtree(SETTINGS_SUBTREE);
+
+    state_lock(K_FOREVER);
+    // Checked as a whole, each value was within its bounds
+    if (has_pending && check_posture(&pending) < 0)
+    {
+        LOG_ERR("Stored posture out of reach, using the defaults");
+        has_pending = false;
+    }
+    robot_settings_apply();
+    state_unlock();
+    return ret;
+}
@@ -2,80 +2,121 @@
  * File:    robot_state.c
  * Date:    2025-10-07
  * Purpose: Global state shared by the motors and gait thread to compute the
- *legs position and move them. The structure contains hardcoded values
- *calculated by measuring the robot's body and variables that need run time
- *computation.
+ *legs position and move them. The dimensions of the robot, declared in
+ *Kconfig, and the values derived from them are generated at build time and
+ *stay in flash unless tunable (robot_settings.c), only the motion state is
+ *kept in the mutex protected block.
  *====================================================================*/
 #include "robot_state.h"
+#include "reach_map.h"
+#include "robot_geometry.h"
+#include "state_lock.h"
 #include "zephyr/kernel.h"
 #include <math.h>
 #include <servos.h>
+#include <string.h>
 #include <zephyr/logging/log.h>
 
-LOG_MODULE_REGISTER(robot_state, LOG_LEVEL_DBG);
+LOG_MODULE_REGISTER(robot_state, CONFIG_SPIDER_LOG_LEVEL);
 const double PI_CONST = 3.1415926;
 const double KEEP = 255.0;
 K_MUTEX_DEFINE(g_state_mutex);
+K_EVENT_DEFINE(robot_ready);
 
 /**
- * @brief Global instance of the state
+ * @brief Dimensions and speeds of the robot, placed in flash unless tunable.
+ * The dimensions come from Kconfig through the generated robot_geometry.h.
  */
-robot_state_t g_state = {
+#define ROBOT_CONFIG_DEFAULT                                                   \
+    {                                                                          \
+        .length_a = ROBOT_LENGTH_A, .length_b = ROBOT_LENGTH_B,                \
+        .length_c = ROBOT_LENGTH_C, .length_side = ROBOT_LENGTH_SIDE,          \
+        .z_absolute = ROBOT_Z_ABSOLUTE,                                        \
+                                                                               \
+        .z_default = ROBOT_Z_DEFAULT, .z_up = ROBOT_Z_UP,                      \
+        .x_default = ROBOT_X_DEFAULT, .x_offset = ROBOT_X_OFFSET,              \
+        .y_start = ROBOT_Y_START, .y_step = ROBOT_Y_STEP,                      \
+                                                                               \
+        .speed_multiple = 1.0, .spot_turn_speed = 4.0, .leg_move_speed = 8.0,  \
+        .body_move_speed = 3.0, .stand_seat_speed = 1.0,                       \
+    }
 
-    // Initialize simple constants directly where possible
-    .length_a = 55.0,
+/**
+ * @brief Values derived from the dimensions, computed by
+ * tools/robot_geometry.py at build time so that the boot does no trigonometry
+ */
+#define ROBOT_DERIVED_DEFAULT                                                  \
+    {                                                                          \
+        .z_boot = ROBOT_Z_BOOT,                                                \
+                                                                               \
+        .temp_a = ROBOT_TEMP_A, .temp_b = ROBOT_TEMP_B,                        \
+        .temp_c = ROBOT_TEMP_C, .temp_alpha = ROBOT_TEMP_ALPHA,                \
+                                                                               \
+        .turn_x0 = ROBOT_TURN_X0, .turn_y0 = ROBOT_TURN_Y0,                    \
+        .turn_x1 = ROBOT_TURN_X1, .turn_y1 = ROBOT_TURN_Y1,                    \
+    }
+
+ROBOT_TUNABLE struct robot_config g_config = ROBOT_CONFIG_DEFAULT;
+ROBOT_TUNABLE struct robot_derived g_derived = ROBOT_DERIVED_DEFAULT;
 
-    .length_b = 77.5,       .length_c = 27.5,        .length_side = 71.0,
-    .z_absolute = -28.0,
+#if defined(CONFIG_SPIDER_SETTINGS)
+// What the settings are reset to
+const struct robot_config robot_config_default = ROBOT_CONFIG_DEFAULT;
 
-    .z_default = -50.0,     .z_up = -30.0,           .x_default = 62.0,
-    .y_step = 40.0,
+/**
+ * @brief computes the values derived from the config, with the formulas of
+ * tools/robot_geometry.py. Only needed once the posture has been tuned.
+ */
+void robot_derive(const struct robot_config* config,
+                  struct robot_derived* derived)
+{
+    double val_2x_l = 2.0 * config->x_default + config->length_side;
+
+    derived->z_boot = config->z_absolute;
+    derived->temp_a = sqrt(pow(val_2x_l, 2.0) + pow(config->y_step, 2.0));
+    derived->temp_b =
+        2.0 * (config->y_start + config->y_step) + config->length_side;
+    derived->temp_c =
+        sqrt(pow(val_2x_l, 2.0) + pow(2.0 * config->y_start + config->y_step +
+                                          config->length_side,
+                                      2.0));
+    derived->temp_alpha =
+        acos((pow(derived->temp_a, 2.0) + pow(derived->temp_b, 2.0) -
+              pow(derived->temp_c, 2.0)) /
+             (2.0 * derived->temp_a * derived->temp_b));
+
+    // Sites of the turn gaits
+    derived->turn_x1 = (derived->temp_a - config->length_side) / 2.0;
+    derived->turn_y1 = config->y_start + config->y_step / 2.0;
+    derived->turn_x0 =
+        derived->turn_x1 - derived->temp_b * cos(derived->temp_alpha);
+    derived->turn_y0 = derived->temp_b * sin(derived->temp_alpha) -
+                       derived->turn_y1 - config->length_side;
+}
+#endif
+
+/**
+ * @brief Global instance of the state
+ */
+robot_state_t g_state;
 
-    .speed_multiple = 1.0,  .spot_turn_speed = 4.0,  .leg_move_speed = 8.0,
-    .body_move_speed = 3.0, .stand_seat_speed = 1.0,
-};
+static bool initialized;
 
 /**
  * @brief inits the fields that need runtime initialisation
  */
 void init_robot_state(void)
 {
-    if (g_state.initialized)
+    if (initialized)
     {
         LOG_DBG("State already initialized.");
 
         return;
     }
 
-    g_state.z_boot = g_state.z_absolute;
-
-    // Runtime calculations
-    double val_2x_l = (2.0 * g_state.x_default + g_state.length_side);
-
-    g_state.temp_a = sqrt(pow(val_2x_l, 2.0) + pow(g_state.y_step, 2.0));
-
-    g_state.temp_b =
-        2.0 * (g_state.y_start + g_state.y_step) + g_state.length_side;
-
-    g_state.temp_c = sqrt(
-        pow(val_2x_l, 2.0) +
-        pow(2.0 * g_state.y_start + g_state.y_step + g_state.length_side, 2.0));
-
-    g_state.temp_alpha =
-        acos((pow(g_state.temp_a, 2.0) + pow(g_state.temp_b, 2.0) -
-              pow(g_state.temp_c, 2.0)) /
-             (2.0 * g_state.temp_a * g_state.temp_b));
-
-    // site for turn
-    g_state.turn_x1 = (g_state.temp_a - g_state.length_side) / 2.0;
-    g_state.turn_y1 = g_state.y_start + g_state.y_step / 2.0;
+    reach_map_init(g_config.length_a, g_config.length_b, g_config.length_c);
 
-    g_state.turn_x0 =
-        g_state.turn_x1 - g_state.temp_b * cos(g_state.temp_alpha);
-    g_state.turn_y0 = g_state.temp_b * sin(g_state.temp_alpha) -
-                      g_state.turn_y1 - g_state.length_side;
-
-    g_state.initialized = true;
+    initialized = true;
     LOG_INF("State initialized.");
 }
 
@@ -84,7 +125,7 @@ void init_robot_state(void)
  */
 void print_robot_state(void)
 {
-    if (!g_state.initialized)
+    if (!initialized)
     {
         LOG_WRN("State not initialized. Skipping debug print.");
         return;
@@ -94,30 +135,30 @@ void print_robot_state(void)
 
     // 1. Core Dimensions
     LOG_INF("Core Dimensions:");
-    LOG_INF("  Length A/B/C: %.2f / %.2f / %.2f", (double)g_state.length_a,
-            (double)g_state.length_b, (double)g_state.length_c);
-    LOG_INF("  Length Side: %.2f", (double)g_state.length_side);
-    LOG_INF("  Z Absolute/Boot: %.2f / %.2f", (double)g_state.z_absolute,
-            (double)g_state.z_boot);
+    LOG_INF("  Length A/B/C: %.2f / %.2f / %.2f", (double)g_config.length_a,
+            (double)g_config.length_b, (double)g_config.length_c);
+    LOG_INF("  Length Side: %.2f", (double)g_config.length_side);
+    LOG_INF("  Z Absolute/Boot: %.2f / %.2f", (double)g_config.z_absolute,
+            (double)g_derived.z_boot);
 
     // 2. Movement Parameters
     LOG_INF("Movement Parameters:");
-    LOG_INF("  X Default/Offset: %.2f / %.2f", (double)g_state.x_default,
-            (double)g_state.x_offset);
-    LOG_INF("  Y Start/Step: %.2f / %.2f", (double)g_state.y_start,
+    LOG_INF("  X Default/Offset: %.2f / %.2f", (double)g_config.x_default,
+            (double)g_config.x_offset);
+    LOG_INF("  Y Start/Step: %.2f / %.2f", (double)g_config.y_start,
 
-            (double)g_state.y_step);
+            (double)g_config.y_step);
 
     // 3. Calculated Constants (Crucial for verification)
     LOG_INF("Calculated Turn Constants:");
-    LOG_INF("  Temp A/B/C: %.3f / %.3f / %.3f", (double)g_state.temp_a,
-            (double)g_state.temp_b, (double)g_state.temp_c);
-    LOG_INF("  Temp Alpha (rad): %.4f", (double)g_state.temp_alpha);
+    LOG_INF("  Temp A/B/C: %.3f / %.3f / %.3f", (double)g_derived.temp_a,
+            (double)g_derived.temp_b, (double)g_derived.temp_c);
+    LOG_INF("  Temp Alpha (rad): %.4f", (double)g_derived.temp_alpha);
     LOG_INF("  Turn X0/Y0: %.2f / %.2f",
 
-            (double)g_state.turn_x0, (double)g_state.turn_y0);
-    LOG_INF("  Turn X1/Y1: %.2f / %.2f", (double)g_state.turn_x1,
-            (double)g_state.turn_y1);
+            (double)g_derived.turn_x0, (double)g_derived.turn_y0);
+    LOG_INF("  Turn X1/Y1: %.2f / %.2f", (double)g_derived.turn_x1,
+            (double)g_derived.turn_y1);
 
     // 4. Positions
     LOG_INF("Initial State (Site Expect/Now):");
@@ -138,3 +179,16 @@ void print_robot_state(void)
 
     LOG_INF("-------------------------------------");
 }
+
+/**
+ * @brief copies the hot state under the mutex, so that a reader never sees a
+ * leg half way through a motor tick.
+ *
+ * @param snapshot destination
+ */
+void robot_state_snapshot(robot_state_t* snapshot)
+{
+    state_lock(K_FOREVER);
+    memcpy(snapshot, &g_state, sizeof(*snapshot));
+    state_unlock();
+}
@@ -4,16 +4,18 @@
  * Purpose: Contains the code that interact with the pwm driver. All writes of
  *pulse are done to a single interface (set_angle()).
  *====================================================================*/
+#include "log_limit.h"
 #include "zephyr/device.h"
 #include "zephyr/drivers/pwm.h"
 #include "zephyr/logging/log.h"
+#include "zephyr/pm/device.h"
 #include "zephyr/sys/util.h"
 #include <servos.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <sys/errno.h>
 
-LOG_MODULE_REGISTER(Servo, LOG_LEVEL_DBG);
+LOG_MODULE_REGISTER(Servo, CONFIG_SPIDER_LOG_LEVEL);
 
 const struct device* pwm = DEVICE_DT_GET(DT_NODELABEL(pca9685));
 
@@ -52,7 +54,7 @@ int init_servos(void)
  */
 void set_angle(uint8_t leg_id, uint8_t joint_id, uint8_t angle)
 {
-    CLAMP(angle, 0, 180);
+    angle = MIN(angle, 180);
 
     uint32_t pulse = SERVO_PULSE_MIN_NS +
                      (angle * (SERVO_PULSE_MAX_NS - SERVO_PULSE_MIN_NS) / 180);
@@ -60,7 +62,53 @@ void set_angle(uint8_t leg_id, uint8_t joint_id, uint8_t angle)
     int ret = pwm_set(pwm, servo_channel_map[leg_id][joint_id], PERIOD_SERVO,
                       pulse, 0);
     if (ret < 0)
-        LOG_ERR("Failed setting pwm for leg %d joint %d", leg_id, joint_id);
+        LOG_ERR_LIMITED("Failed setting pwm for leg %d joint %d (%d)", leg_id,
+                        joint_id, ret);
+}
+
+/**
+ * @brief marks the end of a motor tick. pwm_set() already applied every pulse,
+ * nothing is buffered on the PCA9685.
+ */
+void commit_servo_frame(void) {}
+
+/**
+ * @brief turns every output off, the servos stop holding their position and
+ * draw next to nothing. The PCA9685 is put to sleep too when its driver
+ * supports it.
+ */
+void relax_all_servos(void)
+{
+    for (int leg = 0; leg < NB_LEGS; leg++)
+    {
+        for (int joint = 0; joint < NB_JOINTS; joint++)
+        {
+            int ret = pwm_set(pwm, servo_channel_map[leg][joint], PERIOD_SERVO,
+                              0, 0);
+            if (ret < 0)
+                LOG_ERR("Failed relaxing leg %d joint %d (%d)", leg, joint,
+                        ret);
+        }
+    }
+
+#if defined(CONFIG_PM_DEVICE)
+    int ret = pm_device_action_run(pwm, PM_DEVICE_ACTION_SUSPEND);
+    if (ret < 0 && ret != -ENOSYS && ret != -ENOTSUP && ret != -EALREADY)
+        LOG_WRN("Failed suspending %s (%d)", pwm->name, ret);
+#endif
+}
+
+/**
+ * @brief wakes the PCA9685 after relax_all_servos(), the next frame written
+ * powers the servos again.
+ */
+void resume_servos(void)
+{
+#if defined(CONFIG_PM_DEVICE)
+    int ret = pm_device_action_run(pwm, PM_DEVICE_ACTION_RESUME);
+    if (ret < 0 && ret != -ENOSYS && ret != -ENOTSUP && ret != -EALREADY)
+        LOG_WRN("Failed resuming %s (%d)", pwm->name, ret);
+#endif
 }
 
 /**
@@ -0,0 +1,60 @@
+/*======================================================================
+ * File:    frame_dump.c
+ * Date:    2026-10-19
+ * Purpose: Writes the joint angles of every motor tick of the simulated robot
+ *to the file given with --frames, one CSV line per tick stamped with the
+ *(virtual) uptime. The output of two firmware versions can be diffed to spot
+ *gait regressions.
+ *====================================================================*/
+#include "frame_dump_bottom.h"
+#include "posix_native_task.h"
+#include "servos_sim.h"
+#include "sim_options.h"
+#include "spider_robot.h"
+#include "zephyr/kernel.h"
+#include <zephyr/sys/printk.h>
+
+#define FRAME_LINE_SIZE 128
+
+static void dump_frame(const uint8_t angles[NB_LEGS][NB_JOINTS])
+{
+    char line[FRAME_LINE_SIZE];
+    int len = snprintk(line, sizeof(line), "%lld,%u", cmd_timestamp_us(),
+                       servo_sim_frames);
+
+    for (int leg = 0; leg < NB_LEGS; leg++)
+        for (int joint = 0; joint < NB_JOINTS; joint++)
+            len += snprintk(line + len, sizeof(line) - len, ",%u",
+                            angles[leg][joint]);
+    snprintk(line + len, sizeof(line) - len, "\n");
+
+    frame_dump_bottom_write(line);
+}
+
+static void frame_dump_open(void)
+{
+    if (sim_frames_path == NULL)
+        return;
+
+    if (frame_dump_bottom_open(sim_frames_path) < 0)
+    {
+        printk("Can't open %s, frames not dumped\n", sim_frames_path);
+        return;
+    }
+    frame_dump_bottom_write("t_us,frame");
+    for (int leg = 0; leg < NB_LEGS; leg++)
+    {
+        for (int joint = 0; joint < NB_JOINTS; joint++)
+        {
+            char column[8];
+
+            snprintk(column, sizeof(column), ",l%dj%d", leg, joint);
+            frame_dump_bottom_write(column);
+        }
+    }
+    frame_dump_bottom_write("\n");
+    servo_sim_set_frame_hook(dump_frame);
+}
+
+NATIVE_TASK(frame_dump_open, PRE_BOOT_2, 1);
+NATIVE_TASK(frame_dump_bottom_close, ON_EXIT_PRE, 1);
@@ -0,0 +1,29 @@
+/*======================================================================
+ * File:    frame_dump_bottom.c
+ * Date:    2026-10-19
+ * Purpose: Host side of the frame dump. Runs in the native simulator runner
+ *context with the host C library, the Zephyr side only formats the lines.
+ *====================================================================*/
+#include "frame_dump_bottom.h"
+#include <stdio.h>
+
+static FILE* frames_file;
+
+int frame_dump_bottom_open(const char* path)
+{
+    frames_file = fopen(path, "w");
+    return (frames_file != NULL) ? 0 : -1;
+}
+
+void frame_dump_bottom_write(const char* line)
+{
+    if (frames_file != NULL)
+        fputs(line, frames_file);
+}
+
+void frame_dump_bottom_close(void)
+{
+    if (frames_file != NULL)
+        fclose(frames_file);
+    frames_file = NULL;
+}
@@ -0,0 +1,12 @@
+#ifndef FRAME_DUMP_BOTTOM_H
+#define FRAME_DUMP_BOTTOM_H
+
+/*
+ * Host side of the frame dump, built into the native simulator runner where
+ * the host C library is available.
+ */
+int frame_dump_bottom_open(const char* path);
+void frame_dump_bottom_write(const char* line);
+void frame_dump_bottom_close(void);
+
+#endif // !FRAME_DUMP_BOTTOM_H
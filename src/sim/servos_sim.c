@@ -0,0 +1,61 @@
+/*======================================================================
+ * File:    servos_sim.c
+ * Date:    2026-10-19
+ * Purpose: Stand-in for servos.c when running without the PCA9685 (native_sim
+ *and tests). Implements the same interface and keeps the last angle written
+ *to each joint in memory.
+ *====================================================================*/
+#include "servos_sim.h"
+#include "zephyr/sys/util.h"
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(Servo, CONFIG_SPIDER_LOG_LEVEL);
+
+uint8_t servo_sim_angles[NB_LEGS][NB_JOINTS];
+uint32_t servo_sim_writes;
+uint32_t servo_sim_frames;
+bool servo_sim_relaxed;
+uint32_t servo_sim_stall_ms;
+
+static servo_frame_hook_t frame_hook;
+
+int init_servos(void)
+{
+    LOG_INF("Using simulated servos");
+    return 0;
+}
+
+void set_angle(uint8_t leg_id, uint8_t joint_id, uint8_t angle)
+{
+    servo_sim_angles[leg_id][joint_id] = MIN(angle, 180);
+    servo_sim_writes++;
+}
+
+void center_all_servos(void)
+{
+    for (int leg = 0; leg < NB_LEGS; leg++)
+        for (int joint = 0; joint < NB_JOINTS; joint++)
+            set_angle(leg, joint, 90);
+}
+
+/**
+ * @brief hands the frame written during the tick to the hook (frame dump,
+ * tests).
+ */
+void commit_servo_frame(void)
+{
+    // The transfer blocks the motor thread, g_state_mutex held
+    if (servo_sim_stall_ms > 0)
+        k_msleep(servo_sim_stall_ms);
+    servo_sim_frames++;
+    if (frame_hook != NULL)
+        frame_hook(servo_sim_angles);
+}
+
+void relax_all_servos(void) { servo_sim_relaxed = true; }
+
+void resume_servos(void) { servo_sim_relaxed = false; }
+
+void servo_sim_set_frame_hook(servo_frame_hook_t hook) { frame_hook = hook; }
@@ -0,0 +1,50 @@
+/*======================================================================
+ * File:    sim_options.c
+ * Date:    2026-10-19
+ * Purpose: native_sim command line options, so that several simulated robots
+ *can run side by side on the same host (./zephyr.exe --port=5001) and gaits
+ *can be replayed without a client (--cmds, --frames).
+ *====================================================================*/
+#include "cmdline.h"
+#include "posix_native_task.h"
+#include "sim_options.h"
+#include "spider_robot.h"
+
+static unsigned int port_option;
+char* sim_frames_path;
+char* sim_commands;
+
+static void port_option_found(char* argv, int offset)
+{
+    (void)argv;
+    (void)offset;
+    tcp_server_port = port_option;
+}
+
+static void add_sim_options(void)
+{
+    static struct args_struct_t sim_options[] = {
+        {.option = "port",
+         .name = "port",
+         .type = 'u',
+         .dest = (void*)&port_option,
+         .call_when_found = port_option_found,
+         .descript = "TCP command server port"},
+        {.option = "frames",
+         .name = "file",
+         .type = 's',
+         .dest = (void*)&sim_frames_path,
+         .descript = "Write the joint angles of every motor tick to <file>"},
+        {.option = "cmds",
+         .name = "script",
+         .type = 's',
+         .dest = (void*)&sim_commands,
+         .descript = "Run these ';' separated commands (\"sf 2;tl 1\") then "
+                     "exit. Combine with --no-rt to run faster than real "
+                     "time"},
+        ARG_TABLE_ENDMARKER};
+
+    native_add_command_line_opts(sim_options);
+}
+
+NATIVE_TASK(add_sim_options, PRE_BOOT_1, 1);
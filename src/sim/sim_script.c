@@ -0,0 +1,93 @@
+/*======================================================================
+ * File:    sim_script.c
+ * Date:    2026-10-19
+ * Purpose: Feeds the commands given with --cmds to the gait thread the way the
+ *TCP server would, waits for them to complete and exits the simulation. With
+ *--no-rt the clock is virtual and a whole gait runs in a fraction of its real
+ *duration.
+ *====================================================================*/
+#include "command_queue.h"
+#include "posix_board_if.h"
+#include "robot_state.h"
+#include "servos_sim.h"
+#include "sim_options.h"
+#include "spider_robot.h"
+#include "zephyr/kernel.h"
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/sys/printk.h>
+
+#define SIM_SCRIPT_STACK_SIZE 1024
+#define SIM_SCRIPT_PRIORITY 6
+
+/**
+ * @brief queues one "<command> [times]" entry of the script.
+ *
+ * @return 0 if queued, negative errno otherwise
+ */
+static int queue_command(const char* entry, uint32_t id)
+{
+    struct tcp_command cmd = {.times = 1, .id = id};
+    size_t len = strcspn(entry, " ");
+
+    if (len == 0 || len >= sizeof(cmd.command))
+        return -EINVAL;
+    memcpy(cmd.command, entry, len);
+    if (entry[len] == ' ')
+        cmd.times = atoi(entry + len + 1);
+
+    const struct cmd_entry* found = find_command(cmd.command);
+    if (found == NULL || cmd.times <= 0)
+    {
+        printk("SIM unknown command \"%s\"\n", entry);
+        return -EINVAL;
+    }
+
+    cmd.enqueued_us = cmd_timestamp_us();
+    cmd.rx_cycles = cmd.enqueued_cycles = k_cycle_get_32();
+    return cmd_queue_put(&cmd, found->lane, K_FOREVER, NULL) < 0 ? -EAGAIN : 0;
+}
+
+/**
+ * @brief runs the script one command at a time, so that consecutive gaits are
+ * not coalesced and every command reports its own duration.
+ */
+static void sim_script_thread(void)
+{
+    static char script[256];
+    struct cmd_completion done;
+    uint32_t executed = 0;
+
+    if (sim_commands == NULL)
+        return;
+
+    k_event_wait(&robot_ready, ROBOT_READY, false, K_FOREVER);
+    int64_t start = cmd_timestamp_us();
+
+    strncpy(script, sim_commands, sizeof(script) - 1);
+    for (char* entry = script; entry != NULL;)
+    {
+        char* next = strchr(entry, ';');
+
+        if (next != NULL)
+            *next++ = '\0';
+        while (*entry == ' ')
+            entry++;
+        if (*entry != '\0' && queue_command(entry, executed) == 0)
+        {
+            k_msgq_get(&cmd_completion_q, &done, K_FOREVER);
+            printk("SIM %s %s in %lld us, %u IK calls\n", entry,
+                   done.cancelled ? "cancelled" : "done",
+                   done.finished_us - done.started_us, done.ik_calls);
+            executed++;
+        }
+        entry = next;
+    }
+
+    printk("SIM %u commands, %u frames in %lld us of simulated time\n",
+           executed, servo_sim_frames, cmd_timestamp_us() - start);
+    posix_exit(0);
+}
+
+K_THREAD_DEFINE(sim_script_thread_id, SIM_SCRIPT_STACK_SIZE, sim_script_thread,
+                NULL, NULL, NULL, SIM_SCRIPT_PRIORITY, 0, 0);
@@ -0,0 +1,138 @@
+/*======================================================================
+ * File:    state_lock.c
+ * Date:    2026-10-19
+ * Purpose: Contention statistics of g_state_mutex. Each state_lock() call site
+ *owns its counters (acquisitions, timeouts, wait and hold time in cycles) and
+ *registers itself the first time it runs, so the sites holding the state the
+ *longest can be reported at runtime.
+ *====================================================================*/
+#include "state_lock.h"
+#include "robot_state.h"
+#include "zephyr/kernel.h"
+#include "zephyr/sys/util.h"
+#include <string.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(state_lock, CONFIG_SPIDER_LOG_LEVEL);
+
+static struct lock_site_stats* sites[CONFIG_SPIDER_LOCK_STATS_MAX_SITES];
+static int nb_sites;
+static struct k_spinlock stats_lock;
+
+// Outermost owner of the mutex, which is recursive
+static struct lock_site_stats* holder;
+static uint32_t hold_start;
+static uint32_t depth;
+
+static void register_site(struct lock_site_stats* site)
+{
+    static bool warned;
+
+    if (nb_sites == ARRAY_SIZE(sites))
+    {
+        if (!warned)
+            LOG_WRN("Too many lock sites, %s:%d not reported", site->file,
+                    site->line);
+        warned = true;
+        return;
+    }
+    sites[nb_sites++] = site;
+    site->registered = true;
+}
+
+int state_lock_at(struct lock_site_stats* site, k_timeout_t timeout)
+{
+    uint32_t start = k_cycle_get_32();
+    int ret = k_mutex_lock(&g_state_mutex, timeout);
+    uint32_t now = k_cycle_get_32();
+    uint32_t wait = now - start;
+
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+    if (!site->registered)
+        register_site(site);
+
+    if (ret != 0)
+        site->timeouts++;
+    else
+    {
+        site->acquired++;
+        if (depth++ == 0)
+        {
+            holder = site;
+            hold_start = now;
+        }
+    }
+    site->wait_cycles += wait;
+    site->max_wait_cycles = MAX(site->max_wait_cycles, wait);
+    k_spin_unlock(&stats_lock, key);
+
+    return ret;
+}
+
+int state_unlock_at(void)
+{
+    // Only the owner's unlock ends a hold, a wrong unlock fails below
+    if (g_state_mutex.owner == k_current_get())
+    {
+        k_spinlock_key_t key = k_spin_lock(&stats_lock);
+        if (depth > 0 && --depth == 0 && holder != NULL)
+        {
+            uint32_t hold = k_cycle_get_32() - hold_start;
+
+            holder->hold_cycles += hold;
+            holder->max_hold_cycles = MAX(holder->max_hold_cycles, hold);
+            holder = NULL;
+        }
+        k_spin_unlock(&stats_lock, key);
+    }
+
+    return k_mutex_unlock(&g_state_mutex);
+}
+
+/**
+ * @brief copies the call sites that held the mutex the longest in total.
+ *
+ * @param worst destination, sorted from the worst site
+ * @param max size of worst
+ * @return number of sites copied
+ */
+int lock_stats_worst(struct lock_site_stats* worst, int max)
+{
+    bool taken[CONFIG_SPIDER_LOCK_STATS_MAX_SITES] = {false};
+    int count = 0;
+
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+    for (; count < max && count < nb_sites; count++)
+    {
+        int pick = -1;
+
+        for (int i = 0; i < nb_sites; i++)
+        {
+            if (!taken[i] &&
+                (pick < 0 || sites[i]->hold_cycles > sites[pick]->hold_cycles))
+                pick = i;
+        }
+        taken[pick] = true;
+        worst[count] = *sites[pick];
+    }
+    k_spin_unlock(&stats_lock, key);
+
+    return count;
+}
+
+void lock_stats_reset(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+    for (int i = 0; i < nb_sites; i++)
+    {
+        struct lock_site_stats* site = sites[i];
+
+        site->acquired = 0;
+        site->timeouts = 0;
+        site->wait_cycles = 0;
+        site->max_wait_cycles = 0;
+        site->hold_cycles = 0;
+        site->max_hold_cycles = 0;
+    }
+    k_spin_unlock(&stats_lock, key);
+}
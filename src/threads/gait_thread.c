@@ -7,63 +7,197 @@
  *this thread then wait for the movement to be done before proceeding to the
  *next one.
  *====================================================================*/
+#include "command_queue.h"
+#include "gait_asset.h"
+#include "gait_cache.h"
+#include "profiling.h"
+#include "robot_settings.h"
 #include "robot_state.h"
 #include "servos.h"
 #include "spider_robot.h"
+#include "state_lock.h"
+#include "trace_points.h"
 #include "zephyr/kernel.h"
 #include "zephyr/sys/util.h"
+#include <string.h>
 #include <sys/_types.h>
 #include <zephyr/logging/log.h>
 
-LOG_MODULE_REGISTER(gait_thread, LOG_LEVEL_DBG);
+LOG_MODULE_REGISTER(gait_thread, CONFIG_SPIDER_LOG_LEVEL);
 #define GAIT_STACK_SIZE 1024
+#if defined(CONFIG_SPIDER_SCHED_EDF)
+#define GAIT_THREAD_PRIORITY SPIDER_EDF_PRIORITY
+#else
 #define GAIT_THREAD_PRIORITY 5
+#endif
+// Wake up that long before a scheduled start to set the first keyframe
+#define SCHEDULE_LEAD_US 1000
+
+// Room for a completion per queued command plus the one being executed
+K_MSGQ_DEFINE(cmd_completion_q, sizeof(struct cmd_completion),
+              CONFIG_SPIDER_CMD_URGENT_DEPTH + CONFIG_SPIDER_CMD_NORMAL_DEPTH +
+                  CONFIG_SPIDER_CMD_LOW_DEPTH + 1,
+              4);
+
+static void report_cancelled(const struct tcp_command* cmd)
+{
+    struct cmd_completion done = {
+        .id = cmd->id,
+        .enqueued_us = cmd->enqueued_us,
+        .cancelled = true,
+    };
+
+    strcpy(done.command, cmd->command);
+    if (k_msgq_put(&cmd_completion_q, &done, K_NO_WAIT) < 0)
+        LOG_WRN("Completion queue full, dropping CANCEL for %u", cmd->id);
+}
+
+/**
+ * @brief drops the gaits and gestures still waiting in the queue. Being
+ * urgent, it is served before any of them. The server already cancelled the
+ * command that was running when stop arrived.
+ */
+static void stop(unsigned int step)
+{
+    (void)step;
+
+    cmd_queue_flush(CMD_LANE_NORMAL, report_cancelled);
+    cmd_queue_flush(CMD_LANE_LOW, report_cancelled);
+}
 
 static const struct cmd_entry cmd_table[] = {
-    {"sit", sit},          {"stand", stand},   {"sf", step_forward},
-    {"sb", step_back},     {"tl", turn_left},  {"tr", turn_right},
-    {"shake", hand_shake}, {"wave", hand_wave}};
+    {"stop", stop, CMD_LANE_URGENT},
+    {"sit", sit, CMD_LANE_URGENT},
+    {"stand", stand, CMD_LANE_URGENT},
+    {"sf", step_forward, CMD_LANE_NORMAL},
+    {"sb", step_back, CMD_LANE_NORMAL},
+    {"tl", turn_left, CMD_LANE_NORMAL},
+    {"tr", turn_right, CMD_LANE_NORMAL},
+    {"shake", hand_shake, CMD_LANE_LOW},
+    {"wave", hand_wave, CMD_LANE_LOW}};
 
-void process_tcp_command(const struct tcp_command* cmd)
+// Gaits stored in flash, "g.<name>", run by gait_asset_run()
+static const struct cmd_entry asset_entry = {GAIT_ASSET_PREFIX, NULL,
+                                             CMD_LANE_NORMAL};
+
+const struct cmd_entry* find_command(const char* name)
 {
     for (int i = 0; i < ARRAY_SIZE(cmd_table); i++)
     {
-        if (strcmp(cmd->command, cmd_table[i].name) == 0)
-        {
-            cmd_table[i].fn(cmd->times);
-            return;
-        }
+        if (strcmp(name, cmd_table[i].name) == 0)
+            return &cmd_table[i];
+    }
+    if (gait_asset_command(name) != NULL)
+        return &asset_entry;
+    return NULL;
+}
+
+void process_tcp_command(const struct tcp_command* cmd)
+{
+    const struct cmd_entry* entry = find_command(cmd->command);
+
+    if (entry == NULL)
+    {
+        LOG_WRN("Unrecognised command %s", cmd->command);
+        return;
+    }
+    if (entry == &asset_entry)
+    {
+        gait_asset_run(cmd->command + strlen(GAIT_ASSET_PREFIX), cmd->times);
+        return;
+    }
+    gait_cache_run(entry->fn, cmd->times);
+}
+
+/**
+ * @brief holds a scheduled command until its execute-at time. The motor tick
+ * grid is moved onto that instant so the first step happens exactly then,
+ * whatever the phase the motor thread booted with.
+ *
+ * @param cmd
+ * @return false if an urgent command was queued meanwhile: it must not wait
+ * behind this one, which is cancelled
+ */
+static bool wait_execute_at(const struct tcp_command* cmd)
+{
+    if (cmd->execute_at_us == 0)
+        return true;
+
+    int64_t now = cmd_timestamp_us();
+    if (cmd->execute_at_us <= now)
+    {
+        LOG_WRN("Command %u dequeued %lld us after its start time", cmd->id,
+                now - cmd->execute_at_us);
+        return true;
+    }
+
+    motors_align_phase(cmd->execute_at_us);
+    if (cmd_queue_wait_urgent(K_TIMEOUT_ABS_US(cmd->execute_at_us -
+                                               SCHEDULE_LEAD_US)) == 0)
+    {
+        LOG_WRN("Command %u overtaken by an urgent command", cmd->id);
+        return false;
     }
-    LOG_WRN("Unrecognised command %s", cmd->command);
+    return true;
+}
+
+/**
+ * @brief runs the command and reports its timestamps back to the tcp server
+ * so the client knows when it can send the next one.
+ *
+ * @param cmd
+ */
+static void execute_tcp_command(const struct tcp_command* cmd)
+{
+    struct cmd_completion done = {
+        .id = cmd->id,
+        .enqueued_us = cmd->enqueued_us,
+    };
+
+    strcpy(done.command, cmd->command);
+    begin_command();
+    // Queued before a safe stop, or overtaken while waiting for its start time
+    if (motors_faulted() || !wait_execute_at(cmd))
+    {
+        end_command();
+        report_cancelled(cmd);
+        return;
+    }
+    // Parameters tuned during the previous command apply from this one on
+    if (IS_ENABLED(CONFIG_SPIDER_SETTINGS))
+    {
+        state_lock(K_FOREVER);
+        robot_settings_apply();
+        state_unlock();
+    }
+    done.started_us = cmd_timestamp_us();
+    uint32_t ik_calls = ik_call_count();
+    process_tcp_command(cmd);
+    // Cut short by a safe stop, the client gets a CANCEL
+    done.cancelled = end_command();
+    done.ik_calls = ik_call_count() - ik_calls;
+    done.finished_us = cmd_timestamp_us();
+    TRACE_CMD_DONE(cmd->id);
+
+    if (k_msgq_put(&cmd_completion_q, &done, K_NO_WAIT) < 0)
+        LOG_WRN("Completion queue full, dropping DONE for %u", cmd->id);
 }
 
 void gait_thread(void)
 {
-    // Initialisation
-    k_mutex_lock(&g_state_mutex, K_FOREVER);
-    set_site(0, g_state.x_default - g_state.x_offset,
-             g_state.y_start + g_state.y_step, g_state.z_boot);
-    set_site(1, g_state.x_default - g_state.x_offset,
-             g_state.y_start + g_state.y_step, g_state.z_boot);
-    set_site(2, g_state.x_default + g_state.x_offset, g_state.y_start,
-             g_state.z_boot);
-    set_site(3, g_state.x_default + g_state.x_offset, g_state.y_start,
-             g_state.z_boot);
-
-    for (int leg = 0; leg < NB_LEGS; leg++)
-        for (int joint = 0; joint < NB_JOINTS; joint++)
-            g_state.site_now[leg][joint] = g_state.site_expect[leg][joint];
-    k_mutex_unlock(&g_state_mutex);
+    k_event_wait(&robot_ready, ROBOT_READY, false, K_FOREVER);
 
     while (true)
     {
         struct tcp_command cmd;
 
-        k_msgq_get(&tcp_command_q, &cmd, K_FOREVER);
+        cmd_queue_get(&cmd, K_FOREVER);
+        TRACE_CMD_DEQUEUED(cmd.id, cmd.times);
+        prof_cmd_dequeued(cmd.rx_cycles, cmd.enqueued_cycles);
         LOG_DBG("Received: command: %s, times: %d", cmd.command, cmd.times);
-        process_tcp_command(&cmd);
+        execute_tcp_command(&cmd);
     }
 }
 
 K_THREAD_DEFINE(gait_thread_id, GAIT_STACK_SIZE, gait_thread, NULL, NULL, NULL,
-                GAIT_THREAD_PRIORITY, K_USER, 2000);
+                GAIT_THREAD_PRIORITY, K_USER, SPIDER_THREAD_DELAY);
@@ -6,82 +6,533 @@
  *the legs. Perform the inverse kinematic computation to convert the x,y,z
  *coordinates into angles.
  *====================================================================*/
+#include "gait_cache.h"
+#include "log_limit.h"
+#include "profiling.h"
 #include "robot_state.h"
 #include "servos.h"
 #include "spider_robot.h"
+#include "state_lock.h"
+#include "trace_points.h"
 #include <math.h>
+#include <string.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+#if defined(CONFIG_SPIDER_TICK_WDT)
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/task_wdt/task_wdt.h>
+#endif
 
+#if defined(CONFIG_SPIDER_SCHED_EDF)
+#define MOTOR_THREAD_PRIORITY SPIDER_EDF_PRIORITY
+#else
 #define MOTOR_THREAD_PRIORITY 1
+#endif
 #define MOTOR_THREAD_STACK_SIZE 1024
 #define UPDATE_PERIOD 20
 
-LOG_MODULE_REGISTER(motors_thread, LOG_LEVEL_DBG);
+LOG_MODULE_REGISTER(motors_thread, CONFIG_SPIDER_LOG_LEVEL);
 K_SEM_DEFINE(motion_finished, 0, 1);
 
+static int64_t phase_origin_us;
+static struct k_spinlock phase_lock;
+static atomic_t ik_calls;
+static atomic_t deadline_ticks;
+static atomic_t deadline_tick_misses;
+static atomic_t deadline_keyframes;
+static atomic_t deadline_keyframe_misses;
+// Motor thread only
+static bool tick_moved;
+
+#if defined(CONFIG_SPIDER_IDLE)
+static K_SEM_DEFINE(wake_sem, 0, 1);
+static atomic_t idle;
+// Bumped by motors_wake(), so a wake racing with the idle entry is not lost
+static atomic_t wake_seq;
+static struct k_spinlock idle_lock;
+static struct motors_idle_stats idle_stats; // under idle_lock
+static int64_t idle_start_us;               // under idle_lock
+#endif
+
+#if defined(CONFIG_SPIDER_TICK_MONITOR)
+static atomic_t faulted;
+static atomic_t stop_pending; // safe stance not set yet
+static struct k_spinlock monitor_lock;
+static struct tick_monitor_stats monitor_stats; // under monitor_lock
+// Motor thread only
+static uint32_t on_time_streak;
+#endif
+#if defined(CONFIG_SPIDER_TICK_WDT)
+static int wdt_channel = -1; // motor thread only
+#endif
+
+static void polar_to_angles(int leg, double alpha, double beta, double gamma,
+                            uint8_t angles[NB_JOINTS]);
+
+/**
+ * @brief first tick strictly after now_us on the grid of UPDATE_PERIOD
+ * anchored at phase_origin_us.
+ */
+static int64_t next_tick_us(int64_t now_us)
+{
+    const int64_t period_us = UPDATE_PERIOD * USEC_PER_MSEC;
+    k_spinlock_key_t key = k_spin_lock(&phase_lock);
+    int64_t elapsed = now_us - phase_origin_us;
+    int64_t origin = phase_origin_us;
+    k_spin_unlock(&phase_lock, key);
+
+    // floor(elapsed / period) + 1, also for an origin in the future
+    int64_t periods = (elapsed >= 0)
+                          ? elapsed / period_us
+                          : -((-elapsed + period_us - 1) / period_us);
+    return origin + (periods + 1) * period_us;
+}
+
+/**
+ * @brief moves the coordinates one step towards the target, without
+ * overshooting it.
+ *
+ * @param was_moving set if the coordinates were not on the target
+ * @return true once on the target
+ */
+static bool step_towards(double pos[NB_JOINTS], const double target[NB_JOINTS],
+                         const double step[NB_JOINTS], bool* was_moving)
+{
+    bool arrived = true;
+
+    for (int i = 0; i < NB_JOINTS; i++)
+    {
+        double remaining_dist = target[i] - pos[i];
+
+        // Prevent overshooting in the final step
+        if (fabs(remaining_dist) < fabs(step[i]))
+            pos[i] = target[i];
+        else
+            pos[i] += step[i];
+
+        *was_moving |= (remaining_dist != 0);
+        arrived &= (pos[i] == target[i]);
+    }
+    return arrived;
+}
+
+/**
+ * @brief moves every leg one step towards its expected position and solves
+ * the servo angles of the tick, without writing them. Called with
+ * g_state_mutex held.
+ *
+ * @param frame angles of the tick
+ * @param moved set if a leg was not on its target
+ * @return number of legs not on their target yet
+ */
+uint32_t motors_step(uint8_t frame[NB_LEGS][NB_JOINTS], bool* moved)
+{
+    static double alpha, beta, gamma;
+    uint32_t ik_cycles = 0;
+    uint32_t moving_legs = 0;
+
+    for (int leg = 0; leg < NB_LEGS; leg++)
+    {
+        bool was_moving = false;
+        bool arrived;
+
+        if (g_state.joint_mode[leg])
+        {
+            // Angles were solved at both ends of the move by set_site_joint()
+            was_moving = g_state.joint_ticks[leg] > 0;
+            if (g_state.joint_ticks[leg] > 1)
+            {
+                for (int joint = 0; joint < NB_JOINTS; joint++)
+                    g_state.joint_now[leg][joint] +=
+                        g_state.joint_speed[leg][joint];
+            }
+            else if (was_moving)
+            {
+                memcpy(g_state.joint_now[leg], g_state.joint_expect[leg],
+                       sizeof(g_state.joint_now[leg]));
+                memcpy(g_state.site_now[leg], g_state.site_expect[leg],
+                       sizeof(g_state.site_now[leg]));
+            }
+            if (was_moving)
+                g_state.joint_ticks[leg]--;
+            arrived = g_state.joint_ticks[leg] == 0;
+            alpha = g_state.joint_now[leg][0];
+            beta = g_state.joint_now[leg][1];
+            gamma = g_state.joint_now[leg][2];
+        }
+        else
+        {
+            arrived = step_towards(g_state.site_now[leg],
+                                   g_state.site_expect[leg],
+                                   g_state.temp_speed[leg], &was_moving);
+
+            uint32_t phase_start = prof_start();
+            cartesian_to_polar(&alpha, &beta, &gamma, g_state.site_now[leg][0],
+                               g_state.site_now[leg][1],
+                               g_state.site_now[leg][2]);
+            ik_cycles += prof_elapsed(phase_start);
+        }
+        if (was_moving && arrived)
+            TRACE_TARGET_REACHED(leg, g_state.keyframe);
+        moving_legs += !arrived;
+        *moved |= was_moving;
+
+        polar_to_angles(leg, alpha, beta, gamma, frame[leg]);
+    }
+
+    prof_add(PROF_IK, ik_cycles);
+    return moving_legs;
+}
+
+/**
+ * @brief moves every leg one step towards its expected position and writes
+ * the servos. The frames of a compiled gait being played are written as they
+ * are. Called with g_state_mutex held.
+ *
+ * @return number of legs not on their target yet
+ */
+uint32_t motors_tick(void)
+{
+    uint8_t frame[NB_LEGS][NB_JOINTS];
+    uint32_t moving_legs;
+    bool moved = false;
+
+    if (gait_cache_next_frame(frame, &moving_legs))
+        moved = true;
+    else
+        moving_legs = motors_step(frame, &moved);
+    tick_moved = moved;
+
+    uint32_t phase_start = prof_start();
+    for (int leg = 0; leg < NB_LEGS; leg++)
+        for (int joint = 0; joint < NB_JOINTS; joint++)
+            set_angle(leg, joint, frame[leg][joint]);
+    commit_servo_frame();
+    prof_add(PROF_SERVO_WRITE, prof_elapsed(phase_start));
+    if (moved)
+        prof_first_servo();
+
+    return moving_legs;
+}
+
+#if defined(CONFIG_SPIDER_TICK_WDT)
+/**
+ * @brief arms the task watchdog of the motor thread: a tick stuck for
+ * SPIDER_TICK_WDT_MS, an I2C transfer that never returns, resets the robot.
+ * The hardware watchdog backs it up when the board has one.
+ */
+static void tick_wdt_start(void)
+{
+    static bool initialized;
+
+    if (!initialized)
+    {
+        int ret = task_wdt_init(DEVICE_DT_GET_OR_NULL(DT_ALIAS(watchdog0)));
+        if (ret < 0)
+        {
+            LOG_ERR("Failed initializing the task watchdog (%d)", ret);
+            return;
+        }
+        initialized = true;
+    }
+
+    wdt_channel = task_wdt_add(CONFIG_SPIDER_TICK_WDT_MS, NULL, NULL);
+    if (wdt_channel < 0)
+        LOG_ERR("Failed adding the motor watchdog channel (%d)", wdt_channel);
+}
+
+// Not ticking on purpose: idle
+static void tick_wdt_stop(void)
+{
+    if (wdt_channel >= 0)
+        task_wdt_delete(wdt_channel);
+    wdt_channel = -1;
+}
+
+static void tick_wdt_feed(void)
+{
+    if (wdt_channel >= 0)
+        task_wdt_feed(wdt_channel);
+}
+#else
+static inline void tick_wdt_start(void) {}
+static inline void tick_wdt_stop(void) {}
+static inline void tick_wdt_feed(void) {}
+#endif
+
+#if defined(CONFIG_SPIDER_IDLE)
+/**
+ * @brief stops ticking until motors_wake(). The PCA9685 keeps generating the
+ * last pulses on its own, so the servos hold the pose without any I2C
+ * traffic, unless they are relaxed. The next tick writes the same frame
+ * again.
+ *
+ * @param seq wake_seq when the tick deciding to go idle started
+ */
+static void motors_idle(atomic_val_t seq)
+{
+    k_sem_reset(&wake_sem);
+    atomic_set(&idle, 1);
+    // Woken between that tick and now: the new targets are not written yet
+    if (atomic_get(&wake_seq) != seq)
+    {
+        atomic_set(&idle, 0);
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&idle_lock);
+    idle_stats.entries++;
+    idle_stats.idle = true;
+    idle_start_us = cmd_timestamp_us();
+    k_spin_unlock(&idle_lock, key);
+    if (IS_ENABLED(CONFIG_SPIDER_IDLE_RELAX))
+        relax_all_servos();
+    tick_wdt_stop();
+
+    k_sem_take(&wake_sem, K_FOREVER);
+
+    tick_wdt_start();
+    if (IS_ENABLED(CONFIG_SPIDER_IDLE_RELAX))
+        resume_servos();
+    key = k_spin_lock(&idle_lock);
+    idle_stats.idle_us += cmd_timestamp_us() - idle_start_us;
+    idle_stats.idle = false;
+    k_spin_unlock(&idle_lock, key);
+    atomic_set(&idle, 0);
+}
+
+/**
+ * @brief restarts the motor ticks if they were stopped. Called whenever the
+ * legs get new targets and before waiting for them.
+ */
+void motors_wake(void)
+{
+    atomic_inc(&wake_seq);
+    if (atomic_get(&idle))
+        k_sem_give(&wake_sem);
+}
+
+void motors_get_idle_stats(struct motors_idle_stats* stats)
+{
+    k_spinlock_key_t key = k_spin_lock(&idle_lock);
+    *stats = idle_stats;
+    if (stats->idle)
+        stats->idle_us += cmd_timestamp_us() - idle_start_us;
+    k_spin_unlock(&idle_lock, key);
+    stats->ticks_skipped = stats->idle_us / (UPDATE_PERIOD * USEC_PER_MSEC);
+}
+#endif
+
+#if defined(CONFIG_SPIDER_TICK_MONITOR)
+/**
+ * @brief accounts a tick against its deadline. SPIDER_TICK_FAULT_MISSES late
+ * or skipped in a row and the robot sits down and refuses the motion
+ * commands, until SPIDER_TICK_RECOVER_TICKS ticks in a row are on time.
+ *
+ * @param late the tick ended after the next one was due
+ * @param skipped ticks of the grid that did not run at all
+ */
+static void monitor_tick(bool late, uint32_t skipped)
+{
+    uint32_t missed = late + skipped;
+
+    k_spinlock_key_t key = k_spin_lock(&monitor_lock);
+    monitor_stats.late += late;
+    monitor_stats.skipped += skipped;
+    monitor_stats.streak = (missed > 0) ? monitor_stats.streak + missed : 0;
+    uint32_t streak = monitor_stats.streak;
+    bool fault = streak >= CONFIG_SPIDER_TICK_FAULT_MISSES &&
+                 atomic_cas(&faulted, 0, 1);
+    if (fault)
+        monitor_stats.faults++;
+    k_spin_unlock(&monitor_lock, key);
+
+    if (fault)
+    {
+        atomic_set(&stop_pending, 1);
+        cancel_command();
+        LOG_ERR("%u motor ticks missed in a row, safe stop", streak);
+    }
+    if (missed > 0)
+    {
+        on_time_streak = 0;
+        return;
+    }
+
+    // Recovered once sitting down was started and the ticks kept up since
+    if (atomic_get(&faulted) && !atomic_get(&stop_pending) &&
+        ++on_time_streak >= CONFIG_SPIDER_TICK_RECOVER_TICKS)
+    {
+        atomic_clear(&faulted);
+        LOG_WRN("Motor ticks on time again, motion commands accepted");
+    }
+}
+
+/**
+ * @brief sets the safe stance once a fault was raised, as soon as the motor
+ * thread gets g_state_mutex and no cached step is being played: its last
+ * frame would overwrite the targets. Called with g_state_mutex held.
+ */
+static void monitor_safe_stop(void)
+{
+    if (atomic_get(&stop_pending) && !gait_cache_playing())
+    {
+        safe_stance();
+        atomic_clear(&stop_pending);
+    }
+}
+
+/**
+ * @brief true after a safe stop, until the motor ticks recover: the motion
+ * commands are refused meanwhile.
+ */
+bool motors_faulted(void)
+{
+    return atomic_get(&faulted) != 0;
+}
+
+void motors_get_monitor_stats(struct tick_monitor_stats* stats)
+{
+    k_spinlock_key_t key = k_spin_lock(&monitor_lock);
+    *stats = monitor_stats;
+    k_spin_unlock(&monitor_lock, key);
+    stats->faulted = motors_faulted();
+}
+#else
+static inline void monitor_tick(bool late, uint32_t skipped) {}
+static inline void monitor_safe_stop(void) {}
+#endif
+
 /**
  * @brief update the legs positions every 20ms. When the positions of the legs
  * reach the expected,
+ *
+ * Ticks are scheduled on absolute times so the period does not drift with the
+ * time spent computing, which lets several robots share the same tick grid.
  */
 void motors_thread(void)
 {
-    static double alpha, beta, gamma;
-    k_timeout_t period = K_MSEC(UPDATE_PERIOD);
+    uint32_t last_tick_start = 0;
+    uint32_t tick = 0;
+#if defined(CONFIG_SPIDER_IDLE)
+    int64_t quiet_since_us = 0;
+#endif
+
+    // Nothing sensible to write to the servos before the boot stance is set
+    k_event_wait(&robot_ready, ROBOT_READY, false, K_FOREVER);
+    tick_wdt_start();
+    int64_t next_us = next_tick_us(cmd_timestamp_us());
 
     while (true)
     {
-        if (k_mutex_lock(&g_state_mutex, K_MSEC(UPDATE_PERIOD / 2)) != 0)
+        // The tick must be over before the next one
+        sched_deadline_at(next_tick_us(next_us));
+        // Woken up early when the gait thread moves the tick grid
+        if (k_sleep(K_TIMEOUT_ABS_US(next_us)) > 0)
         {
-            LOG_ERR("Fail locking the mutex");
+            next_us = next_tick_us(cmd_timestamp_us());
             continue;
         }
+        tick_wdt_feed();
+
+#if defined(CONFIG_SPIDER_IDLE)
+        atomic_val_t seq = atomic_get(&wake_seq);
+#endif
+        uint32_t tick_start = prof_start();
+        if (last_tick_start != 0)
+            prof_add(PROF_TICK_PERIOD, tick_start - last_tick_start);
+        last_tick_start = tick_start;
 
-        for (int leg = 0; leg < NB_LEGS; leg++)
+        if (state_lock(K_MSEC(UPDATE_PERIOD / 2)) != 0)
         {
-            for (int joint = 0; joint < NB_JOINTS; joint++)
-            {
-                double current_pos = g_state.site_now[leg][joint];
-                double target_pos = g_state.site_expect[leg][joint];
-                double remaining_dist = target_pos - current_pos;
+            LOG_ERR_LIMITED("Fail locking the mutex");
+            monitor_tick(false, 1);
+            next_us = next_tick_us(cmd_timestamp_us());
+            continue;
+        }
+        prof_add(PROF_MUTEX_WAIT, prof_elapsed(tick_start));
 
-                double step_dist = g_state.temp_speed[leg][joint];
+        monitor_safe_stop();
+        uint32_t moving_legs = motors_tick();
 
-                // Prevent overshooting in the final step
-                if (fabs(remaining_dist) < fabs(step_dist))
-                    g_state.site_now[leg][joint] = target_pos;
-                else
-                    g_state.site_now[leg][joint] += step_dist;
-            }
-            cartesian_to_polar(&alpha, &beta, &gamma, g_state.site_now[leg][0],
-                               g_state.site_now[leg][1],
-                               g_state.site_now[leg][2]);
-            polar_to_servo(leg, alpha, beta, gamma);
-        }
+        if (state_unlock() != 0)
+            LOG_ERR_LIMITED("Fail unlocking the mutex");
+        TRACE_SERVO_FRAME(tick++, moving_legs);
+        prof_add(PROF_TICK, prof_elapsed(tick_start));
+        atomic_inc(&deadline_ticks);
+        bool late = cmd_timestamp_us() > next_tick_us(next_us);
+        if (late)
+            atomic_inc(&deadline_tick_misses);
+        // Skip the ticks we overran instead of bursting to catch up
+        int64_t following_us = next_tick_us(MAX(next_us, cmd_timestamp_us()));
+        // Ticks of the grid that never ran, between this one and the next
+        int64_t periods =
+            (following_us - next_us) / (UPDATE_PERIOD * USEC_PER_MSEC);
+        monitor_tick(late, (uint32_t)MAX(periods - 1, 0));
 
-        if (k_mutex_unlock(&g_state_mutex) != 0)
-            LOG_ERR("Fail unlocking the mutex");
+#if defined(CONFIG_SPIDER_IDLE)
+        // Standing still: nothing new to write until the next target. The
+        // ticks go on after a safe stop, to recover
+        if (tick_moved || quiet_since_us == 0)
+            quiet_since_us = next_us;
+        else if (!motors_faulted() &&
+                 next_us - quiet_since_us >=
+                     CONFIG_SPIDER_IDLE_MS * USEC_PER_MSEC)
+        {
+            motors_idle(seq);
+            quiet_since_us = 0;
+            last_tick_start = 0;
+            next_us = next_tick_us(cmd_timestamp_us());
+            continue;
+        }
+#endif
 
-        k_sleep(period);
+        next_us = following_us;
     }
 }
 
 K_THREAD_DEFINE(motor_thread_id, MOTOR_THREAD_STACK_SIZE, motors_thread, NULL,
-                NULL, NULL, MOTOR_THREAD_PRIORITY, K_USER, 0);
+                NULL, NULL, MOTOR_THREAD_PRIORITY, K_USER,
+                SPIDER_THREAD_DELAY);
+
+/**
+ * @brief moves the tick grid so that a tick lands exactly on origin_us, used
+ * to start a scheduled gait at the same instant on several robots.
+ *
+ * @param origin_us uptime of the tick to align on
+ */
+void motors_align_phase(int64_t origin_us)
+{
+    k_spinlock_key_t key = k_spin_lock(&phase_lock);
+    phase_origin_us = origin_us;
+    k_spin_unlock(&phase_lock, key);
 
+    k_wakeup(motor_thread_id);
+}
+
+/**
+ * @brief inverse kinematics of a leg. set_site() only accepts reachable
+ * targets, but the straight path between two of them can cross the edge of
+ * the workspace: the acos arguments are clamped so that the leg stretches
+ * towards the point instead of getting NaN angles.
+ */
 void cartesian_to_polar(double* alpha, double* beta, double* gamma, double x,
                         double y, double z)
 {
     double v, w;
+    atomic_inc(&ik_calls);
     w = (x >= 0 ? 1 : -1) * (sqrt(pow(x, 2) + pow(y, 2)));
-    v = w - g_state.length_c;
-    *alpha =
-        atan2(z, v) + acos((pow(g_state.length_a, 2) -
-                            pow(g_state.length_b, 2) + pow(v, 2) + pow(z, 2)) /
-                           2 / g_state.length_a / sqrt(pow(v, 2) + pow(z, 2)));
-    *beta = acos((pow(g_state.length_a, 2) + pow(g_state.length_b, 2) -
-                  pow(v, 2) - pow(z, 2)) /
-                 2 / g_state.length_a / g_state.length_b);
+    v = w - g_config.length_c;
+    double cos_alpha = (pow(g_config.length_a, 2) - pow(g_config.length_b, 2) +
+                        pow(v, 2) + pow(z, 2)) /
+                       2 / g_config.length_a / sqrt(pow(v, 2) + pow(z, 2));
+    double cos_beta = (pow(g_config.length_a, 2) + pow(g_config.length_b, 2) -
+                       pow(v, 2) - pow(z, 2)) /
+                      2 / g_config.length_a / g_config.length_b;
+    *alpha = atan2(z, v) + acos(CLAMP(cos_alpha, -1.0, 1.0));
+    *beta = acos(CLAMP(cos_beta, -1.0, 1.0));
     // calculate x-y-z degree
     *gamma = (w >= 0) ? atan2(y, x) : atan2(-y, -x);
 
@@ -91,7 +542,35 @@ void cartesian_to_polar(double* alpha, double* beta, double* gamma, double x,
     *gamma = *gamma / PI_CONST * 180;
 }
 
-void polar_to_servo(int leg, double alpha, double beta, double gamma)
+/**
+ * @brief forward kinematics of a leg, the inverse of cartesian_to_polar().
+ */
+void polar_to_cartesian(double* x, double* y, double* z, double alpha,
+                        double beta, double gamma)
+{
+    // trans degree 180->pi
+    alpha = alpha / 180 * PI_CONST;
+    beta = beta / 180 * PI_CONST;
+    gamma = gamma / 180 * PI_CONST;
+
+    double v = g_config.length_a * cos(alpha) -
+               g_config.length_b * cos(alpha + beta);
+    double w = v + g_config.length_c;
+    *x = w * cos(gamma);
+    *y = w * sin(gamma);
+    *z = g_config.length_a * sin(alpha) - g_config.length_b * sin(alpha + beta);
+}
+
+/**
+ * @brief number of cartesian_to_polar() calls since boot, wraps.
+ */
+uint32_t ik_call_count(void) { return (uint32_t)atomic_get(&ik_calls); }
+
+/**
+ * @brief servo angles of a leg from its joint angles.
+ */
+static void polar_to_angles(int leg, double alpha, double beta, double gamma,
+                            uint8_t angles[NB_JOINTS])
 {
     if (leg == 0)
     {
@@ -119,7 +598,53 @@ void polar_to_servo(int leg, double alpha, double beta, double gamma)
         gamma += 90;
     }
 
-    set_angle(leg, 0, alpha);
-    set_angle(leg, 1, beta);
-    set_angle(leg, 2, gamma);
+    // Out of range angles would wrap around in the uint8_t
+    angles[0] = CLAMP(alpha, 0, 180);
+    angles[1] = CLAMP(beta, 0, 180);
+    angles[2] = CLAMP(gamma, 0, 180);
+}
+
+void polar_to_servo(int leg, double alpha, double beta, double gamma)
+{
+    uint8_t angles[NB_JOINTS];
+
+    polar_to_angles(leg, alpha, beta, gamma, angles);
+    for (int joint = 0; joint < NB_JOINTS; joint++)
+        set_angle(leg, joint, angles[joint]);
+}
+
+/**
+ * @brief first motor tick strictly after after_us, on the current tick grid.
+ */
+int64_t motors_next_tick_us(int64_t after_us)
+{
+    return next_tick_us(after_us);
+}
+
+/**
+ * @brief accounts a keyframe written by the gait thread.
+ *
+ * @param missed written after the tick it was due for
+ */
+void motors_count_keyframe(bool missed)
+{
+    atomic_inc(&deadline_keyframes);
+    if (missed)
+        atomic_inc(&deadline_keyframe_misses);
+}
+
+void motors_get_deadline_stats(struct deadline_stats* stats)
+{
+    stats->ticks = atomic_get(&deadline_ticks);
+    stats->tick_misses = atomic_get(&deadline_tick_misses);
+    stats->keyframes = atomic_get(&deadline_keyframes);
+    stats->keyframe_misses = atomic_get(&deadline_keyframe_misses);
+}
+
+void motors_reset_deadline_stats(void)
+{
+    atomic_clear(&deadline_ticks);
+    atomic_clear(&deadline_tick_misses);
+    atomic_clear(&deadline_keyframes);
+    atomic_clear(&deadline_keyframe_misses);
 }
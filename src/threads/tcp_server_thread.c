@@ -4,185 +4,821 @@
  * Purpose: Runs a TCP server and listens for command on port 5000 to forward to
  *the gait thread..
  *====================================================================*/
+#include "boot_report.h"
+#include "command_queue.h"
+#include "conn_mgr.h"
+#include "gait_asset.h"
+#include "gait_cache.h"
+#include "profiling.h"
+#include "robot_settings.h"
 #include "spider_robot.h"
+#include "state_lock.h"
 #include "zephyr/logging/log.h"
+#include "zephyr/logging/log_backend.h"
+#include "zephyr/logging/log_ctrl.h"
 #include "zephyr/net/net_ip.h"
-#include "zephyr/net/net_mgmt.h"
+#include "zephyr/sys/util.h"
 #include <ctype.h>
 #include <errno.h>
+#include <math.h>
+#include <stdarg.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <zephyr/kernel.h>
-#include <zephyr/net/net_event.h>
-#include <zephyr/net/net_if.h>
 #include <zephyr/net/socket.h>
-#include <zephyr/net/wifi_mgmt.h>
 
-#define SERVER_PORT 5000
 #define MAX_CLIENT_QUEUE 1
 
-LOG_MODULE_REGISTER(tcp_server, LOG_LEVEL_DBG);
-K_SEM_DEFINE(wifi_connected, 0, 1);
-K_SEM_DEFINE(ipv4_obtained, 0, 1);
-K_MSGQ_DEFINE(tcp_command_q, sizeof(struct tcp_command), 5, 1);
+LOG_MODULE_REGISTER(tcp_server, CONFIG_SPIDER_LOG_LEVEL);
+uint16_t tcp_server_port = CONFIG_SPIDER_SERVER_PORT;
 
-static struct net_mgmt_event_callback wifi_cb;
-static struct net_mgmt_event_callback ipv4_cb;
+// TCP_SERVER
+#if defined(CONFIG_SPIDER_SCHED_EDF)
+#define TCP_SERVER_THREAD_PRIORITY SPIDER_EDF_PRIORITY
+#else
+#define TCP_SERVER_THREAD_PRIORITY 5
+#endif
+#define TCP_SERVER_STACK_SIZE 2048
+#define CLIENT_POLL_PERIOD_MS 50
+// Silence after which an unterminated command is run, for clients that never
+// send a newline
+#define UNFRAMED_IDLE_MS 1000
+#define TX_BUF_SIZE 96
+#define RX_LINE_BUF_SIZE (4 * RX_BUF_SIZE)
 
-static void handle_ipv4_result(struct net_if* iface)
+static uint32_t next_cmd_id;
+static int64_t rx_timestamp_us; // Uptime at which the last segment arrived
+static uint32_t rx_cycles;      // Same instant, for the latency profiling
+
+void parse_rx_buffer(char* rx_buf, int rx_len, char* command, int* times)
 {
-    int i = 0;
+    // PARSE buffer
+    size_t i = 0;
+    while (i < rx_len && i < RX_BUF_SIZE - 1 && rx_buf[i] != ' ' &&
+           rx_buf[i] != '\0' && rx_buf[i] != '\r')
+        i++;
 
-    for (i = 0; i < NET_IF_MAX_IPV4_ADDR; i++)
+    memcpy(command, rx_buf, i);
+    command[i] = '\0';
+
+    // Get the number after the command
+    char num[3];
+    if (rx_buf[i] == ' ' && isdigit(rx_buf[i + 1]))
     {
-        char buf[NET_IPV4_ADDR_LEN];
+        i++;
+        size_t j = 0;
+        while (rx_buf[i] != '\0' && j < 2)
+            num[j++] = rx_buf[i++];
+        num[j] = '\0';
+    }
+    else
+        strcpy(num, "1");
 
-        if (iface->config.ip.ipv4->unicast[i].ipv4.addr_type != NET_ADDR_DHCP)
-        {
-            continue;
-        }
+    *times = atoi(num);
+    if (*times > 10)
+        *times = 10;
+}
 
-        LOG_INF("IPv4 address: %s",
-                net_addr_ntop(
-                    AF_INET,
-                    &iface->config.ip.ipv4->unicast[i].ipv4.address.in_addr,
-                    buf, sizeof(buf)));
+static const char* const ack_names[] = {
+    [CMD_ACK_ACCEPTED] = "accepted",
+    [CMD_ACK_REJECTED] = "rejected",
+    [CMD_ACK_QUEUE_FULL] = "full",
+    [CMD_ACK_COALESCED] = "coalesced",
+    [CMD_ACK_FAULTED] = "faulted",
+};
+
+/**
+ * @brief formats a line and sends it to the client.
+ *
+ * @param client_socket
+ * @param fmt
+ * @return 0 on success, negative errno otherwise
+ */
+static int send_reply(int client_socket, const char* fmt, ...)
+{
+    char tx_buf[TX_BUF_SIZE];
+    va_list args;
+
+    va_start(args, fmt);
+    int len = vsnprintk(tx_buf, sizeof(tx_buf), fmt, args);
+    va_end(args);
+    len = MIN(len, (int)sizeof(tx_buf) - 1);
+
+    if (zsock_send(client_socket, tx_buf, len, 0) < 0)
+    {
+        LOG_ERR("Failed sending reply (%d)", errno);
+        return -errno;
     }
+    return 0;
+}
 
-    k_sem_give(&ipv4_obtained);
+/**
+ * @brief forwards the completion events posted by the gait thread.
+ */
+static void send_completions(int client_socket)
+{
+    struct cmd_completion done;
+
+    while (k_msgq_get(&cmd_completion_q, &done, K_NO_WAIT) == 0)
+    {
+        if (done.cancelled)
+            send_reply(client_socket, "CANCEL %u %s\n", done.id, done.command);
+        else
+            send_reply(client_socket, "DONE %u %s %lld %lld %lld\n", done.id,
+                       done.command, done.enqueued_us, done.started_us,
+                       done.finished_us);
+    }
 }
 
 /**
- * @brief Network management event handler.
- *
- * Handles WiFi connect/disconnect and IPv4 address events.
- * Signals semaphores on successful connection or IP acquisition.
+ * @brief validates the command and forwards it to the gait thread. While the
+ * command's lane is full the client is not read from anymore, so the TCP
+ * window fills up and holds the client back; completions keep flowing in the
+ * meantime so the client sees the lane draining.
  *
- * @param event_cb Event callback structure.
- * @param mgmt_event Network management event type.
- * @param iface Network interface pointer.
+ * @return the acknowledgement to report to the client
  */
-static void net_event_handler(struct net_mgmt_event_callback* event_cb,
-                              uint64_t mgmt_event, struct net_if* iface)
+static enum cmd_ack submit_command(int client_socket, struct tcp_command* cmd,
+                                   uint32_t* merged_id)
 {
-    switch (mgmt_event)
+    const struct cmd_entry* entry = find_command(cmd->command);
+    if (entry == NULL || cmd->times <= 0)
+        return CMD_ACK_REJECTED;
+    // Sitting after the motor ticks missed their deadlines
+    if (motors_faulted())
+        return CMD_ACK_FAULTED;
+    // The gait being run is cut now, stop drops the ones waiting once queued
+    if (strcmp(entry->name, "stop") == 0)
+        cancel_command();
+
+    cmd->enqueued_us = cmd_timestamp_us();
+    cmd->enqueued_cycles = k_cycle_get_32();
+
+    int64_t deadline = k_uptime_get() + CONFIG_SPIDER_CMD_BACKPRESSURE_MS;
+    while (true)
     {
-        case NET_EVENT_WIFI_CONNECT_RESULT:
+        int ret = cmd_queue_put(cmd, entry->lane, K_MSEC(CLIENT_POLL_PERIOD_MS),
+                                merged_id);
+        if (ret == 0)
+            return CMD_ACK_ACCEPTED;
+        if (ret > 0)
+            return CMD_ACK_COALESCED;
+
+        send_completions(client_socket);
+        if (k_uptime_get() >= deadline)
         {
-            const struct wifi_status* status =
-                (const struct wifi_status*)event_cb->info;
-            if (status->status == 0)
-            {
-                LOG_INF("Wifi connected!");
-                k_sem_give(&wifi_connected);
-            }
-            else
-            {
-                LOG_ERR("Wifi connection failed (%d)", status->status);
-            }
-            break;
+            LOG_DBG("Command lane %d is full", entry->lane);
+            cmd_queue_count_dropped();
+            return CMD_ACK_QUEUE_FULL;
         }
-        case NET_EVENT_WIFI_DISCONNECT_RESULT:
-        {
-            const struct wifi_status* status =
-                (const struct wifi_status*)event_cb->info;
-            if (status->status)
-                LOG_DBG("Wifi disconnection request (%d)", status->status);
-            else
-            {
-                LOG_ERR("Wifi diconnected");
-                k_sem_take(&wifi_connected, K_NO_WAIT);
-            }
-        }
-        case NET_EVENT_IPV4_ADDR_ADD:
-            handle_ipv4_result(iface);
-            break;
-        default:
-            break;
     }
 }
 
-void wifi_connect(void)
+static void server_cmd_stats(int client_socket, const char* args)
 {
-    struct net_if* iface = net_if_get_default();
+    struct cmd_queue_stats stats;
 
-    struct wifi_connect_req_params wifi_params = {0};
+    if (strstr(args, "reset") != NULL)
+    {
+        cmd_queue_reset_stats();
+        return;
+    }
 
-    wifi_params.ssid = CONFIG_MY_WIFI_SSID;
-    wifi_params.psk = CONFIG_MY_WIFI_PSK;
-    wifi_params.ssid_length = strlen(CONFIG_MY_WIFI_SSID);
-    wifi_params.psk_length = strlen(CONFIG_MY_WIFI_PSK);
-    wifi_params.channel = WIFI_CHANNEL_ANY;
-    wifi_params.security = WIFI_SECURITY_TYPE_PSK;
-    wifi_params.band = WIFI_FREQ_BAND_2_4_GHZ;
-    wifi_params.mfp = WIFI_MFP_OPTIONAL;
+    cmd_queue_get_stats(&stats);
+    send_reply(client_socket,
+               "STATS queued=%u coalesced=%u dropped=%u cancelled=%u\n",
+               stats.queued, stats.coalesced, stats.dropped, stats.cancelled);
+    for (int lane = 0; lane < CMD_LANE_COUNT; lane++)
+        send_reply(client_socket, "STATS lane=%d pending=%u high_water=%u\n",
+                   lane, stats.pending[lane], stats.high_water[lane]);
+}
 
-    LOG_INF("Connecting to SSID: %s", wifi_params.ssid);
+/**
+ * @brief clock sync exchange. Echoes the host timestamp along with the uptime
+ * at which the request was received and the reply sent (NTP style), from
+ * which the host derives the offset between both clocks and its uncertainty.
+ */
+static void server_cmd_sync(int client_socket, const char* args)
+{
+    long long host_ts = strtoll(args, NULL, 10);
 
-    if (net_mgmt(NET_REQUEST_WIFI_CONNECT, iface, &wifi_params,
-                 sizeof(struct wifi_connect_req_params)))
-        LOG_ERR("WiFi Connection Request Failed");
+    send_reply(client_socket, "SYNC %lld %lld %lld\n", host_ts,
+               rx_timestamp_us, cmd_timestamp_us());
 }
 
-// TCP_SERVER
-#define TCP_SERVER_THREAD_PRIORITY 5
-#define TCP_SERVER_STACK_SIZE 2048
+static void server_cmd_boot(int client_socket, const char* args)
+{
+    (void)args;
 
-void parse_rx_buffer(char* rx_buf, int rx_len, char* command, int* times)
+    for (int stage = 0; stage < BOOT_STAGE_COUNT; stage++)
+        send_reply(client_socket, "BOOT %s %lld\n", boot_stage_name(stage),
+                   boot_stage_us(stage));
+}
+
+static void server_cmd_net(int client_socket, const char* args)
 {
-    // PARSE buffer
-    size_t i = 0;
-    while (i < rx_len && rx_buf[i] != ' ' && rx_buf[i] != '\0' &&
-           rx_buf[i] != '\r')
-        i++;
+    struct conn_mgr_stats stats;
+
+    (void)args;
+    conn_mgr_get_stats(&stats);
+    send_reply(client_socket,
+               "NET state=%d generation=%u attempts=%u failures=%u losses=%u\n",
+               conn_mgr_state(), conn_mgr_generation(), stats.attempts,
+               stats.failures, stats.link_losses);
+    send_reply(client_socket, "NET recovery_us last=%lld max=%lld\n",
+               stats.last_recovery_us, stats.max_recovery_us);
+}
 
-    memcpy(command, rx_buf, i);
-    command[i] = '\0';
+#if defined(CONFIG_SPIDER_PROFILING)
+static void server_cmd_prof(int client_socket, const char* args)
+{
+    struct prof_summary summary;
 
-    // Get the number after the command
-    char num[2];
-    if (rx_buf[i] == ' ' && isdigit(rx_buf[i + 1]))
+    if (strstr(args, "reset") != NULL)
     {
-        i++;
-        size_t j = 0;
-        while (rx_buf[i] != '\0' && j < 2)
-            num[j++] = rx_buf[i++];
-        num[j] = '\0';
+        prof_reset();
+        return;
     }
+
+    for (int phase = 0; phase < PROF_PHASE_COUNT; phase++)
+    {
+        prof_get(phase, &summary);
+        send_reply(client_socket,
+                   "PROF %s n=%u min=%u max=%u mean=%u p99=%u\n",
+                   prof_phase_name(phase), summary.count, summary.min_ns,
+                   summary.max_ns, summary.mean_ns, summary.p99_ns);
+    }
+}
+#endif
+
+#if defined(CONFIG_SPIDER_LOCK_STATS)
+#define LOCK_SITES_REPORTED 5
+
+/**
+ * @brief reports the g_state_mutex call sites holding it the longest
+ */
+static void server_cmd_locks(int client_socket, const char* args)
+{
+    static struct lock_site_stats worst[LOCK_SITES_REPORTED];
+
+    if (strstr(args, "reset") != NULL)
+    {
+        lock_stats_reset();
+        return;
+    }
+
+    int count = lock_stats_worst(worst, ARRAY_SIZE(worst));
+    for (int i = 0; i < count; i++)
+    {
+        const char* file = strrchr(worst[i].file, '/');
+
+        send_reply(client_socket,
+                   "LOCK %s:%d n=%u timeouts=%u wait=%llu/%u hold=%llu/%u\n",
+                   file ? file + 1 : worst[i].file, worst[i].line,
+                   worst[i].acquired, worst[i].timeouts,
+                   k_cyc_to_us_floor64(worst[i].wait_cycles),
+                   k_cyc_to_us_floor32(worst[i].max_wait_cycles),
+                   k_cyc_to_us_floor64(worst[i].hold_cycles),
+                   k_cyc_to_us_floor32(worst[i].max_hold_cycles));
+    }
+}
+#endif
+
+#if defined(CONFIG_SPIDER_GAIT_CACHE)
+/**
+ * @brief memory taken by the compiled gaits against the kinematics they saved
+ */
+static void server_cmd_cache(int client_socket, const char* args)
+{
+    struct gait_cache_stats stats;
+
+    if (strstr(args, "off") != NULL || strstr(args, "on") != NULL)
+    {
+        gait_cache_enable(strstr(args, "on") != NULL);
+        return;
+    }
+
+    gait_cache_get_stats(&stats);
+    send_reply(client_socket,
+               "CACHE clips=%u frames=%u bytes=%u compile_us=%u\n",
+               stats.clips, stats.frames, stats.bytes, stats.compile_us);
+    send_reply(client_socket, "CACHE plays=%u misses=%u ik_saved=%u\n",
+               stats.plays, stats.misses, stats.ik_saved);
+}
+#endif
+
+#if defined(CONFIG_SPIDER_IDLE)
+/**
+ * @brief time the motor thread spent without ticking since boot
+ */
+static void server_cmd_idle(int client_socket, const char* args)
+{
+    struct motors_idle_stats stats;
+    int64_t uptime_us = MAX(cmd_timestamp_us(), 1);
+
+    motors_get_idle_stats(&stats);
+    send_reply(client_socket,
+               "IDLE %s entries=%u idle_ms=%llu residency=%u%%\n",
+               stats.idle ? "idle" : "active", stats.entries,
+               stats.idle_us / USEC_PER_MSEC,
+               (uint32_t)(stats.idle_us * 100 / uptime_us));
+    send_reply(client_socket, "IDLE ticks_skipped=%llu writes_saved=%llu\n",
+               stats.ticks_skipped, stats.ticks_skipped * NB_SERVOS);
+}
+#endif
+
+/**
+ * @brief deadlines of the motor ticks and of the keyframes missed since boot
+ */
+static void server_cmd_sched(int client_socket, const char* args)
+{
+    struct deadline_stats stats;
+
+    motors_get_deadline_stats(&stats);
+    send_reply(client_socket, "SCHED %s ticks=%u misses=%u\n",
+               IS_ENABLED(CONFIG_SPIDER_SCHED_EDF) ? "edf" : "fixed",
+               stats.ticks, stats.tick_misses);
+    send_reply(client_socket, "SCHED keyframes=%u misses=%u\n",
+               stats.keyframes, stats.keyframe_misses);
+}
+
+#if defined(CONFIG_SPIDER_TICK_MONITOR)
+/**
+ * @brief motor ticks that missed their deadline and the safe stops since boot
+ */
+static void server_cmd_monitor(int client_socket, const char* args)
+{
+    struct tick_monitor_stats stats;
+
+    motors_get_monitor_stats(&stats);
+    send_reply(client_socket,
+               "MONITOR %s late=%u skipped=%u streak=%u faults=%u\n",
+               stats.faulted ? "faulted" : "ok", stats.late, stats.skipped,
+               stats.streak, stats.faults);
+}
+#endif
+
+#if defined(CONFIG_SPIDER_GAIT_ASSETS)
+// Bytes of an asset carried by a gdat line, hex encoded
+#define GAIT_DATA_CHUNK 48
+
+/**
+ * @brief "gput <size>": starts the upload of a gait asset, sent in gdat lines
+ */
+static void server_cmd_gput(int client_socket, const char* args)
+{
+    int ret = gait_asset_upload_start(strtoul(args, NULL, 10));
+
+    if (ret < 0)
+        send_reply(client_socket, "GAIT error %d\n", ret);
     else
-        strcpy(num, "1");
+        send_reply(client_socket, "GAIT ready\n");
+}
 
-    *times = atoi(num);
-    if (*times > 10)
-        *times = 10;
+/**
+ * @brief "gdat <hex>": next bytes of the asset. The asset is validated and
+ * stored once complete.
+ */
+static void server_cmd_gdat(int client_socket, const char* args)
+{
+    uint8_t data[GAIT_DATA_CHUNK];
+    struct gait_asset_info info;
+
+    while (*args == ' ')
+        args++;
+    size_t hex_len = strcspn(args, "\r ");
+    size_t len = hex2bin(args, hex_len, data, sizeof(data));
+
+    int ret = (len > 0) ? gait_asset_upload_append(data, len) : -EINVAL;
+    if (ret > 0)
+        return;
+    if (ret == 0)
+        ret = gait_asset_upload_commit(&info);
+
+    if (ret < 0)
+        send_reply(client_socket, "GAIT error %d\n", ret);
+    else
+        send_reply(client_socket, "GAIT stored %s %u %u\n", info.name,
+                   info.size, info.keyframes);
 }
 
-void handle_client(int client_socket)
+static void list_gait(const struct gait_asset_info* info, void* arg)
+{
+    send_reply(*(int*)arg, "GAIT %s %u %u\n", info->name, info->size,
+               info->keyframes);
+}
+
+/**
+ * @brief lists the gaits stored and the room left for more
+ */
+static void server_cmd_glist(int client_socket, const char* args)
+{
+    (void)args;
+
+    int ret = gait_asset_foreach(list_gait, &client_socket);
+    if (ret < 0)
+        send_reply(client_socket, "GAIT error %d\n", ret);
+    else
+        send_reply(client_socket, "GAIT end %d\n", ret);
+}
+
+static void server_cmd_gerase(int client_socket, const char* args)
+{
+    (void)args;
+
+    int ret = gait_asset_erase();
+    if (ret < 0)
+        send_reply(client_socket, "GAIT error %d\n", ret);
+    else
+        send_reply(client_socket, "GAIT erased\n");
+}
+#endif
+
+#if defined(CONFIG_SPIDER_SETTINGS)
+/**
+ * @brief formats a parameter with 3 decimals, without the floating point
+ * support of printk
+ */
+static void format_milli(char* buf, size_t size, double value)
+{
+    long long milli = llround(value * 1000.0);
+    const char* sign = milli < 0 ? "-" : "";
+
+    milli = llabs(milli);
+    snprintk(buf, size, "%s%lld.%03lld", sign, milli / 1000, milli % 1000);
+}
+
+static void reply_param(int client_socket, const struct robot_param_value* p)
+{
+    char value[24], pending[24];
+
+    format_milli(value, sizeof(value), p->value);
+    if (p->is_pending)
+    {
+        format_milli(pending, sizeof(pending), p->pending);
+        send_reply(client_socket, "PARAM %s %s pending %s\n", p->name, value,
+                   pending);
+    }
+    else
+        send_reply(client_socket, "PARAM %s %s\n", p->name, value);
+}
+
+/**
+ * @brief "get [name]": the tunable parameters, and the values waiting for
+ * the next command
+ */
+static void server_cmd_get(int client_socket, const char* args)
+{
+    struct robot_param_value param;
+
+    while (*args == ' ')
+        args++;
+    for (int i = 0; robot_settings_get(i, &param) == 0; i++)
+    {
+        if (*args == '\0' || strcmp(args, param.name) == 0)
+            reply_param(client_socket, &param);
+    }
+    send_reply(client_socket, "PARAM end\n");
+}
+
+/**
+ * @brief "set <name> <value>" tunes and stores a parameter, "set default"
+ * goes back to the built in values
+ */
+static void server_cmd_set(int client_socket, const char* args)
+{
+    char name[RX_BUF_SIZE];
+    char* end;
+    int ret;
+
+    while (*args == ' ')
+        args++;
+    size_t len = MIN(strcspn(args, " \r"), sizeof(name) - 1);
+    memcpy(name, args, len);
+    name[len] = '\0';
+
+    bool reset = strcmp(name, "default") == 0;
+    if (reset)
+        ret = robot_settings_reset();
+    else
+    {
+        double value = strtod(args + len, &end);
+        ret = (end == args + len) ? -EINVAL : robot_settings_set(name, value);
+    }
+
+    if (ret < 0)
+        send_reply(client_socket, "PARAM error %d\n", ret);
+    else
+        server_cmd_get(client_socket, reset ? "" : name);
+}
+#endif
+
+#if defined(CONFIG_LOG_RUNTIME_FILTERING)
+static const char* const log_level_names[] = {"none", "err", "wrn", "inf",
+                                              "dbg"};
+
+static void reply_log_level(int client_socket, int16_t source_id)
+{
+    const struct log_backend* backend = log_backend_get(0);
+    uint32_t level =
+        log_filter_get(backend, Z_LOG_LOCAL_DOMAIN_ID, source_id, true);
+    uint32_t built =
+        log_filter_get(backend, Z_LOG_LOCAL_DOMAIN_ID, source_id, false);
+
+    send_reply(client_socket, "LOG %s %s %s\n",
+               log_source_name_get(Z_LOG_LOCAL_DOMAIN_ID, source_id),
+               log_level_names[MIN(level, LOG_LEVEL_DBG)],
+               log_level_names[MIN(built, LOG_LEVEL_DBG)]);
+}
+
+static int parse_log_level(const char* arg)
+{
+    size_t len = strcspn(arg, " \r");
+
+    for (int i = 0; i < ARRAY_SIZE(log_level_names); i++)
+    {
+        if (strlen(log_level_names[i]) == len &&
+            strncmp(arg, log_level_names[i], len) == 0)
+            return i;
+    }
+    return -EINVAL;
+}
+
+/**
+ * @brief "log [module [level]]": the runtime and built in levels of the log
+ * modules, or lowers/raises one of them up to the level it was built with
+ */
+static void server_cmd_log(int client_socket, const char* args)
+{
+    char name[RX_BUF_SIZE];
+    int16_t source_id = -1;
+
+    while (*args == ' ')
+        args++;
+    size_t len = MIN(strcspn(args, " \r"), sizeof(name) - 1);
+    memcpy(name, args, len);
+    name[len] = '\0';
+    args += len;
+    while (*args == ' ')
+        args++;
+    bool set_level = *args != '\0' && *args != '\r';
+
+    if (log_backend_count_get() == 0)
+    {
+        send_reply(client_socket, "LOG error %d\n", -ENODEV);
+        return;
+    }
+    if (len > 0)
+    {
+        source_id = log_source_id_get(name);
+        if (source_id < 0)
+        {
+            send_reply(client_socket, "LOG error %d\n", -ENOENT);
+            return;
+        }
+    }
+
+    if (source_id >= 0 && set_level)
+    {
+        int level = parse_log_level(args);
+        if (level < 0)
+        {
+            send_reply(client_socket, "LOG error %d\n", level);
+            return;
+        }
+        // Every backend, capped to the built in level
+        log_filter_set(NULL, Z_LOG_LOCAL_DOMAIN_ID, source_id, level);
+    }
+
+    if (source_id >= 0)
+        reply_log_level(client_socket, source_id);
+    else
+    {
+        for (uint32_t i = 0; i < log_src_cnt_get(Z_LOG_LOCAL_DOMAIN_ID); i++)
+            reply_log_level(client_socket, i);
+    }
+    send_reply(client_socket, "LOG end\n");
+}
+#endif
+
+/**
+ * @brief Commands answered by the server itself, never queued
+ */
+static const struct server_cmd
+{
+    const char* name;
+    void (*fn)(int client_socket, const char* args);
+} server_cmds[] = {
+    {"stats", server_cmd_stats},
+    {"sync", server_cmd_sync},
+    {"boot", server_cmd_boot},
+    {"net", server_cmd_net},
+#if defined(CONFIG_SPIDER_PROFILING)
+    {"prof", server_cmd_prof},
+#endif
+#if defined(CONFIG_SPIDER_LOCK_STATS)
+    {"locks", server_cmd_locks},
+#endif
+#if defined(CONFIG_SPIDER_GAIT_CACHE)
+    {"cache", server_cmd_cache},
+#endif
+#if defined(CONFIG_SPIDER_IDLE)
+    {"idle", server_cmd_idle},
+#endif
+    {"sched", server_cmd_sched},
+#if defined(CONFIG_SPIDER_TICK_MONITOR)
+    {"monitor", server_cmd_monitor},
+#endif
+#if defined(CONFIG_SPIDER_GAIT_ASSETS)
+    {"gput", server_cmd_gput},
+    {"gdat", server_cmd_gdat},
+    {"glist", server_cmd_glist},
+    {"gerase", server_cmd_gerase},
+#endif
+#if defined(CONFIG_SPIDER_SETTINGS)
+    {"get", server_cmd_get},
+    {"set", server_cmd_set},
+#endif
+#if defined(CONFIG_LOG_RUNTIME_FILTERING)
+    {"log", server_cmd_log},
+#endif
+};
+
+static bool handle_server_command(int client_socket, const char* command_str,
+                                  const char* line)
+{
+    for (int i = 0; i < ARRAY_SIZE(server_cmds); i++)
+    {
+        if (strcmp(command_str, server_cmds[i].name) == 0)
+        {
+            server_cmds[i].fn(client_socket, line + strlen(command_str));
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief parses the start time of a scheduled command, "@<uptime_us>".
+ *
+ * @return NULL if valid, otherwise the reason it is rejected
+ */
+static const char* parse_execute_at(const char* str, int64_t* execute_at_us)
+{
+    char* end;
+
+    errno = 0;
+    long long at_us = strtoll(str, &end, 10);
+    if (end == str || errno == ERANGE || at_us < 0)
+        return "bad_time";
+    while (isspace((unsigned char)*end))
+        end++;
+    if (*end != '\0')
+        return "bad_time";
+    // The gait thread can't serve the lanes while it holds the command
+    if (at_us > cmd_timestamp_us() +
+                    (int64_t)CONFIG_SPIDER_CMD_MAX_LEAD_MS * USEC_PER_MSEC)
+        return "too_far";
+
+    *execute_at_us = at_us;
+    return NULL;
+}
+
+/**
+ * @brief parses and dispatches a single command line.
+ *
+ * @return false if the client asked to close the connection
+ */
+static bool handle_line(int client_socket, char* line)
 {
-    int rx_len = 0;
-    char rx_buf[RX_BUF_SIZE];
     char command_str[RX_BUF_SIZE];
     int times = 1;
 
+    parse_rx_buffer(line, strlen(line), command_str, &times);
+    if (command_str[0] == '\0')
+        return true;
+    if (strcmp(command_str, "close") ==
+        0) // break if the client request closing connection
+        return false;
+    if (handle_server_command(client_socket, command_str, line))
+        return true;
+
+    struct tcp_command cmd = {
+        .times = times, .id = next_cmd_id++, .rx_cycles = rx_cycles};
+    strcpy(cmd.command, command_str);
+
+    // Optional start time: "<command> [times] @<uptime_us>"
+    char* at = strchr(line, '@');
+    const char* reason = (at != NULL)
+                             ? parse_execute_at(at + 1, &cmd.execute_at_us)
+                             : NULL;
+    if (reason != NULL)
+    {
+        send_reply(client_socket, "ACK %u %s %s\n", cmd.id,
+                   ack_names[CMD_ACK_REJECTED], reason);
+        return true;
+    }
+
+    uint32_t merged_id = cmd.id;
+    enum cmd_ack ack = submit_command(client_socket, &cmd, &merged_id);
+    if (ack == CMD_ACK_ACCEPTED)
+        boot_mark(BOOT_STAGE_FIRST_COMMAND);
+    if (ack == CMD_ACK_COALESCED)
+        send_reply(client_socket, "ACK %u %s %u\n", cmd.id, ack_names[ack],
+                   merged_id);
+    else
+        send_reply(client_socket, "ACK %u %s\n", cmd.id, ack_names[ack]);
+    return true;
+}
+
+void handle_client(int client_socket, uint32_t generation)
+{
+    int rx_len = 0;
+    char rx_buf[RX_LINE_BUF_SIZE];
+    size_t rx_used = 0;
+    int64_t rx_last_ms = 0;
+    bool framed = false; // The client ends its commands with a newline
+    struct zsock_pollfd fds = {.fd = client_socket, .events = ZSOCK_POLLIN};
+
     while (true)
     {
-        memset(rx_buf, '\0', sizeof(rx_buf));
-        rx_len = zsock_recv(client_socket, rx_buf, sizeof(rx_buf), 0);
+        // The connection did not survive the link loss, don't wait for TCP
+        // to find out
+        if (conn_mgr_generation() != generation)
+        {
+            LOG_WRN("Network lost, dropping client");
+            break;
+        }
+        send_completions(client_socket);
+
+#if defined(CONFIG_SPIDER_SCHED_EDF)
+        // Less urgent than a tick or a keyframe, until it blocks again
+        sched_deadline_at(cmd_timestamp_us() +
+                          CONFIG_SPIDER_EDF_NET_DEADLINE_MS * USEC_PER_MSEC);
+#endif
+        // Wake up regularly to forward completions while the client is idle
+        int ret = zsock_poll(&fds, 1, CLIENT_POLL_PERIOD_MS);
+        if (ret < 0)
+        {
+            LOG_ERR("Error polling client socket (%d)", errno);
+            break;
+        }
+        if (ret == 0)
+        {
+            // Only a client that never sent a newline: the others wait for
+            // the rest of their line, however slow it is to come
+            if (rx_used > 0 && !framed &&
+                k_uptime_get() - rx_last_ms >= UNFRAMED_IDLE_MS)
+            {
+                rx_buf[rx_used] = '\0';
+                rx_used = 0;
+                if (!handle_line(client_socket, rx_buf))
+                    return;
+            }
+            continue;
+        }
+
+        rx_len = zsock_recv(client_socket, rx_buf + rx_used,
+                            sizeof(rx_buf) - 1 - rx_used, 0);
+        rx_timestamp_us = cmd_timestamp_us();
+        rx_cycles = k_cycle_get_32();
         if (rx_len < 0)
         {
             LOG_ERR("Error receiving client data");
             break;
         }
-
-        parse_rx_buffer(rx_buf, rx_len, command_str, &times);
-        struct tcp_command cmd = {.times = times};
-        strcpy(cmd.command, command_str);
-        if (strcmp(command_str, "close") ==
-            0) // break if the client request closing connection
+        if (rx_len == 0)
+        {
+            LOG_INF("Client disconnected");
             break;
-        if (k_msgq_put(&tcp_command_q, &cmd, K_NO_WAIT) < 0)
-            LOG_DBG("Message queue is full");
+        }
+        rx_used += rx_len;
+        rx_buf[rx_used] = '\0';
+        rx_last_ms = k_uptime_get();
+
+        // A single segment can carry several pipelined commands, and a
+        // command can be split across segments
+        char* line = rx_buf;
+        char* eol;
+        while ((eol = strchr(line, '\n')) != NULL)
+        {
+            framed = true;
+            *eol = '\0';
+            if (!handle_line(client_socket, line))
+                return;
+            line = eol + 1;
+        }
+        rx_used = strlen(line);
+        memmove(rx_buf, line, rx_used);
+
+        if (rx_used == sizeof(rx_buf) - 1)
+        {
+            LOG_WRN("Line too long, processing it truncated");
+            rx_used = 0;
+            if (!handle_line(client_socket, rx_buf))
+                return;
+        }
     }
 }
 
@@ -195,9 +831,14 @@ int create_listening_socket(void)
         return listening_sock;
     }
 
+    // The port is bound again after every link loss
+    int reuse = 1;
+    zsock_setsockopt(listening_sock, SOL_SOCKET, SO_REUSEADDR, &reuse,
+                     sizeof(reuse));
+
     struct sockaddr_in server_addr;
     server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(SERVER_PORT);
+    server_addr.sin_port = htons(tcp_server_port);
     server_addr.sin_addr.s_addr = INADDR_ANY;
 
     int ret = zsock_bind(listening_sock, (const struct sockaddr*)&server_addr,
@@ -205,6 +846,7 @@ int create_listening_socket(void)
     if (ret < 0)
     {
         LOG_ERR("Failed binding the socket (%d)", errno);
+        zsock_close(listening_sock);
         return ret;
     }
 
@@ -215,41 +857,43 @@ int create_listening_socket(void)
         zsock_close(listening_sock);
         return ret;
     }
-    LOG_INF("Listening on port %d...", SERVER_PORT);
+    LOG_INF("Listening on port %d...", tcp_server_port);
+    boot_mark(BOOT_STAGE_LISTENING);
 
     return listening_sock;
 }
 
 void tcp_server_thread(void)
 {
-    net_mgmt_init_event_callback(&wifi_cb, net_event_handler,
-                                 NET_EVENT_WIFI_CONNECT_RESULT |
-                                     NET_EVENT_WIFI_DISCONNECT_RESULT);
-    net_mgmt_init_event_callback(&ipv4_cb, net_event_handler,
-                                 NET_EVENT_IPV4_ADDR_ADD);
-
-    net_mgmt_add_event_callback(&wifi_cb);
-    net_mgmt_add_event_callback(&ipv4_cb);
+    struct zsock_pollfd fds = {.events = ZSOCK_POLLIN};
 
-    wifi_connect();
-    k_sem_take(&wifi_connected, K_FOREVER);
-    k_sem_take(&ipv4_obtained, K_FOREVER);
+    // Motion is already up on its own, only the server waits for the network
+    conn_mgr_start();
 
-    int listening_sock = create_listening_socket();
-    if (listening_sock < 0)
-    {
-        LOG_ERR("Couldn't start the tcp server");
-        return;
-    }
-
-    int client_sock = -1;
     while (true)
     {
-        if (client_sock < 0)
+        conn_mgr_wait_ready(K_FOREVER);
+        uint32_t generation = conn_mgr_generation();
+
+        int listening_sock = create_listening_socket();
+        if (listening_sock < 0)
         {
-            LOG_DBG("Waiting for client connection...");
-            client_sock = zsock_accept(listening_sock, NULL,
-                                       NULL); // block until a client connects
+            LOG_ERR("Couldn't start the tcp server");
+            k_sleep(K_MSEC(500));
+            continue;
+        }
+        fds.fd = listening_sock;
+
+        // Rebind whenever the link went down in between: the old socket may be
+        // bound to an address that no longer exists
+        LOG_DBG("Waiting for client connection...");
+        while (conn_mgr_generation() == generation)
+        {
+            int ret = zsock_poll(&fds, 1, CLIENT_POLL_PERIOD_MS * 10);
+            if (ret <= 0)
+                continue;
+
+            int client_sock = zsock_accept(listening_sock, NULL, NULL);
             if (client_sock < 0)
             {
                 LOG_ERR("Failed to accept client (%d)", errno);
@@ -257,14 +901,18 @@ void tcp_server_thread(void)
                 continue;
             }
             LOG_INF("Client accepted!");
-            handle_client(client_sock);
+            // Completions of a previous session are meaningless to this one
+            k_msgq_purge(&cmd_completion_q);
+            handle_client(client_sock, generation);
             zsock_close(client_sock);
-            client_sock = -1;
+            LOG_DBG("Waiting for client connection...");
         }
 
-        k_sleep(K_MSEC(500));
+        LOG_INF("Network changed, rebinding the server");
+        zsock_close(listening_sock);
     }
 }
 
 K_THREAD_DEFINE(tcp_server_thread_id, TCP_SERVER_STACK_SIZE, tcp_server_thread,
-                NULL, NULL, NULL, TCP_SERVER_THREAD_PRIORITY, K_USER, 0);
+                NULL, NULL, NULL, TCP_SERVER_THREAD_PRIORITY, K_USER,
+                SPIDER_THREAD_DELAY);
@@ -0,0 +1,286 @@
+#include "command_queue.h"
+#include <errno.h>
+#include <string.h>
+#include <zephyr/ztest.h>
+
+#define FLOOD_COMMANDS 200
+#define CONSUMER_STACK_SIZE 1024
+#define CONSUMER_PRIORITY 5
+
+static uint32_t next_id;
+static atomic_t consumed;
+static atomic_t consumer_stop;
+
+static struct tcp_command make_cmd(const char* name, int times)
+{
+    struct tcp_command cmd = {.times = times, .id = next_id++};
+
+    strcpy(cmd.command, name);
+    return cmd;
+}
+
+// Emulates the gait thread: one command at a time, each taking a while
+static void consumer(void* p1, void* p2, void* p3)
+{
+    struct tcp_command cmd;
+
+    while (!atomic_get(&consumer_stop))
+    {
+        if (cmd_queue_get(&cmd, K_MSEC(10)) == 0)
+        {
+            atomic_inc(&consumed);
+            k_msleep(2);
+        }
+    }
+}
+
+K_THREAD_STACK_DEFINE(consumer_stack, CONSUMER_STACK_SIZE);
+static struct k_thread consumer_thread;
+
+static void drain(void)
+{
+    for (int lane = 0; lane < CMD_LANE_COUNT; lane++)
+        cmd_queue_flush(lane, NULL);
+    cmd_queue_reset_stats();
+}
+
+static void command_queue_before(void* fixture)
+{
+    (void)fixture;
+    drain();
+    atomic_clear(&consumed);
+}
+
+ZTEST(command_queue_suite, test_urgent_lane_served_first)
+{
+    struct tcp_command sf = make_cmd("sf", 1);
+    struct tcp_command wave = make_cmd("wave", 1);
+    struct tcp_command stand = make_cmd("stand", 1);
+    struct tcp_command out;
+
+    zassert_equal(cmd_queue_put(&wave, CMD_LANE_LOW, K_NO_WAIT, NULL), 0);
+    zassert_equal(cmd_queue_put(&sf, CMD_LANE_NORMAL, K_NO_WAIT, NULL), 0);
+    zassert_equal(cmd_queue_put(&stand, CMD_LANE_URGENT, K_NO_WAIT, NULL), 0);
+
+    zassert_ok(cmd_queue_get(&out, K_NO_WAIT));
+    zassert_str_equal(out.command, "stand");
+    zassert_ok(cmd_queue_get(&out, K_NO_WAIT));
+    zassert_str_equal(out.command, "sf");
+    zassert_ok(cmd_queue_get(&out, K_NO_WAIT));
+    zassert_str_equal(out.command, "wave");
+    zassert_equal(cmd_queue_get(&out, K_NO_WAIT), -EAGAIN);
+}
+
+ZTEST(command_queue_suite, test_consecutive_gaits_coalesce)
+{
+    struct tcp_command first = make_cmd("sf", 2);
+    struct tcp_command second = make_cmd("sf", 3);
+    struct tcp_command other = make_cmd("sb", 1);
+    struct tcp_command third = make_cmd("sf", 1);
+    struct tcp_command out;
+    uint32_t merged_id = 0;
+
+    zassert_equal(cmd_queue_put(&first, CMD_LANE_NORMAL, K_NO_WAIT, NULL), 0);
+    zassert_equal(
+        cmd_queue_put(&second, CMD_LANE_NORMAL, K_NO_WAIT, &merged_id), 1);
+    zassert_equal(merged_id, first.id);
+
+    // Only the last pending command can absorb a new one
+    zassert_equal(cmd_queue_put(&other, CMD_LANE_NORMAL, K_NO_WAIT, NULL), 0);
+    zassert_equal(cmd_queue_put(&third, CMD_LANE_NORMAL, K_NO_WAIT, NULL), 0);
+
+    zassert_ok(cmd_queue_get(&out, K_NO_WAIT));
+    zassert_equal(out.id, first.id);
+    zassert_equal(out.times, 5);
+}
+
+ZTEST(command_queue_suite, test_coalesce_respects_max_times)
+{
+    struct tcp_command big =
+        make_cmd("tl", CONFIG_SPIDER_CMD_COALESCE_MAX_TIMES);
+    struct tcp_command more = make_cmd("tl", 1);
+
+    zassert_equal(cmd_queue_put(&big, CMD_LANE_NORMAL, K_NO_WAIT, NULL), 0);
+    zassert_equal(cmd_queue_put(&more, CMD_LANE_NORMAL, K_NO_WAIT, NULL), 0);
+}
+
+ZTEST(command_queue_suite, test_urgent_commands_never_coalesce)
+{
+    struct tcp_command sit = make_cmd("sit", 1);
+    struct tcp_command again = make_cmd("sit", 1);
+
+    zassert_equal(cmd_queue_put(&sit, CMD_LANE_URGENT, K_NO_WAIT, NULL), 0);
+    zassert_equal(cmd_queue_put(&again, CMD_LANE_URGENT, K_NO_WAIT, NULL), 0);
+}
+
+/**
+ * @brief The commands flushed by a stop count as cancelled, not dropped.
+ */
+ZTEST(command_queue_suite, test_flush_counts_cancelled)
+{
+    struct tcp_command sf = make_cmd("sf", 1);
+    struct tcp_command wave = make_cmd("wave", 1);
+    struct cmd_queue_stats stats;
+
+    zassert_equal(cmd_queue_put(&sf, CMD_LANE_NORMAL, K_NO_WAIT, NULL), 0);
+    zassert_equal(cmd_queue_put(&wave, CMD_LANE_LOW, K_NO_WAIT, NULL), 0);
+    cmd_queue_flush(CMD_LANE_NORMAL, NULL);
+    cmd_queue_flush(CMD_LANE_LOW, NULL);
+
+    cmd_queue_get_stats(&stats);
+    zassert_equal(stats.cancelled, 2);
+    zassert_equal(stats.dropped, 0);
+}
+
+/**
+ * @brief A producer held back by a full lane retries without the command
+ * counting as dropped, until it gives up on it.
+ */
+ZTEST(command_queue_suite, test_dropped_once_refused)
+{
+    static const char* const names[] = {"sf", "sb"};
+    struct tcp_command extra = make_cmd("tl", 1);
+    struct cmd_queue_stats stats;
+
+    for (int i = 0; i < CONFIG_SPIDER_CMD_NORMAL_DEPTH; i++)
+    {
+        struct tcp_command cmd = make_cmd(names[i % ARRAY_SIZE(names)], 1);
+
+        zassert_equal(cmd_queue_put(&cmd, CMD_LANE_NORMAL, K_NO_WAIT, NULL),
+                      0);
+    }
+    for (int retry = 0; retry < 3; retry++)
+        zassert_equal(
+            cmd_queue_put(&extra, CMD_LANE_NORMAL, K_MSEC(10), NULL),
+            -EAGAIN);
+
+    cmd_queue_get_stats(&stats);
+    zassert_equal(stats.dropped, 0);
+    cmd_queue_count_dropped();
+    cmd_queue_get_stats(&stats);
+    zassert_equal(stats.dropped, 1);
+}
+
+/**
+ * @brief Floods the queue the way a burst of clients would, without anyone
+ * consuming, and reports what happened to the commands.
+ */
+ZTEST(command_queue_suite, test_flood_without_consumer)
+{
+    static const char* const names[] = {"sf", "sb", "tl", "tr"};
+    struct cmd_queue_stats stats;
+
+    for (int i = 0; i < FLOOD_COMMANDS; i++)
+    {
+        // Runs of the same gait so that coalescing has something to merge
+        struct tcp_command cmd =
+            make_cmd(names[(i / 3) % ARRAY_SIZE(names)], 1);
+        if (cmd_queue_put(&cmd, CMD_LANE_NORMAL, K_NO_WAIT, NULL) < 0)
+            cmd_queue_count_dropped();
+    }
+
+    cmd_queue_get_stats(&stats);
+    printk("FLOOD no-consumer: sent=%d queued=%u coalesced=%u dropped=%u\n",
+           FLOOD_COMMANDS, stats.queued, stats.coalesced, stats.dropped);
+
+    zassert_equal(stats.queued + stats.coalesced + stats.dropped,
+                  FLOOD_COMMANDS);
+    zassert_equal(stats.queued, CONFIG_SPIDER_CMD_NORMAL_DEPTH);
+    zassert_equal(stats.high_water[CMD_LANE_NORMAL],
+                  CONFIG_SPIDER_CMD_NORMAL_DEPTH);
+    zassert_true(stats.coalesced > 0);
+}
+
+/**
+ * @brief Same flood, but the producer is held back while the lane is full
+ * and a consumer drains it: nothing may be lost.
+ */
+ZTEST(command_queue_suite, test_flood_with_backpressure)
+{
+    static const char* const names[] = {"sf", "sb", "shake", "stand"};
+    static const enum cmd_lane name_lanes[] = {CMD_LANE_NORMAL, CMD_LANE_NORMAL,
+                                               CMD_LANE_LOW, CMD_LANE_URGENT};
+    struct cmd_queue_stats stats;
+
+    atomic_clear(&consumer_stop);
+    k_tid_t tid = k_thread_create(
+        &consumer_thread, consumer_stack, K_THREAD_STACK_SIZEOF(consumer_stack),
+        consumer, NULL, NULL, NULL, CONSUMER_PRIORITY, 0, K_NO_WAIT);
+
+    int64_t start = k_uptime_get();
+    for (int i = 0; i < FLOOD_COMMANDS; i++)
+    {
+        int idx = i % ARRAY_SIZE(names);
+        struct tcp_command cmd = make_cmd(names[idx], 1);
+
+        zassert_true(cmd_queue_put(&cmd, name_lanes[idx], K_FOREVER, NULL) >=
+                     0);
+    }
+
+    // Let the consumer catch up with what is still pending
+    do
+    {
+        k_msleep(10);
+        cmd_queue_get_stats(&stats);
+    } while (atomic_get(&consumed) < stats.queued &&
+             k_uptime_get() - start < 10 * MSEC_PER_SEC);
+    atomic_set(&consumer_stop, 1);
+    k_thread_join(tid, K_FOREVER);
+
+    cmd_queue_get_stats(&stats);
+    printk("FLOOD backpressure: sent=%d queued=%u coalesced=%u dropped=%u "
+           "consumed=%ld in %lld ms\n",
+           FLOOD_COMMANDS, stats.queued, stats.coalesced, stats.dropped,
+           atomic_get(&consumed), k_uptime_get() - start);
+    for (int lane = 0; lane < CMD_LANE_COUNT; lane++)
+        printk("  lane %d high water %u\n", lane, stats.high_water[lane]);
+
+    zassert_equal(stats.dropped, 0);
+    zassert_equal(stats.queued + stats.coalesced, FLOOD_COMMANDS);
+    zassert_equal(atomic_get(&consumed), stats.queued);
+}
+
+static void put_gait(struct k_work* work)
+{
+    struct tcp_command cmd = make_cmd("sf", 1);
+
+    cmd_queue_put(&cmd, CMD_LANE_NORMAL, K_NO_WAIT, NULL);
+}
+
+static void put_urgent(struct k_work* work)
+{
+    struct tcp_command cmd = make_cmd("stop", 1);
+
+    cmd_queue_put(&cmd, CMD_LANE_URGENT, K_NO_WAIT, NULL);
+}
+
+static K_WORK_DELAYABLE_DEFINE(gait_work, put_gait);
+static K_WORK_DELAYABLE_DEFINE(urgent_work, put_urgent);
+
+/**
+ * @brief A scheduled command waits for its start time, only an urgent
+ * command ends the wait early.
+ */
+ZTEST(command_queue_suite, test_wait_urgent)
+{
+    struct tcp_command out;
+
+    int64_t start = k_uptime_get();
+    zassert_equal(cmd_queue_wait_urgent(K_TIMEOUT_ABS_MS(start + 50)),
+                  -EAGAIN);
+    zassert_true(k_uptime_get() - start >= 50);
+
+    start = k_uptime_get();
+    k_work_schedule(&gait_work, K_MSEC(10));
+    k_work_schedule(&urgent_work, K_MSEC(50));
+    zassert_ok(cmd_queue_wait_urgent(K_TIMEOUT_ABS_MS(start + 1000)));
+    zassert_true(k_uptime_get() - start < 1000);
+
+    // Left in the queue
+    zassert_ok(cmd_queue_get(&out, K_NO_WAIT));
+    zassert_str_equal(out.command, "stop");
+    zassert_ok(cmd_queue_get(&out, K_NO_WAIT));
+    zassert_str_equal(out.command, "sf");
+}
+
+ZTEST_SUITE(command_queue_suite, NULL, NULL, command_queue_before, NULL, NULL);
@@ -0,0 +1,92 @@
+#include "robot_fixture.h"
+#include "robot_state.h"
+#include "servos_sim.h"
+#include "spider_robot.h"
+#include <string.h>
+
+static struct run* current;
+static frame_t last_frame;
+static atomic_t nb_frames;
+static void (*frame_cb)(void);
+K_SEM_DEFINE(frame_sem, 0, 1);
+
+/**
+ * @brief called by the simulated servos at the end of every motor tick, with
+ * g_state_mutex held.
+ */
+static void record_frame(const uint8_t angles[NB_LEGS][NB_JOINTS])
+{
+    struct run* run = current;
+
+    memcpy(last_frame, angles, sizeof(frame_t));
+    atomic_inc(&nb_frames);
+    if (run != NULL)
+    {
+        if (run->nb_frames < MAX_FRAMES)
+            memcpy(run->frames[run->nb_frames], angles, sizeof(frame_t));
+        run->nb_frames++;
+    }
+    if (frame_cb != NULL)
+        frame_cb();
+    k_sem_give(&frame_sem);
+}
+
+/**
+ * @brief boots the robot as main() does, recording the motor ticks.
+ *
+ * @param prepare called once the legs are in the boot stance, before the
+ * threads are released, may be NULL
+ */
+void fixture_setup(void (*prepare)(void))
+{
+    init_robot_state();
+    servo_sim_set_frame_hook(record_frame);
+    init_stance();
+    if (prepare != NULL)
+        prepare();
+    k_event_post(&robot_ready, ROBOT_READY);
+}
+
+/**
+ * @brief called on every motor tick as well, with g_state_mutex held.
+ */
+void fixture_on_frame(void (*on_frame)(void))
+{
+    frame_cb = on_frame;
+}
+
+/**
+ * @brief starts recording from the boot stance (or standing), right after a
+ * tick as the gait thread does once the previous command completed: the
+ * first frame recorded is the first step of what runs next.
+ */
+void fixture_start_run(struct run* run, bool standing)
+{
+    init_stance();
+    if (standing)
+        stand(1);
+
+    memset(run, 0, sizeof(*run));
+    k_sem_reset(&frame_sem);
+    k_sem_take(&frame_sem, K_FOREVER);
+    run->ik_calls = ik_call_count();
+    current = run;
+}
+
+void fixture_stop_run(void)
+{
+    struct run* run = current;
+
+    current = NULL;
+    run->ik_calls = ik_call_count() - run->ik_calls;
+}
+
+uint32_t fixture_frame_count(void)
+{
+    return atomic_get(&nb_frames);
+}
+
+void fixture_last_frame(frame_t frame)
+{
+    memcpy(frame, last_frame, sizeof(frame_t));
+}
@@ -0,0 +1,34 @@
+#ifndef ROBOT_FIXTURE_H
+#define ROBOT_FIXTURE_H
+
+#include "servos.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+// Longest gait recorded by the suites, with room to spare
+#define MAX_FRAMES 512
+
+typedef uint8_t frame_t[NB_LEGS * NB_JOINTS];
+
+/**
+ * @brief Servo angles written on each motor tick of a recorded run
+ */
+struct run
+{
+        frame_t frames[MAX_FRAMES];
+        uint32_t nb_frames; // may exceed MAX_FRAMES, the extra ones are lost
+        uint32_t ik_calls;
+};
+
+// Given on every motor tick
+extern struct k_sem frame_sem;
+
+void fixture_setup(void (*prepare)(void));
+void fixture_on_frame(void (*on_frame)(void));
+void fixture_start_run(struct run* run, bool standing);
+void fixture_stop_run(void);
+uint32_t fixture_frame_count(void);
+void fixture_last_frame(frame_t frame);
+
+#endif // !ROBOT_FIXTURE_H
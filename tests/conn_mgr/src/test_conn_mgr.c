@@ -0,0 +1,161 @@
+#include "conn_mgr.h"
+#include "spider_robot.h"
+#include <string.h>
+#include <zephyr/net/net_if.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/ztest.h>
+
+#define RECOVERY_TIMEOUT_MS 5000
+#define PROBE_PERIOD_MS 20
+#define LINK_LOSSES 3
+// Room for two attempts without an address and their backoff
+#define NO_ADDRESS_MS                                                          \
+    (2 * (CONFIG_SPIDER_CONN_ATTEMPT_TIMEOUT_MS +                              \
+          CONFIG_SPIDER_CONN_BACKOFF_MAX_MS))
+
+// The gait side is not part of this test: every motion command is rejected
+K_MSGQ_DEFINE(cmd_completion_q, sizeof(struct cmd_completion), 4, 4);
+
+const struct cmd_entry* find_command(const char* name)
+{
+    (void)name;
+    return NULL;
+}
+
+void motors_get_deadline_stats(struct deadline_stats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+bool motors_faulted(void) { return false; }
+
+void cancel_command(void) {}
+
+void motors_get_monitor_stats(struct tick_monitor_stats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+/**
+ * @brief connects to the server and checks that it answers a `stats` request,
+ * the way a client would after the robot came back.
+ */
+static bool server_answers(void)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_SPIDER_SERVER_PORT),
+    };
+    struct zsock_timeval timeout = {.tv_usec = 200 * USEC_PER_MSEC};
+    char reply[64] = {0};
+    bool ok = false;
+
+    net_addr_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    int sock = zsock_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0)
+        return false;
+    zsock_setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    if (zsock_connect(sock, (struct sockaddr*)&addr, sizeof(addr)) == 0 &&
+        zsock_send(sock, "stats\n", 6, 0) == 6 &&
+        zsock_recv(sock, reply, sizeof(reply) - 1, 0) > 0)
+        ok = (strncmp(reply, "STATS", 5) == 0);
+
+    zsock_close(sock);
+    return ok;
+}
+
+/**
+ * @brief waits until a client is served again.
+ *
+ * @return the elapsed time in ms, or -1 on timeout
+ */
+static int64_t wait_server(void)
+{
+    int64_t start = k_uptime_get();
+
+    while (k_uptime_get() - start < RECOVERY_TIMEOUT_MS)
+    {
+        if (server_answers())
+            return k_uptime_get() - start;
+        k_msleep(PROBE_PERIOD_MS);
+    }
+    return -1;
+}
+
+static void* conn_mgr_setup(void)
+{
+    zassert_ok(conn_mgr_wait_ready(K_MSEC(RECOVERY_TIMEOUT_MS)));
+    zassert_true(wait_server() >= 0, "server never came up");
+    return NULL;
+}
+
+ZTEST(conn_mgr_suite, test_backoff_grows_up_to_max)
+{
+    zassert_equal(conn_mgr_backoff_ms(0), CONFIG_SPIDER_CONN_BACKOFF_MIN_MS);
+    zassert_equal(conn_mgr_backoff_ms(1),
+                  2 * CONFIG_SPIDER_CONN_BACKOFF_MIN_MS);
+    zassert_equal(conn_mgr_backoff_ms(100), CONFIG_SPIDER_CONN_BACKOFF_MAX_MS);
+
+    for (uint32_t attempt = 1; attempt < 10; attempt++)
+        zassert_true(conn_mgr_backoff_ms(attempt) >=
+                     conn_mgr_backoff_ms(attempt - 1));
+}
+
+/**
+ * @brief takes the link down several times without restarting anything and
+ * reports how long the server took to serve a client again.
+ */
+ZTEST(conn_mgr_suite, test_server_recovers_after_link_loss)
+{
+    struct net_if* iface = net_if_get_default();
+    struct conn_mgr_stats stats;
+    uint32_t generation = conn_mgr_generation();
+
+    for (int i = 0; i < LINK_LOSSES; i++)
+    {
+        zassert_ok(net_if_down(iface));
+        int64_t recovery_ms = wait_server();
+        zassert_true(recovery_ms >= 0, "server did not recover");
+        zassert_true(conn_mgr_is_ready());
+
+        conn_mgr_get_stats(&stats);
+        printk("RECOVERY loss=%d client_ms=%lld link_us=%lld\n", i + 1,
+               recovery_ms, stats.last_recovery_us);
+        // The link was brought back after the first backoff step
+        zassert_true(stats.last_recovery_us >=
+                     CONFIG_SPIDER_CONN_BACKOFF_MIN_MS * USEC_PER_MSEC);
+    }
+
+    conn_mgr_get_stats(&stats);
+    zassert_equal(conn_mgr_generation(), generation + LINK_LOSSES);
+    zassert_equal(stats.link_losses, LINK_LOSSES);
+    zassert_true(stats.max_recovery_us >= stats.last_recovery_us);
+}
+
+/**
+ * @brief the link comes back without an address: the attempts time out and
+ * drop it, until the address is back.
+ */
+ZTEST(conn_mgr_suite, test_no_address_retries)
+{
+    struct net_if* iface = net_if_get_default();
+    struct conn_mgr_stats before, after;
+    struct in_addr addr;
+
+    net_addr_pton(AF_INET, "127.0.0.1", &addr);
+    conn_mgr_get_stats(&before);
+    zassert_true(net_if_ipv4_addr_rm(iface, &addr));
+    zassert_ok(net_if_down(iface));
+
+    k_msleep(NO_ADDRESS_MS);
+    zassert_false(conn_mgr_is_ready());
+    conn_mgr_get_stats(&after);
+    zassert_true(after.failures > before.failures, "attempt never timed out");
+    zassert_true(after.attempts > before.attempts + 1, "link not requested");
+
+    zassert_not_null(net_if_ipv4_addr_add(iface, &addr, NET_ADDR_MANUAL, 0));
+    zassert_true(wait_server() >= 0, "server did not recover");
+}
+
+ZTEST_SUITE(conn_mgr_suite, NULL, conn_mgr_setup, NULL, NULL, NULL);
@@ -0,0 +1,164 @@
+#include "gait_asset.h"
+#include "robot_fixture.h"
+#include "robot_state.h"
+#include "spider_robot.h"
+#include <string.h>
+#include <zephyr/ztest.h>
+
+// Encoded by tools/gait_asset.py at build time
+static const uint8_t asset_sf[] = {
+#include "sf.inc"
+};
+static const uint8_t asset_unreachable[] = {
+#include "unreachable.inc"
+};
+
+static struct run live, played;
+
+struct listing
+{
+        int count;
+        struct gait_asset_info last;
+};
+
+static void count_gait(const struct gait_asset_info* info, void* arg)
+{
+    struct listing* listing = arg;
+
+    listing->count++;
+    listing->last = *info;
+}
+
+static int list(struct listing* listing)
+{
+    memset(listing, 0, sizeof(*listing));
+    return gait_asset_foreach(count_gait, listing);
+}
+
+ZTEST(gait_asset_suite, test_store_list)
+{
+    struct gait_asset_info info;
+    struct listing listing;
+
+    int empty = list(&listing);
+    zassert_equal(listing.count, 0);
+    zassert_ok(gait_asset_store(asset_sf, sizeof(asset_sf), &info));
+    zassert_str_equal(info.name, "sf");
+    zassert_equal(info.size, sizeof(asset_sf));
+    zassert_equal(info.keyframes, 14);
+
+    int left = list(&listing);
+    printk("ASSET sf: %u bytes, %u keyframes, %d bytes left\n", info.size,
+           info.keyframes, left);
+    zassert_equal(listing.count, 1);
+    zassert_str_equal(listing.last.name, "sf");
+    zassert_true(left <= empty - (int)sizeof(asset_sf));
+}
+
+ZTEST(gait_asset_suite, test_reject)
+{
+    static uint8_t corrupt[sizeof(asset_sf)];
+    struct gait_asset_info info;
+    struct listing listing;
+
+    memcpy(corrupt, asset_sf, sizeof(corrupt));
+    corrupt[sizeof(corrupt) - 1] ^= 0x01;
+    zassert_equal(gait_asset_store(corrupt, sizeof(corrupt), &info), -EBADMSG);
+    zassert_equal(gait_asset_store(asset_sf, sizeof(asset_sf) - 1, &info),
+                  -EBADMSG);
+    zassert_equal(gait_asset_store(asset_unreachable, sizeof(asset_unreachable),
+                                   &info),
+                  -EDOM);
+
+    list(&listing);
+    zassert_equal(listing.count, 0);
+    zassert_is_null(gait_asset_command("g.far"));
+}
+
+ZTEST(gait_asset_suite, test_replace)
+{
+    struct gait_asset_info info;
+    struct listing listing;
+
+    zassert_ok(gait_asset_store(asset_sf, sizeof(asset_sf), &info));
+    int left = list(&listing);
+    zassert_ok(gait_asset_store(asset_sf, sizeof(asset_sf), &info));
+
+    zassert_true(list(&listing) < left);
+    zassert_equal(listing.count, 1);
+}
+
+ZTEST(gait_asset_suite, test_upload)
+{
+    struct gait_asset_info info;
+    size_t sent = 0;
+    int remaining;
+
+    zassert_ok(gait_asset_upload_start(sizeof(asset_sf)));
+    do
+    {
+        size_t len = MIN(48, sizeof(asset_sf) - sent);
+
+        remaining = gait_asset_upload_append(asset_sf + sent, len);
+        sent += len;
+        zassert_equal(remaining, sizeof(asset_sf) - sent);
+    } while (remaining > 0);
+    zassert_ok(gait_asset_upload_commit(&info));
+    zassert_str_equal(info.name, "sf");
+
+    // Nothing left to commit, more data than announced
+    zassert_equal(gait_asset_upload_commit(&info), -EINVAL);
+    zassert_ok(gait_asset_upload_start(sizeof(asset_sf)));
+    zassert_equal(gait_asset_upload_append(asset_sf, sizeof(asset_sf) + 1),
+                  -EINVAL);
+    zassert_equal(
+        gait_asset_upload_start(CONFIG_SPIDER_GAIT_ASSET_MAX_SIZE + 1), -EFBIG);
+}
+
+/**
+ * @brief the asset holds both branches of step_forward(): one repetition is
+ * two of its steps, and must move the servos exactly as they do.
+ */
+ZTEST(gait_asset_suite, test_playback)
+{
+    struct gait_asset_info info;
+
+    zassert_ok(gait_asset_store(asset_sf, sizeof(asset_sf), &info));
+    zassert_str_equal(gait_asset_command("g.sf"), "sf");
+    zassert_is_null(gait_asset_command("g.sb"));
+    zassert_is_null(gait_asset_command("sf"));
+
+    fixture_start_run(&live, true);
+    step_forward(4);
+    fixture_stop_run();
+
+    fixture_start_run(&played, true);
+    zassert_ok(gait_asset_run("sf", 2));
+    fixture_stop_run();
+
+    printk("ASSET g.sf 2: %u ticks, sf 4: %u ticks\n", played.nb_frames,
+           live.nb_frames);
+    zassert_true(live.nb_frames <= MAX_FRAMES);
+    zassert_equal(played.nb_frames, live.nb_frames);
+    for (uint32_t i = 0; i < live.nb_frames; i++)
+        zassert_mem_equal(played.frames[i], live.frames[i], sizeof(frame_t),
+                          "frame %u differs", i);
+
+    zassert_equal(gait_asset_run("sb", 1), -ENOENT);
+}
+
+static void* gait_asset_setup(void)
+{
+    fixture_setup(NULL);
+    return NULL;
+}
+
+static void gait_asset_before(void* fixture)
+{
+    (void)fixture;
+
+    zassert_ok(gait_asset_erase());
+}
+
+ZTEST_SUITE(gait_asset_suite, NULL, gait_asset_setup, gait_asset_before, NULL,
+            NULL);
@@ -0,0 +1,93 @@
+#include "gait_cache.h"
+#include "robot_fixture.h"
+#include "robot_state.h"
+#include "spider_robot.h"
+#include <string.h>
+#include <zephyr/ztest.h>
+
+// Enough for both poses of each walking gait
+#define STEPS 3
+
+static struct run live, cached;
+
+/**
+ * @brief runs the gait from standing and records one frame per motor tick
+ * until it returns.
+ */
+static void run_gait(void (*gait)(unsigned int), bool use_cache,
+                     struct run* run)
+{
+    gait_cache_enable(use_cache);
+    fixture_start_run(run, true);
+    gait_cache_run(gait, STEPS);
+    fixture_stop_run();
+}
+
+static void check_playback(const char* name, void (*gait)(unsigned int))
+{
+    struct gait_cache_stats before, after;
+
+    run_gait(gait, false, &live);
+    gait_cache_get_stats(&before);
+    run_gait(gait, true, &cached);
+    gait_cache_get_stats(&after);
+
+    printk("CACHE %s: %u ticks, %u IK calls live, %u cached\n", name,
+           live.nb_frames, live.ik_calls, cached.ik_calls);
+    zassert_true(live.nb_frames <= MAX_FRAMES, "%s never completed", name);
+    zassert_equal(after.plays - before.plays, STEPS);
+    zassert_equal(after.misses, before.misses);
+    zassert_equal(cached.ik_calls, 0);
+    zassert_equal(cached.nb_frames, live.nb_frames,
+                  "%s played %u ticks instead of %u", name, cached.nb_frames,
+                  live.nb_frames);
+    for (uint32_t i = 0; i < live.nb_frames; i++)
+        zassert_mem_equal(cached.frames[i], live.frames[i], sizeof(frame_t),
+                          "%s frame %u differs", name, i);
+}
+
+ZTEST(gait_cache_suite, test_compiled)
+{
+    struct gait_cache_stats stats;
+
+    gait_cache_get_stats(&stats);
+    printk("CACHE %u steps, %u frames, %u bytes, compiled in %u us\n",
+           stats.clips, stats.frames, stats.bytes, stats.compile_us);
+    // Both poses of the 4 walking gaits
+    zassert_equal(stats.clips, 8);
+    zassert_true(stats.frames > 0 &&
+                 stats.frames <= CONFIG_SPIDER_GAIT_CACHE_FRAMES);
+}
+
+ZTEST(gait_cache_suite, test_other_gaits_live)
+{
+    struct gait_cache_stats before, after;
+
+    gait_cache_get_stats(&before);
+    init_stance();
+    gait_cache_run(stand, 1);
+    gait_cache_run(hand_wave, 1);
+    gait_cache_get_stats(&after);
+
+    zassert_equal(after.plays, before.plays);
+    zassert_equal(after.misses, before.misses);
+}
+
+#define CACHE_TEST(name, gait)                                                 \
+    ZTEST(gait_cache_suite, test_##name)                                       \
+    {                                                                          \
+        check_playback(#name, gait);                                           \
+    }
+
+CACHE_TEST(sf, step_forward)
+CACHE_TEST(sb, step_back)
+CACHE_TEST(tl, turn_left)
+CACHE_TEST(tr, turn_right)
+
+static void* gait_cache_setup(void)
+{
+    fixture_setup(gait_cache_compile);
+    return NULL;
+}
+
+ZTEST_SUITE(gait_cache_suite, NULL, gait_cache_setup, NULL, NULL, NULL);
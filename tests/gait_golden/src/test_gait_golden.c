@@ -0,0 +1,116 @@
+#include "robot_fixture.h"
+#include "robot_state.h"
+#include "spider_robot.h"
+#include <stdlib.h>
+#include <zephyr/ztest.h>
+
+// Servo rounding may move by one degree when the kinematics are reworked.
+// Interpolated in joint space, the posture moves leave the straight path by
+// up to two.
+#define ANGLE_TOLERANCE (IS_ENABLED(CONFIG_SPIDER_JOINT_INTERP) ? 2 : 1)
+#define TICK_TOLERANCE 1
+
+// Recorded with CONFIG_GAIT_GOLDEN_RECORD=y, see README
+static const frame_t golden_stand[] = {
+#include "../golden/stand.inc"
+};
+static const frame_t golden_sit[] = {
+#include "../golden/sit.inc"
+};
+static const frame_t golden_sf[] = {
+#include "../golden/sf.inc"
+};
+static const frame_t golden_sb[] = {
+#include "../golden/sb.inc"
+};
+static const frame_t golden_tl[] = {
+#include "../golden/tl.inc"
+};
+static const frame_t golden_tr[] = {
+#include "../golden/tr.inc"
+};
+static const frame_t golden_shake[] = {
+#include "../golden/shake.inc"
+};
+static const frame_t golden_wave[] = {
+#include "../golden/wave.inc"
+};
+
+static struct run recorded;
+
+/**
+ * @brief runs one command from the boot stance (or standing) and records one
+ * frame per motor tick until it returns.
+ */
+static void run_gait(void (*gait)(unsigned int), bool standing)
+{
+    fixture_start_run(&recorded, standing);
+    gait(1);
+    fixture_stop_run();
+}
+
+static void check_trajectory(const char* name, const frame_t* golden,
+                             uint32_t nb_golden)
+{
+    const frame_t* frames = recorded.frames;
+    uint32_t nb_frames = recorded.nb_frames;
+
+    printk("GAIT %s: %u ticks (golden %u), %u IK calls\n", name, nb_frames,
+           nb_golden, recorded.ik_calls);
+
+    if (IS_ENABLED(CONFIG_GAIT_GOLDEN_RECORD))
+    {
+        for (uint32_t i = 0; i < MIN(nb_frames, MAX_FRAMES); i++)
+        {
+            printk("GOLDEN %s {", name);
+            for (int j = 0; j < NB_LEGS * NB_JOINTS; j++)
+                printk("%s%u", j ? ", " : "", frames[i][j]);
+            printk("},\n");
+        }
+        ztest_test_skip();
+    }
+
+    zassert_true(nb_frames <= MAX_FRAMES, "%s never completed", name);
+    zassert_within(nb_frames, nb_golden, TICK_TOLERANCE,
+                   "%s took %u ticks instead of %u", name, nb_frames,
+                   nb_golden);
+
+    // Frames are compared in step, then the final poses
+    uint32_t common = MIN(nb_frames, nb_golden);
+    for (uint32_t i = 0; i <= common; i++)
+    {
+        const uint8_t* got = frames[MIN(i, nb_frames - 1)];
+        const uint8_t* want = golden[MIN(i, nb_golden - 1)];
+
+        for (int j = 0; j < NB_LEGS * NB_JOINTS; j++)
+        {
+            zassert_true(abs(got[j] - want[j]) <= ANGLE_TOLERANCE,
+                         "%s frame %u leg %d joint %d: %u instead of %u", name,
+                         i, j / NB_JOINTS, j % NB_JOINTS, got[j], want[j]);
+        }
+    }
+}
+
+#define GOLDEN_TEST(name, gait, standing)                                      \
+    ZTEST(gait_golden_suite, test_##name)                                      \
+    {                                                                          \
+        run_gait(gait, standing);                                              \
+        check_trajectory(#name, golden_##name, ARRAY_SIZE(golden_##name));    \
+    }
+
+GOLDEN_TEST(stand, stand, false)
+GOLDEN_TEST(sit, sit, true)
+GOLDEN_TEST(sf, step_forward, true)
+GOLDEN_TEST(sb, step_back, true)
+GOLDEN_TEST(tl, turn_left, true)
+GOLDEN_TEST(tr, turn_right, true)
+GOLDEN_TEST(shake, hand_shake, true)
+GOLDEN_TEST(wave, hand_wave, true)
+
+static void* gait_golden_setup(void)
+{
+    fixture_setup(NULL);
+    return NULL;
+}
+
+ZTEST_SUITE(gait_golden_suite, NULL, gait_golden_setup, NULL, NULL, NULL);
@@ -0,0 +1,16 @@
+/*======================================================================
+ * File:    bench_clock_bottom.c
+ * Date:    2026-10-19
+ * Purpose: Host side of the benchmark clock on native_sim. Runs in the native
+ *simulator runner context with the host C library.
+ *====================================================================*/
+#include "bench_clock_bottom.h"
+#include <time.h>
+
+uint64_t bench_clock_bottom_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
@@ -0,0 +1,12 @@
+#ifndef BENCH_CLOCK_BOTTOM_H
+#define BENCH_CLOCK_BOTTOM_H
+
+#include <stdint.h>
+
+/*
+ * Host monotonic clock, built into the native simulator runner where the host
+ * C library is available.
+ */
+uint64_t bench_clock_bottom_ns(void);
+
+#endif // !BENCH_CLOCK_BOTTOM_H
@@ -0,0 +1,30 @@
+#ifndef IK_BENCH_BASELINE_H
+#define IK_BENCH_BASELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Reference results in ns per operation x100, per board, read from
+ * CONFIG_IK_BENCH_BASELINE_FILE: the BASELINE lines printed with
+ * CONFIG_IK_BENCH_RECORD=y. qemu_x86 counts instructions, its baseline holds
+ * on any machine; host timings only compare on the machine they were recorded
+ * on. A result without an entry fails.
+ */
+struct bench_baseline
+{
+        const char* board;
+        const char* bench;
+        uint32_t ns_x100;
+};
+
+static const struct bench_baseline bench_baselines[] = {
+#if defined(IK_BENCH_BASELINE_FILE)
+#define BASELINE
+#include IK_BENCH_BASELINE_FILE
+#undef BASELINE
+#endif
+    {NULL, NULL, 0},
+};
+
+#endif // !IK_BENCH_BASELINE_H
@@ -0,0 +1,283 @@
+#include "ik_bench_baseline.h"
+#include "reach_map.h"
+#include "robot_state.h"
+#include "servos.h"
+#include "spider_robot.h"
+#include "state_lock.h"
+#include <string.h>
+#include <zephyr/ztest.h>
+
+#if defined(CONFIG_BOARD_NATIVE_SIM)
+#include "bench_clock_bottom.h"
+#endif
+
+#define MAX_POSITIONS 64
+
+struct position
+{
+        double x, y, z;
+        double alpha, beta, gamma;
+};
+
+struct stamp
+{
+        uint64_t ns;
+        uint32_t cycles;
+};
+
+struct bench_result
+{
+        uint32_t ops;
+        uint64_t ns;
+        uint64_t cycles;
+};
+
+static struct position positions[MAX_POSITIONS];
+static int nb_positions;
+static volatile double sink;
+
+static struct stamp stamp_now(void)
+{
+    struct stamp now = {.cycles = k_cycle_get_32()};
+
+#if defined(CONFIG_BOARD_NATIVE_SIM)
+    now.ns = bench_clock_bottom_ns();
+#endif
+    return now;
+}
+
+static void add_elapsed(struct bench_result* result, struct stamp start)
+{
+    struct stamp end = stamp_now();
+    uint32_t cycles = end.cycles - start.cycles;
+
+    result->cycles += cycles;
+    result->ns += IS_ENABLED(CONFIG_BOARD_NATIVE_SIM)
+                      ? end.ns - start.ns
+                      : k_cyc_to_ns_floor64(cycles);
+}
+
+/**
+ * @brief foot positions the gaits go through: the stance, step and turn
+ * sites at the standing, raised and boot heights. Unreachable ones are left
+ * out, set_site() refuses them.
+ */
+static void build_positions(void)
+{
+    const double xs[] = {g_derived.turn_x0,
+                         (g_derived.turn_x0 + g_config.x_default) / 2,
+                         g_config.x_default, g_derived.turn_x1};
+    const double ys[] = {g_config.y_start,
+                         g_config.y_start + g_config.y_step / 2,
+                         g_config.y_start + g_config.y_step, g_derived.turn_y0,
+                         g_config.y_start + 2 * g_config.y_step};
+    const double zs[] = {g_config.z_default, g_config.z_up, g_derived.z_boot};
+
+    nb_positions = 0;
+    for (int i = 0; i < ARRAY_SIZE(xs); i++)
+    {
+        for (int j = 0; j < ARRAY_SIZE(ys); j++)
+        {
+            for (int k = 0; k < ARRAY_SIZE(zs); k++)
+            {
+                struct position* p = &positions[nb_positions];
+
+                p->x = xs[i];
+                p->y = ys[j];
+                p->z = zs[k];
+                cartesian_to_polar(&p->alpha, &p->beta, &p->gamma, p->x, p->y,
+                                   p->z);
+                if (reach_map_reachable(p->x, p->y, p->z) &&
+                    nb_positions < MAX_POSITIONS - 1)
+                    nb_positions++;
+            }
+        }
+    }
+}
+
+static void bench_cartesian_to_polar(struct bench_result* result)
+{
+    double alpha, beta, gamma;
+    struct stamp start = stamp_now();
+
+    for (int it = 0; it < CONFIG_IK_BENCH_ITERATIONS; it++)
+    {
+        for (int i = 0; i < nb_positions; i++)
+        {
+            const struct position* p = &positions[i];
+
+            cartesian_to_polar(&alpha, &beta, &gamma, p->x, p->y, p->z);
+            sink = alpha + beta + gamma;
+        }
+    }
+    add_elapsed(result, start);
+    result->ops += CONFIG_IK_BENCH_ITERATIONS * nb_positions;
+}
+
+static void bench_polar_to_servo(struct bench_result* result)
+{
+    struct stamp start = stamp_now();
+
+    for (int it = 0; it < CONFIG_IK_BENCH_ITERATIONS; it++)
+    {
+        for (int i = 0; i < nb_positions; i++)
+        {
+            const struct position* p = &positions[i];
+
+            polar_to_servo(i % NB_LEGS, p->alpha, p->beta, p->gamma);
+        }
+    }
+    add_elapsed(result, start);
+    result->ops += CONFIG_IK_BENCH_ITERATIONS * nb_positions;
+}
+
+static void bench_set_site(struct bench_result* result)
+{
+    g_state.move_speed = g_config.leg_move_speed;
+
+    struct stamp start = stamp_now();
+    for (int it = 0; it < CONFIG_IK_BENCH_ITERATIONS; it++)
+    {
+        for (int i = 0; i < nb_positions; i++)
+        {
+            const struct position* p = &positions[i];
+
+            set_site(i % NB_LEGS, p->x, p->y, p->z);
+        }
+    }
+    add_elapsed(result, start);
+    result->ops += CONFIG_IK_BENCH_ITERATIONS * nb_positions;
+}
+
+/**
+ * @brief full motor ticks with the legs walking from one position to the
+ * next at the leg speed. Only the ticks are timed, not the new targets.
+ */
+static void bench_motors_tick(struct bench_result* result)
+{
+    int next[NB_LEGS];
+
+    g_state.move_speed = g_config.leg_move_speed;
+    for (int leg = 0; leg < NB_LEGS; leg++)
+    {
+        const struct position* p = &positions[leg % nb_positions];
+
+        g_state.site_now[leg][0] = g_state.site_expect[leg][0] = p->x;
+        g_state.site_now[leg][1] = g_state.site_expect[leg][1] = p->y;
+        g_state.site_now[leg][2] = g_state.site_expect[leg][2] = p->z;
+        next[leg] = leg;
+    }
+
+    for (int it = 0; it < CONFIG_IK_BENCH_ITERATIONS * nb_positions; it++)
+    {
+        for (int leg = 0; leg < NB_LEGS; leg++)
+        {
+            if (memcmp(g_state.site_now[leg], g_state.site_expect[leg],
+                       sizeof(g_state.site_now[leg])) != 0)
+                continue;
+
+            next[leg] = (next[leg] + 1) % nb_positions;
+            set_site(leg, positions[next[leg]].x, positions[next[leg]].y,
+                     positions[next[leg]].z);
+        }
+
+        struct stamp start = stamp_now();
+        motors_tick();
+        add_elapsed(result, start);
+        result->ops++;
+    }
+}
+
+static const struct bench_baseline* find_baseline(const char* name)
+{
+    for (const struct bench_baseline* b = bench_baselines; b->bench != NULL;
+         b++)
+    {
+        if (strcmp(b->board, CONFIG_BOARD) == 0 && strcmp(b->bench, name) == 0)
+            return b;
+    }
+    return NULL;
+}
+
+/**
+ * @brief keeps the fastest of the runs, reports it as a JSON line and checks
+ * it against the baseline of the board.
+ */
+static void run_bench(const char* name,
+                      void (*bench)(struct bench_result* result))
+{
+    struct bench_result best = {0};
+
+    state_lock(K_FOREVER);
+    for (int run = 0; run < CONFIG_IK_BENCH_RUNS; run++)
+    {
+        struct bench_result result = {0};
+
+        bench(&result);
+        if (run == 0 || result.ns * best.ops < best.ns * result.ops)
+            best = result;
+    }
+    state_unlock();
+
+    zassert_true(best.ops > 0);
+    uint32_t ns_x100 = (uint32_t)(best.ns * 100 / best.ops);
+
+    printk("BENCH {\"bench\": \"%s\", \"board\": \"%s\", \"ops\": %u, "
+           "\"ns_per_op\": %u.%02u, ",
+           name, CONFIG_BOARD, best.ops, ns_x100 / 100, ns_x100 % 100);
+    if (IS_ENABLED(CONFIG_BOARD_NATIVE_SIM))
+        printk("\"cycles_per_op\": null}\n");
+    else
+        printk("\"cycles_per_op\": %u}\n", (uint32_t)(best.cycles / best.ops));
+
+    if (IS_ENABLED(CONFIG_IK_BENCH_RECORD))
+    {
+        printk("BASELINE {\"%s\", \"%s\", %u},\n", CONFIG_BOARD, name,
+               ns_x100);
+        return;
+    }
+
+    const struct bench_baseline* baseline = find_baseline(name);
+    zassert_not_null(baseline,
+                     "%s: no baseline for %s in %s, record one with "
+                     "CONFIG_IK_BENCH_RECORD=y",
+                     name, CONFIG_BOARD, CONFIG_IK_BENCH_BASELINE_FILE);
+
+    uint32_t limit = (uint64_t)baseline->ns_x100 *
+                     (100 + CONFIG_IK_BENCH_TOLERANCE_PCT) / 100;
+    zassert_true(ns_x100 <= limit,
+                 "%s regressed: %u.%02u ns per op, baseline %u.%02u +%d%%",
+                 name, ns_x100 / 100, ns_x100 % 100, baseline->ns_x100 / 100,
+                 baseline->ns_x100 % 100, CONFIG_IK_BENCH_TOLERANCE_PCT);
+}
+
+ZTEST(ik_bench_suite, test_cartesian_to_polar)
+{
+    run_bench("cartesian_to_polar", bench_cartesian_to_polar);
+}
+
+ZTEST(ik_bench_suite, test_polar_to_servo)
+{
+    run_bench("polar_to_servo", bench_polar_to_servo);
+}
+
+ZTEST(ik_bench_suite, test_set_site)
+{
+    run_bench("set_site", bench_set_site);
+}
+
+ZTEST(ik_bench_suite, test_motors_tick)
+{
+    run_bench("motors_tick", bench_motors_tick);
+}
+
+static void* ik_bench_setup(void)
+{
+    init_robot_state();
+    build_positions();
+    printk("BENCH %d foot positions, %d iterations, best of %d runs\n",
+           nb_positions, CONFIG_IK_BENCH_ITERATIONS, CONFIG_IK_BENCH_RUNS);
+    return NULL;
+}
+
+ZTEST_SUITE(ik_bench_suite, NULL, ik_bench_setup, NULL, NULL, NULL);
@@ -1,24 +1,33 @@
-#include "gait.h"
+#include "reach_map.h"
 #include "robot_state.h"
+#include "servos.h"
+#include "spider_robot.h"
+#include <errno.h>
+#include <math.h>
+#include <string.h>
 #include <zephyr/ztest.h>
 
 // Define the tolerance for float comparisons
-const float TEST_TOLERANCE = 0.001f;
+const double TEST_TOLERANCE = 0.001;
 
 // This is a "test fixture setup" function. It runs once before the tests in
 // this suite. We use it to initialize the robot state, which cartesian_to_polar
 // depends on.
-static void kinematics_suite_setup(void) { init_robot_state(); }
+static void* kinematics_suite_setup(void)
+{
+    init_robot_state();
+    return NULL;
+}
 
 /**
  * @brief Test case using the values from our log analysis.
  */
 ZTEST(kinematics_suite, test_ik_calculation_from_log)
 {
-    volatile float alpha, beta, gamma;
-    volatile float x = 62.0f;
-    volatile float y = 50.0f;
-    volatile float z = -50.0f;
+    double alpha, beta, gamma;
+    double x = 62.0;
+    double y = 15.0;
+    double z = -50.0;
 
     // Run the function we want to test
     cartesian_to_polar(&alpha, &beta, &gamma, x, y, z);
@@ -32,9 +41,9 @@ ZTEST(kinematics_suite, test_ik_calculation_from_log)
     // --- ASSERTION ---
     // These are the "ground truth" values from the working Arduino.
     // I am using the ones you found with grep.
-    float expected_alpha = 28.9082f;
-    float expected_beta = 52.2906f;
-    float expected_gamma = 13.6005f;
+    double expected_alpha = 28.9082;
+    double expected_beta = 52.2906;
+    double expected_gamma = 13.6005;
 
     // zassert_within(actual, expected, tolerance, message)
     // This will check if the Zephyr calculation matches the Arduino's result.
@@ -43,5 +52,116 @@ ZTEST(kinematics_suite, test_ik_calculation_from_log)
     zassert_within(gamma, expected_gamma, TEST_TOLERANCE, "Gamma mismatch!");
 }
 
+ZTEST(kinematics_suite, test_gait_sites_reachable)
+{
+    zassert_true(reach_map_reachable(g_config.x_default, g_config.y_start,
+                                     g_config.z_default));
+    zassert_true(reach_map_reachable(g_config.x_default,
+                                     g_config.y_start + 2 * g_config.y_step,
+                                     g_config.z_up));
+    zassert_true(reach_map_reachable(g_derived.turn_x0, g_derived.turn_y0,
+                                     g_derived.z_boot));
+}
+
+ZTEST(kinematics_suite, test_unreachable_target_rejected)
+{
+    double expect[NB_JOINTS];
+
+    memcpy(expect, g_state.site_expect[0], sizeof(expect));
+    // Further than the stretched leg, and on the hip
+    zassert_equal(set_site(0, 200.0, 0.0, -50.0), -EDOM);
+    zassert_equal(set_site(0, g_config.length_c, 0.0, 0.0), -EDOM);
+    zassert_mem_equal(g_state.site_expect[0], expect, sizeof(expect));
+
+    zassert_ok(set_site(0, g_config.x_default, g_config.y_start,
+                        g_config.z_default));
+}
+
+ZTEST(kinematics_suite, test_unreachable_target_cancels_command)
+{
+    begin_command();
+    zassert_equal(set_site(0, 200.0, 0.0, -50.0), -EDOM);
+    zassert_true(command_cancelled());
+    // The keyframes left are not played either
+    zassert_equal(set_site(1, g_config.x_default, g_config.y_start,
+                           g_config.z_default),
+                  -ECANCELED);
+    zassert_true(end_command());
+
+    zassert_ok(set_site(1, g_config.x_default, g_config.y_start,
+                        g_config.z_default));
+}
+
+ZTEST(kinematics_suite, test_ik_out_of_reach_is_not_nan)
+{
+    double alpha, beta, gamma;
+
+    // Stretches towards the point instead
+    cartesian_to_polar(&alpha, &beta, &gamma, 200.0, 0.0, -50.0);
+    zassert_false(isnan(alpha) || isnan(beta) || isnan(gamma));
+    zassert_within(beta, 180.0, TEST_TOLERANCE);
+}
+
+ZTEST(kinematics_suite, test_fk_inverts_ik)
+{
+    double alpha, beta, gamma, x, y, z;
+
+    cartesian_to_polar(&alpha, &beta, &gamma, 62.0, 15.0, -50.0);
+    polar_to_cartesian(&x, &y, &z, alpha, beta, gamma);
+    zassert_within(x, 62.0, TEST_TOLERANCE);
+    zassert_within(y, 15.0, TEST_TOLERANCE);
+    zassert_within(z, -50.0, TEST_TOLERANCE);
+}
+
+ZTEST(kinematics_suite, test_state_snapshot)
+{
+    robot_state_t snapshot;
+
+    zassert_ok(set_site(1, g_config.x_default, g_config.y_start,
+                        g_config.z_up));
+    robot_state_snapshot(&snapshot);
+    zassert_mem_equal(&snapshot, &g_state, sizeof(snapshot));
+}
+
+/**
+ * @brief the build time constants match the formulas init_robot_state() used
+ * to evaluate at boot.
+ */
+ZTEST(kinematics_suite, test_generated_geometry)
+{
+    const double tolerance = 1e-9;
+    double val_2x_l = 2.0 * g_config.x_default + g_config.length_side;
+    double temp_a = sqrt(pow(val_2x_l, 2.0) + pow(g_config.y_step, 2.0));
+    double temp_b =
+        2.0 * (g_config.y_start + g_config.y_step) + g_config.length_side;
+    double temp_c = sqrt(
+        pow(val_2x_l, 2.0) +
+        pow(2.0 * g_config.y_start + g_config.y_step + g_config.length_side,
+            2.0));
+    double temp_alpha =
+        acos((pow(temp_a, 2.0) + pow(temp_b, 2.0) - pow(temp_c, 2.0)) /
+             (2.0 * temp_a * temp_b));
+    double turn_x1 = (temp_a - g_config.length_side) / 2.0;
+    double turn_y1 = g_config.y_start + g_config.y_step / 2.0;
+    double turn_x0 = turn_x1 - temp_b * cos(temp_alpha);
+    double turn_y0 = temp_b * sin(temp_alpha) - turn_y1 - g_config.length_side;
+
+    zassert_within(g_derived.z_boot, g_config.z_absolute, tolerance);
+    zassert_within(g_derived.temp_a, temp_a, tolerance);
+    zassert_within(g_derived.temp_b, temp_b, tolerance);
+    zassert_within(g_derived.temp_c, temp_c, tolerance);
+    zassert_within(g_derived.temp_alpha, temp_alpha, tolerance);
+    zassert_within(g_derived.turn_x0, turn_x0, tolerance);
+    zassert_within(g_derived.turn_y0, turn_y0, tolerance);
+    zassert_within(g_derived.turn_x1, turn_x1, tolerance);
+    zassert_within(g_derived.turn_y1, turn_y1, tolerance);
+
+    // Kconfig tenths of mm
+    zassert_within(g_config.length_a, CONFIG_SPIDER_GEOM_LENGTH_A / 10.0,
+                   tolerance);
+    zassert_within(g_config.y_step, CONFIG_SPIDER_GEOM_Y_STEP / 10.0,
+                   tolerance);
+}
+
 // This defines and registers the test suite, and links our setup function.
 ZTEST_SUITE(kinematics_suite, NULL, kinematics_suite_setup, NULL, NULL, NULL);
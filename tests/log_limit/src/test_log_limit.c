@@ -0,0 +1,72 @@
+#include "log_limit.h"
+#include <zephyr/ztest.h>
+
+LOG_MODULE_REGISTER(log_limit_test, CONFIG_SPIDER_LOG_LEVEL);
+
+// A motor tick failing on every period
+#define TICK_MS 20
+// Joints written on a tick, each failing with the PCA9685 gone
+#define TICK_ERRORS 12
+#define COST_TICKS 50
+
+ZTEST(log_limit_suite, test_first_reported)
+{
+    struct log_limit limit = {0};
+
+    zassert_equal(log_limit_hit(&limit), 1);
+    zassert_equal(log_limit_hit(&limit), 0);
+}
+
+ZTEST(log_limit_suite, test_counted_until_next_report)
+{
+    struct log_limit limit = {0};
+    uint32_t reported = 0, reports = 0, hits = 0;
+
+    // 1 report, then 1 per interval carrying the ticks in between
+    for (; hits < 3 * CONFIG_SPIDER_LOG_LIMIT_MS / TICK_MS; hits++)
+    {
+        uint32_t count = log_limit_hit(&limit);
+
+        if (count > 0)
+            reports++;
+        reported += count;
+        k_msleep(TICK_MS);
+    }
+    zassert_true(reports >= 3 && reports <= 4, "%u reports", reports);
+    zassert_equal(reported + limit.count, hits);
+}
+
+/**
+ * @brief CPU time of the logging on a tick where every PWM write fails, with
+ * a log call per error as before and with LOG_ERR_LIMITED(). Printed as
+ * `LOG_COST` for tools/log_footprint.py.
+ */
+ZTEST(log_limit_suite, test_faulted_tick_cost)
+{
+    uint64_t logged = 0, limited = 0;
+
+    for (int tick = 0; tick < COST_TICKS; tick++)
+    {
+        uint32_t start = k_cycle_get_32();
+
+        for (int joint = 0; joint < TICK_ERRORS; joint++)
+            LOG_ERR("Failed setting pwm for leg %d joint %d (%d)", joint / 3,
+                    joint % 3, -EIO);
+        logged += k_cycle_get_32() - start;
+
+        start = k_cycle_get_32();
+        for (int joint = 0; joint < TICK_ERRORS; joint++)
+            LOG_ERR_LIMITED("Failed setting pwm for leg %d joint %d (%d)",
+                            joint / 3, joint % 3, -EIO);
+        limited += k_cycle_get_32() - start;
+        k_msleep(TICK_MS);
+    }
+    uint32_t logged_ns = k_cyc_to_ns_floor64(logged / COST_TICKS);
+    uint32_t limited_ns = k_cyc_to_ns_floor64(limited / COST_TICKS);
+
+    printk("LOG_COST tick_logged_ns=%u tick_limited_ns=%u\n", logged_ns,
+           limited_ns);
+    zassert_true(limited < logged, "%u >= %u ns", limited_ns, logged_ns);
+}
+
+ZTEST_SUITE(log_limit_suite, NULL, NULL, NULL, NULL, NULL);
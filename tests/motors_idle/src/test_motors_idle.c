@@ -0,0 +1,81 @@
+#include "robot_fixture.h"
+#include "robot_state.h"
+#include "servos_sim.h"
+#include "spider_robot.h"
+#include <string.h>
+#include <zephyr/ztest.h>
+
+// Past the quiet time, whatever the tick it started on
+#define IDLE_WAIT_MS (CONFIG_SPIDER_IDLE_MS + 100)
+
+static void wait_idle(struct motors_idle_stats* stats)
+{
+    k_msleep(IDLE_WAIT_MS);
+    motors_get_idle_stats(stats);
+    zassert_true(stats->idle, "still ticking");
+}
+
+ZTEST(motors_idle_suite, test_ticks_stop)
+{
+    struct motors_idle_stats before, after;
+
+    motors_get_idle_stats(&before);
+    stand(1);
+    wait_idle(&after);
+    zassert_equal(after.entries, before.entries + 1);
+    zassert_true(servo_sim_relaxed);
+
+    // Nothing written while idle, the time is accounted
+    uint32_t frames = fixture_frame_count();
+    k_msleep(IDLE_WAIT_MS);
+    zassert_equal(fixture_frame_count(), frames);
+    motors_get_idle_stats(&after);
+    zassert_true(after.idle_us >= before.idle_us + IDLE_WAIT_MS * 1000ULL);
+    zassert_true(after.ticks_skipped > before.ticks_skipped);
+}
+
+ZTEST(motors_idle_suite, test_wake_restores_pose)
+{
+    struct motors_idle_stats stats;
+    frame_t held, woken;
+
+    stand(1);
+    wait_idle(&stats);
+    fixture_last_frame(held);
+
+    k_sem_reset(&frame_sem);
+    motors_wake();
+    zassert_ok(k_sem_take(&frame_sem, K_MSEC(100)));
+    zassert_false(servo_sim_relaxed);
+    fixture_last_frame(woken);
+    zassert_mem_equal(woken, held, sizeof(held));
+
+    motors_get_idle_stats(&stats);
+    zassert_false(stats.idle);
+    // Quiet again
+    wait_idle(&stats);
+}
+
+ZTEST(motors_idle_suite, test_gait_after_idle)
+{
+    struct motors_idle_stats stats;
+
+    stand(1);
+    wait_idle(&stats);
+
+    // Ticks again for the whole gait
+    uint32_t frames = fixture_frame_count();
+    step_forward(1);
+    motors_get_idle_stats(&stats);
+    zassert_false(stats.idle);
+    zassert_true(fixture_frame_count() > frames);
+    zassert_false(servo_sim_relaxed);
+}
+
+static void* motors_idle_setup(void)
+{
+    fixture_setup(NULL);
+    return NULL;
+}
+
+ZTEST_SUITE(motors_idle_suite, NULL, motors_idle_setup, NULL, NULL, NULL);
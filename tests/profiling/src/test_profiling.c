@@ -0,0 +1,105 @@
+#include "profiling.h"
+#include <zephyr/ztest.h>
+
+#define SAMPLES 1000
+
+static void profiling_before(void* fixture)
+{
+    (void)fixture;
+    prof_reset();
+}
+
+ZTEST(profiling_suite, test_empty_phase_reports_nothing)
+{
+    struct prof_summary summary;
+
+    prof_get(PROF_IK, &summary);
+    zassert_equal(summary.count, 0);
+    zassert_equal(summary.max_ns, 0);
+}
+
+ZTEST(profiling_suite, test_summary_of_samples)
+{
+    uint32_t fast = k_us_to_cyc_ceil32(100);
+    uint32_t slow = k_us_to_cyc_ceil32(5000);
+    struct prof_summary summary;
+
+    // 1% of outliers must not show in the 99th percentile
+    for (int i = 0; i < SAMPLES; i++)
+        prof_add(PROF_SERVO_WRITE, (i % 100 == 0) ? slow : fast);
+
+    prof_get(PROF_SERVO_WRITE, &summary);
+    zassert_equal(summary.count, SAMPLES);
+    zassert_equal(summary.min_ns, k_cyc_to_ns_floor32(fast));
+    zassert_equal(summary.max_ns, k_cyc_to_ns_floor32(slow));
+    zassert_equal(summary.mean_ns,
+                  k_cyc_to_ns_floor64(((uint64_t)fast * 99 + slow) / 100));
+    // Buckets are 25% wide
+    zassert_true(summary.p99_ns >= summary.min_ns);
+    zassert_true(summary.p99_ns <= summary.min_ns + summary.min_ns / 4 + 1);
+
+    // Phases are independent
+    prof_get(PROF_IK, &summary);
+    zassert_equal(summary.count, 0);
+}
+
+ZTEST(profiling_suite, test_p99_of_uniform_samples)
+{
+    struct prof_summary summary;
+
+    for (uint32_t i = 1; i <= SAMPLES; i++)
+        prof_add(PROF_TICK, i);
+
+    prof_get(PROF_TICK, &summary);
+    uint32_t expected = k_cyc_to_ns_floor32(SAMPLES * 99 / 100);
+    zassert_true(summary.p99_ns >= expected);
+    zassert_true(summary.p99_ns <= k_cyc_to_ns_floor32(SAMPLES));
+}
+
+ZTEST(profiling_suite, test_reset_clears_all_phases)
+{
+    struct prof_summary summary;
+
+    for (int phase = 0; phase < PROF_PHASE_COUNT; phase++)
+        prof_add(phase, 42);
+    prof_reset();
+
+    for (int phase = 0; phase < PROF_PHASE_COUNT; phase++)
+    {
+        prof_get(phase, &summary);
+        zassert_equal(summary.count, 0);
+    }
+}
+
+ZTEST(profiling_suite, test_command_latency_stages)
+{
+    struct prof_summary enqueue, total;
+    uint32_t rx = k_cycle_get_32();
+
+    k_busy_wait(1000);
+    uint32_t enqueued = k_cycle_get_32();
+
+    // Moves without a command being followed are ignored
+    prof_first_servo();
+    prof_cmd_dequeued(rx, enqueued);
+    prof_first_servo();
+    prof_first_site();
+    prof_first_site();
+    k_busy_wait(500);
+    prof_first_servo();
+    prof_first_servo();
+
+    for (int phase = PROF_LAT_ENQUEUE; phase <= PROF_LAT_TOTAL; phase++)
+    {
+        struct prof_summary summary;
+
+        prof_get(phase, &summary);
+        zassert_equal(summary.count, 1, "%s", prof_phase_name(phase));
+    }
+    prof_get(PROF_LAT_ENQUEUE, &enqueue);
+    prof_get(PROF_LAT_TOTAL, &total);
+    zassert_true(enqueue.max_ns >= 1000 * NSEC_PER_USEC);
+    zassert_true(total.max_ns >= enqueue.max_ns + 500 * NSEC_PER_USEC);
+}
+
+ZTEST_SUITE(profiling_suite, NULL, NULL, profiling_before, NULL, NULL);
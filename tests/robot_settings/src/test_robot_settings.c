@@ -0,0 +1,224 @@
+#include "gait_cache.h"
+#include "robot_fixture.h"
+#include "robot_settings.h"
+#include "robot_state.h"
+#include "spider_robot.h"
+#include "state_lock.h"
+#include <math.h>
+#include <string.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/ztest.h>
+
+#define TUNER_PRIORITY 5
+// Tuned while the legs are moving, a few ticks into the gait
+#define TUNE_AT_FRAME 3
+
+struct sample
+{
+        double z_default;
+        uint32_t keyframe;
+};
+
+static struct sample samples[MAX_FRAMES];
+static uint32_t nb_samples;
+static bool sampling;
+static struct robot_derived generated;
+static int tune_ret;
+K_SEM_DEFINE(tune_sem, 0, 1);
+
+/**
+ * @brief records the parameter in use and the keyframe on every motor tick,
+ * with g_state_mutex held.
+ */
+static void record_sample(void)
+{
+    if (!sampling || nb_samples >= MAX_FRAMES)
+        return;
+
+    samples[nb_samples].z_default = g_config.z_default;
+    samples[nb_samples].keyframe = g_state.keyframe;
+    if (++nb_samples == TUNE_AT_FRAME)
+        k_sem_give(&tune_sem);
+}
+
+// Plays the server thread: tunes from another thread, mid-gait
+static void tuner(void* p1, void* p2, void* p3)
+{
+    while (true)
+    {
+        k_sem_take(&tune_sem, K_FOREVER);
+        tune_ret = robot_settings_set("z_default", -45.0);
+    }
+}
+
+K_THREAD_DEFINE(tuner_tid, 1024, tuner, NULL, NULL, NULL, TUNER_PRIORITY, 0,
+                0);
+
+static void apply(void)
+{
+    state_lock(K_FOREVER);
+    robot_settings_apply();
+    state_unlock();
+}
+
+static int load_value(const char* key, size_t len, settings_read_cb read_cb,
+                      void* cb_arg, void* param)
+{
+    if (key != NULL || len != sizeof(double))
+        return 0;
+    return read_cb(cb_arg, param, sizeof(double)) == sizeof(double) ? 0 : -EIO;
+}
+
+/**
+ * @brief the value stored under spider/<name>, NAN if there is none
+ */
+static double stored(const char* name)
+{
+    char key[32];
+    double value = NAN;
+
+    snprintk(key, sizeof(key), "spider/%s", name);
+    zassert_ok(settings_load_subtree_direct(key, load_value, &value));
+    return value;
+}
+
+static void check_derived(const struct robot_derived* a,
+                          const struct robot_derived* b)
+{
+    zassert_within(a->turn_x0, b->turn_x0, 1e-6);
+    zassert_within(a->turn_y0, b->turn_y0, 1e-6);
+    zassert_within(a->turn_x1, b->turn_x1, 1e-6);
+    zassert_within(a->turn_y1, b->turn_y1, 1e-6);
+}
+
+ZTEST(robot_settings_suite, test_derive)
+{
+    struct robot_derived derived;
+
+    // The build time generator and the firmware agree
+    robot_derive(&robot_config_default, &derived);
+    check_derived(&derived, &generated);
+}
+
+ZTEST(robot_settings_suite, test_errors)
+{
+    zassert_equal(robot_settings_set("x_length", 10.0), -ENOENT);
+    zassert_equal(robot_settings_set("leg_move_speed", 0.0), -ERANGE);
+    zassert_equal(robot_settings_set("leg_move_speed", NAN), -ERANGE);
+    // Out of reach, and legs lifted below the stance
+    zassert_equal(robot_settings_set("z_default", -150.0), -EDOM);
+    zassert_equal(robot_settings_set("z_up", -60.0), -EDOM);
+    // The stance is reachable, the body shift of the gestures is not
+    zassert_equal(robot_settings_set("x_default", 120.0), -EDOM);
+
+    struct robot_param_value param;
+    for (int i = 0; robot_settings_get(i, &param) == 0; i++)
+        zassert_false(param.is_pending, "%s staged", param.name);
+    zassert_true(isnan(stored("z_up")));
+}
+
+ZTEST(robot_settings_suite, test_staged)
+{
+    struct robot_param_value param;
+
+    zassert_ok(robot_settings_set("leg_move_speed", 6.0));
+    zassert_equal(g_config.leg_move_speed,
+                  robot_config_default.leg_move_speed);
+    zassert_ok(robot_settings_get(2, &param));
+    zassert_str_equal(param.name, "leg_move_speed");
+    zassert_true(param.is_pending);
+    zassert_equal(param.pending, 6.0);
+
+    apply();
+    zassert_equal(g_config.leg_move_speed, 6.0);
+    zassert_ok(robot_settings_get(2, &param));
+    zassert_false(param.is_pending);
+}
+
+ZTEST(robot_settings_suite, test_persist)
+{
+    zassert_ok(robot_settings_set("z_default", -45.0));
+    zassert_ok(robot_settings_set("speed_multiple", 1.5));
+    zassert_equal(stored("z_default"), -45.0);
+
+    // Boots again with the values the firmware was built with
+    state_lock(K_FOREVER);
+    g_config = robot_config_default;
+    g_derived = generated;
+    state_unlock();
+    zassert_ok(robot_settings_init());
+
+    zassert_equal(g_config.z_default, -45.0);
+    zassert_equal(g_config.speed_multiple, 1.5);
+    zassert_not_equal(g_derived.turn_x0, generated.turn_x0);
+}
+
+ZTEST(robot_settings_suite, test_reset)
+{
+    zassert_ok(robot_settings_set("x_default", 70.0));
+    apply();
+    zassert_ok(robot_settings_reset());
+    apply();
+
+    zassert_mem_equal(&g_config, &robot_config_default, sizeof(g_config));
+    check_derived(&g_derived, &generated);
+    zassert_true(isnan(stored("x_default")));
+}
+
+/**
+ * @brief a value tuned while a gait runs must not change before the command
+ * is over, and the steps compiled with the previous one must not be played
+ * anymore.
+ */
+ZTEST(robot_settings_suite, test_command_boundary)
+{
+    struct gait_cache_stats stats;
+
+    gait_cache_compile();
+    gait_cache_get_stats(&stats);
+    zassert_true(stats.clips > 0);
+
+    init_stance();
+    stand(1);
+    nb_samples = 0;
+    tune_ret = -EAGAIN;
+    sampling = true;
+    step_forward(2);
+    sampling = false;
+
+    zassert_ok(tune_ret);
+    zassert_true(nb_samples > TUNE_AT_FRAME && nb_samples < MAX_FRAMES);
+    for (uint32_t i = 0; i < nb_samples; i++)
+        zassert_equal(samples[i].z_default, robot_config_default.z_default,
+                      "changed at keyframe %u", samples[i].keyframe);
+
+    // As the gait thread does before the next command
+    apply();
+    zassert_equal(g_config.z_default, -45.0);
+    gait_cache_get_stats(&stats);
+    zassert_equal(stats.clips, 0);
+}
+
+static void load_settings(void)
+{
+    generated = g_derived;
+    zassert_ok(robot_settings_init());
+}
+
+static void* robot_settings_setup(void)
+{
+    fixture_on_frame(record_sample);
+    fixture_setup(load_settings);
+    return NULL;
+}
+
+static void robot_settings_before(void* fixture)
+{
+    (void)fixture;
+
+    zassert_ok(robot_settings_reset());
+    apply();
+}
+
+ZTEST_SUITE(robot_settings_suite, NULL, robot_settings_setup,
+            robot_settings_before, NULL, NULL);
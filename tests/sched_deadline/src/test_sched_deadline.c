@@ -0,0 +1,98 @@
+#include "robot_state.h"
+#include "spider_robot.h"
+#include <zephyr/ztest.h>
+
+// As the gait and TCP server threads, tied
+#define GAIT_PRIORITY 5
+#define LOAD_PRIORITY 5
+#define LOAD_STACK_SIZE 1024
+#define LOAD_PAUSE_MS 10
+
+#if defined(CONFIG_SPIDER_SCHED_EDF)
+#define PROFILE "edf"
+#else
+#define PROFILE "fixed"
+#endif
+
+K_THREAD_STACK_DEFINE(load_stack, LOAD_STACK_SIZE);
+static struct k_thread load_thread;
+
+// Packet processing: long bursts, as a server thread busy with a client
+static void network_load(void* p1, void* p2, void* p3)
+{
+    while (true)
+    {
+#if defined(CONFIG_SPIDER_SCHED_EDF)
+        sched_deadline_at(cmd_timestamp_us() +
+                          CONFIG_SPIDER_EDF_NET_DEADLINE_MS * USEC_PER_MSEC);
+#endif
+        k_busy_wait(CONFIG_SCHED_DEADLINE_LOAD_BURST_MS * USEC_PER_MSEC);
+        k_msleep(LOAD_PAUSE_MS);
+    }
+}
+
+/**
+ * @brief walks from the gait thread's priority and counts the deadlines it
+ * and the motor thread missed meanwhile.
+ */
+static void walk(const char* name, struct deadline_stats* stats)
+{
+    k_thread_priority_set(k_current_get(), GAIT_PRIORITY);
+    stand(1);
+    end_keyframes();
+    motors_reset_deadline_stats();
+    step_forward(CONFIG_SCHED_DEADLINE_STEPS);
+    end_keyframes();
+    motors_get_deadline_stats(stats);
+
+    printk("DEADLINE %s %s: ticks %u missed %u, keyframes %u missed %u\n",
+           PROFILE, name, stats->ticks, stats->tick_misses, stats->keyframes,
+           stats->keyframe_misses);
+    zassert_true(stats->ticks > 0);
+    zassert_true(stats->keyframes > 0);
+}
+
+ZTEST(sched_deadline_suite, test_unloaded)
+{
+    struct deadline_stats stats;
+
+    walk("unloaded", &stats);
+    zassert_equal(stats.tick_misses, 0);
+    zassert_equal(stats.keyframe_misses, 0);
+}
+
+ZTEST(sched_deadline_suite, test_network_load)
+{
+    struct deadline_stats stats;
+
+    k_thread_create(&load_thread, load_stack,
+                    K_THREAD_STACK_SIZEOF(load_stack), network_load, NULL,
+                    NULL, NULL, LOAD_PRIORITY, 0, K_NO_WAIT);
+    walk("loaded", &stats);
+    k_thread_abort(&load_thread);
+
+    if (IS_ENABLED(CONFIG_SPIDER_SCHED_EDF))
+    {
+        // The tick and the keyframes preempt the burst
+        zassert_equal(stats.tick_misses, 0);
+        zassert_equal(stats.keyframe_misses, 0);
+    }
+    else
+    {
+        // The motor thread preempts the burst, the gait thread waits for it
+        zassert_equal(stats.tick_misses, 0);
+        zassert_true(stats.keyframe_misses > 0,
+                     "the load never delayed a keyframe");
+    }
+}
+
+static void* sched_deadline_setup(void)
+{
+    init_robot_state();
+    init_stance();
+    k_event_post(&robot_ready, ROBOT_READY);
+    return NULL;
+}
+
+ZTEST_SUITE(sched_deadline_suite, NULL, sched_deadline_setup, NULL, NULL,
+            NULL);
@@ -0,0 +1,86 @@
+#include "profiling.h"
+#include "robot_state.h"
+#include "spider_robot.h"
+#include <zephyr/ztest.h>
+
+#define TICK_NS 20000000U
+#define LOAD_THREADS 2
+#define LOAD_STACK_SIZE 1024
+#define LOAD_PRIORITY K_PRIO_COOP(2)
+#define LOAD_PAUSE_MS 2
+
+K_THREAD_STACK_ARRAY_DEFINE(load_stacks, LOAD_THREADS, LOAD_STACK_SIZE);
+static struct k_thread load_threads[LOAD_THREADS];
+
+// Packet processing: cooperative bursts, one after the other
+static void network_load(void* p1, void* p2, void* p3)
+{
+    while (true)
+    {
+        k_busy_wait(CONFIG_SMP_JITTER_LOAD_BURST_US);
+        k_msleep(LOAD_PAUSE_MS);
+    }
+}
+
+/**
+ * @brief worst distance of the motor tick period to 20 ms, in ns
+ */
+static uint32_t jitter_ns(const struct prof_summary* period)
+{
+    return MAX(period->max_ns - TICK_NS, TICK_NS - period->min_ns);
+}
+
+/**
+ * @brief moves the motor thread to a core and times its ticks under load.
+ */
+static void measure(const char* name, int cpu, struct prof_summary* period)
+{
+    k_thread_suspend(motor_thread_id);
+    zassert_ok(k_thread_cpu_pin(motor_thread_id, cpu));
+    k_thread_resume(motor_thread_id);
+
+    // Ticks after the move only
+    k_msleep(100);
+    prof_reset();
+    k_msleep(CONFIG_SMP_JITTER_MEASURE_MS);
+    prof_get(PROF_TICK_PERIOD, period);
+
+    printk("JITTER %s: cpu %d, %u ticks, period min %u max %u p99 %u ns, "
+           "jitter %u us\n",
+           name, cpu, period->count, period->min_ns, period->max_ns,
+           period->p99_ns, jitter_ns(period) / 1000);
+    zassert_true(period->count > 0);
+}
+
+ZTEST(smp_jitter_suite, test_pinned_control_core)
+{
+    struct prof_summary shared, pinned;
+
+    // As without SMP: the motor tick competes with the network core
+    measure("shared", CONFIG_SPIDER_NET_CPU, &shared);
+    measure("pinned", CONFIG_SPIDER_CONTROL_CPU, &pinned);
+
+    zassert_true(jitter_ns(&pinned) < jitter_ns(&shared),
+                 "pinning did not reduce the jitter");
+    // A tick on its own core is never late by a whole load burst
+    zassert_true(jitter_ns(&pinned) < CONFIG_SMP_JITTER_LOAD_BURST_US * 1000U);
+}
+
+static void* smp_jitter_setup(void)
+{
+    zassert_true(arch_num_cpus() > 1, "needs an SMP target");
+
+    init_robot_state();
+    init_stance();
+    k_thread_start(motor_thread_id);
+    k_event_post(&robot_ready, ROBOT_READY);
+
+    // Every thread created from here starts on CPU 0, the network core
+    for (int i = 0; i < LOAD_THREADS; i++)
+        k_thread_create(&load_threads[i], load_stacks[i],
+                        K_THREAD_STACK_SIZEOF(load_stacks[i]), network_load,
+                        NULL, NULL, NULL, LOAD_PRIORITY, 0, K_NO_WAIT);
+    return NULL;
+}
+
+ZTEST_SUITE(smp_jitter_suite, NULL, smp_jitter_setup, NULL, NULL, NULL);
@@ -0,0 +1,103 @@
+#include "state_lock.h"
+#include <zephyr/ztest.h>
+
+#define HOLDER_STACK_SIZE 1024
+#define HOLDER_PRIORITY 5
+#define HOLD_MS 50
+
+K_MUTEX_DEFINE(g_state_mutex);
+
+K_THREAD_STACK_DEFINE(holder_stack, HOLDER_STACK_SIZE);
+static struct k_thread holder_thread;
+static K_SEM_DEFINE(holder_locked, 0, 1);
+
+// Keeps the state for a while, the way a long gait phase would
+static void holder(void* p1, void* p2, void* p3)
+{
+    state_lock(K_FOREVER);
+    k_sem_give(&holder_locked);
+    k_msleep(HOLD_MS);
+    state_unlock();
+}
+
+static k_tid_t start_holder(void)
+{
+    k_tid_t tid = k_thread_create(
+        &holder_thread, holder_stack, K_THREAD_STACK_SIZEOF(holder_stack),
+        holder, NULL, NULL, NULL, HOLDER_PRIORITY, 0, K_NO_WAIT);
+
+    k_sem_take(&holder_locked, K_FOREVER);
+    return tid;
+}
+
+static void state_lock_before(void* fixture)
+{
+    (void)fixture;
+    lock_stats_reset();
+}
+
+ZTEST(state_lock_suite, test_contention_is_accounted_per_site)
+{
+    struct lock_site_stats worst[4];
+    k_tid_t tid = start_holder();
+
+    // Gives up while the holder keeps the state
+    zassert_not_equal(state_lock(K_MSEC(10)), 0);
+    // Then waits for it
+    zassert_ok(state_lock(K_FOREVER));
+    zassert_ok(state_unlock());
+    k_thread_join(tid, K_FOREVER);
+
+    int count = lock_stats_worst(worst, ARRAY_SIZE(worst));
+    zassert_true(count >= 3);
+
+    // The holder is the worst offender
+    zassert_equal(worst[0].acquired, 1);
+    zassert_true(k_cyc_to_ms_floor64(worst[0].hold_cycles) >= HOLD_MS - 1);
+    zassert_equal(worst[0].max_hold_cycles, worst[0].hold_cycles);
+
+    uint32_t timeouts = 0;
+    uint64_t waited = 0;
+    for (int i = 0; i < count; i++)
+    {
+        timeouts += worst[i].timeouts;
+        waited += worst[i].wait_cycles;
+        if (i > 0)
+            zassert_true(worst[i].hold_cycles <= worst[i - 1].hold_cycles);
+    }
+    zassert_equal(timeouts, 1);
+    zassert_true(k_cyc_to_ms_floor64(waited) >= HOLD_MS - 1);
+}
+
+ZTEST(state_lock_suite, test_recursive_lock_holds_once)
+{
+    struct lock_site_stats worst[8];
+
+    zassert_ok(state_lock(K_FOREVER));
+    zassert_ok(state_lock(K_FOREVER));
+    zassert_ok(state_unlock());
+    k_msleep(10);
+    zassert_ok(state_unlock());
+
+    // Only the outer site held the mutex until the last unlock
+    int count = lock_stats_worst(worst, ARRAY_SIZE(worst));
+    zassert_true(k_cyc_to_ms_floor64(worst[0].hold_cycles) >= 9);
+    for (int i = 1; i < count; i++)
+        zassert_equal(worst[i].hold_cycles, 0);
+}
+
+ZTEST(state_lock_suite, test_reset_keeps_sites)
+{
+    struct lock_site_stats worst[8];
+
+    zassert_ok(state_lock(K_FOREVER));
+    zassert_ok(state_unlock());
+    lock_stats_reset();
+
+    int count = lock_stats_worst(worst, ARRAY_SIZE(worst));
+    zassert_true(count > 0);
+    for (int i = 0; i < count; i++)
+        zassert_equal(worst[i].acquired, 0);
+}
+
+ZTEST_SUITE(state_lock_suite, NULL, NULL, state_lock_before, NULL, NULL);
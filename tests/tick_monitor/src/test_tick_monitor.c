@@ -0,0 +1,173 @@
+#include "robot_state.h"
+#include "servos_sim.h"
+#include "spider_robot.h"
+#include "state_lock.h"
+#include <zephyr/ztest.h>
+
+#define TICK_MS 20
+// Longer than the tick period: every tick ends late
+#define STALL_MS 30
+#define FAULT_TIMEOUT_MS (CONFIG_SPIDER_TICK_FAULT_MISSES * 4 * TICK_MS)
+#define RECOVER_TIMEOUT_MS (CONFIG_SPIDER_TICK_RECOVER_TICKS * 4 * TICK_MS)
+// As the gait thread, long enough for the fault and the recovery to happen
+// while it walks
+#define WALK_PRIORITY 5
+#define WALK_STACK_SIZE 2048
+#define WALK_STEPS 20
+#define WALK_START_MS 500
+// A cancelled gait ends within the keyframe it was playing
+#define STOP_TIMEOUT_MS (5 * TICK_MS)
+
+K_THREAD_STACK_DEFINE(walk_stack, WALK_STACK_SIZE);
+static struct k_thread walk_thread;
+static bool walk_cancelled;
+
+// Run as the gait thread runs a "sf" command
+static void walk(void* p1, void* p2, void* p3)
+{
+    begin_command();
+    step_forward(WALK_STEPS);
+    walk_cancelled = end_command();
+}
+
+static bool wait_faulted(bool faulted, int timeout_ms)
+{
+    for (int ms = 0; ms < timeout_ms; ms += TICK_MS)
+    {
+        if (motors_faulted() == faulted)
+            return true;
+        k_msleep(TICK_MS);
+    }
+    return motors_faulted() == faulted;
+}
+
+/**
+ * @brief true if every leg targets the boot (sitting) height.
+ */
+static bool sitting(void)
+{
+    bool sit = true;
+
+    state_lock(K_FOREVER);
+    for (int leg = 0; leg < NB_LEGS; leg++)
+        sit &= g_state.site_expect[leg][2] == g_derived.z_boot;
+    state_unlock();
+    return sit;
+}
+
+ZTEST(tick_monitor_suite, test_stalled_i2c)
+{
+    struct tick_monitor_stats before, stats;
+
+    stand(1);
+    zassert_false(sitting());
+    motors_get_monitor_stats(&before);
+
+    servo_sim_stall_ms = STALL_MS;
+    zassert_true(wait_faulted(true, FAULT_TIMEOUT_MS), "no safe stop");
+    motors_get_monitor_stats(&stats);
+    zassert_equal(stats.faults, before.faults + 1);
+    zassert_true(stats.late > before.late);
+    zassert_true(stats.skipped > before.skipped);
+
+    // The gait can't move the legs, it ends once they sat down
+    step_forward(1);
+    zassert_true(sitting());
+    zassert_true(motors_faulted());
+
+    servo_sim_stall_ms = 0;
+    zassert_true(wait_faulted(false, RECOVER_TIMEOUT_MS), "not recovered");
+    motors_get_monitor_stats(&stats);
+    zassert_equal(stats.streak, 0);
+    zassert_false(stats.faulted);
+
+    // Moving again
+    stand(1);
+    zassert_false(sitting());
+}
+
+ZTEST(tick_monitor_suite, test_held_mutex)
+{
+    struct tick_monitor_stats before, stats;
+
+    stand(1);
+    motors_get_monitor_stats(&before);
+
+    // The ticks time out on the mutex, the monitor does not need it
+    state_lock(K_FOREVER);
+    k_msleep((CONFIG_SPIDER_TICK_FAULT_MISSES + 2) * TICK_MS);
+    zassert_true(motors_faulted(), "no safe stop");
+    state_unlock();
+
+    motors_get_monitor_stats(&stats);
+    zassert_equal(stats.faults, before.faults + 1);
+    zassert_true(stats.skipped >=
+                 before.skipped + CONFIG_SPIDER_TICK_FAULT_MISSES);
+
+    // Sitting down as soon as the motor thread gets the mutex back
+    zassert_true(wait_faulted(false, RECOVER_TIMEOUT_MS), "not recovered");
+    zassert_true(sitting());
+}
+
+ZTEST(tick_monitor_suite, test_fault_while_walking)
+{
+    stand(1);
+    walk_cancelled = false;
+    k_thread_create(&walk_thread, walk_stack,
+                    K_THREAD_STACK_SIZEOF(walk_stack), walk, NULL, NULL, NULL,
+                    WALK_PRIORITY, 0, K_NO_WAIT);
+    k_msleep(WALK_START_MS);
+    zassert_false(sitting());
+
+    servo_sim_stall_ms = STALL_MS;
+    zassert_true(wait_faulted(true, FAULT_TIMEOUT_MS), "no safe stop");
+    servo_sim_stall_ms = 0;
+    zassert_true(wait_faulted(false, RECOVER_TIMEOUT_MS), "not recovered");
+
+    // The steps left are dropped, the robot stays down
+    zassert_equal(k_thread_join(&walk_thread, K_MSEC(RECOVER_TIMEOUT_MS)), 0,
+                  "still walking");
+    zassert_true(walk_cancelled);
+    k_msleep(CONFIG_SPIDER_TICK_RECOVER_TICKS * TICK_MS);
+    zassert_true(sitting());
+
+    // The next command runs
+    begin_command();
+    stand(1);
+    zassert_false(end_command());
+    zassert_false(sitting());
+}
+
+/**
+ * @brief A gait cancelled the way the server does on `stop` ends right away,
+ * its steps left are not played.
+ */
+ZTEST(tick_monitor_suite, test_stop_cuts_walk)
+{
+    stand(1);
+    walk_cancelled = false;
+    k_thread_create(&walk_thread, walk_stack,
+                    K_THREAD_STACK_SIZEOF(walk_stack), walk, NULL, NULL, NULL,
+                    WALK_PRIORITY, 0, K_NO_WAIT);
+    k_msleep(WALK_START_MS);
+
+    cancel_command();
+    zassert_equal(k_thread_join(&walk_thread, K_MSEC(STOP_TIMEOUT_MS)), 0,
+                  "still walking");
+    zassert_true(walk_cancelled);
+
+    // The next command runs
+    begin_command();
+    stand(1);
+    zassert_false(end_command());
+}
+
+static void* tick_monitor_setup(void)
+{
+    init_robot_state();
+    init_stance();
+    k_event_post(&robot_ready, ROBOT_READY);
+    return NULL;
+}
+
+ZTEST_SUITE(tick_monitor_suite, NULL, tick_monitor_setup, NULL, NULL, NULL);
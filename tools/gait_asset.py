@@ -0,0 +1,300 @@
+#!/usr/bin/env python3
+"""Encodes, uploads and lists the gaits stored in the robot's flash.
+
+A gait is described in a text file, one keyframe per block; the coordinates
+are expressions over the geometry of tools/robot_geometry.py (x_default,
+y_step, turn_x0, ...), "-" keeps the current target of the coordinate:
+
+    gait sf
+    # speed: leg, body, seat or turn; "joint" for a joint space move
+    keyframe leg
+      2: x_default + x_offset, y_start, z_up
+    keyframe body
+      0: x_default + x_offset, y_start, z_default
+      1: -, -, z_up
+
+    tools/gait_asset.py encode tools/gaits/sf.gait -o sf.bin --compare
+    tools/gait_asset.py upload tools/gaits/sf.gait --port 5000
+    tools/gait_asset.py list --port 5000
+
+Once uploaded it runs like any gait command, "g.sf 3". The binary format
+(version 1, little endian) is a 24 byte header followed by the keyframes:
+
+    header   u32 magic "GAIT", u8 version, u8 quantum (1/100 mm),
+             u16 keyframes, u16 data length, u16 CRC-16/CCITT of the data,
+             char name[12]
+    keyframe u8 control (bits 0-1 speed, bit 2 joint space),
+             u16 axes (bit 3 * leg + axis set when the coordinate changes),
+             one zigzag varint per axis set: the change in quanta since the
+             leg's previous keyframe (from 0 for the first one)
+
+--compare generates the equivalent C function, compiles it with $CC (cc by
+default, set it to the target compiler) and reports its size next to the
+asset's.
+"""
+
+import argparse
+import os
+import re
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import robot_geometry  # noqa: E402
+
+MAGIC = b"GAIT"
+VERSION = 1
+QUANTUM_CENTI_MM = 25
+HEADER = struct.Struct("<4sBBHHH12s")
+NAME_SIZE = 12
+SPEEDS = {"leg": 0, "body": 1, "seat": 2, "turn": 3}
+SPEED_FIELDS = ["leg_move_speed", "body_move_speed", "stand_seat_speed",
+                "spot_turn_speed"]
+NB_LEGS = 4
+UPLOAD_CHUNK = 48
+
+
+class Keyframe:
+    def __init__(self, speed, joint):
+        self.speed = speed
+        self.joint = joint
+        self.legs = {}  # leg -> [x, y, z], None keeps the coordinate
+
+
+def parse(path, symbols):
+    """Returns (name, keyframes) of a gait description."""
+    name = None
+    keyframes = []
+    with open(path) as f:
+        for number, raw in enumerate(f, 1):
+            line = raw.split("#", 1)[0].strip()
+            if not line:
+                continue
+            where = f"{path}:{number}"
+            words = line.split()
+            if words[0] == "gait":
+                name = words[1]
+            elif words[0] == "keyframe":
+                if len(words) < 2 or words[1] not in SPEEDS:
+                    sys.exit(f"{where}: speed must be one of {list(SPEEDS)}")
+                keyframes.append(Keyframe(SPEEDS[words[1]],
+                                          "joint" in words[2:]))
+            else:
+                match = re.match(r"(\d)\s*:(.*)", line)
+                if not match or not keyframes:
+                    sys.exit(f"{where}: expected 'leg: x, y, z'")
+                leg = int(match.group(1))
+                coords = [c.strip() for c in match.group(2).split(",")]
+                if leg >= NB_LEGS or len(coords) != 3:
+                    sys.exit(f"{where}: expected 'leg: x, y, z'")
+                keyframes[-1].legs[leg] = [
+                    None if c == "-" else float(eval(c, {}, symbols))
+                    for c in coords]
+    if not name or len(name) >= NAME_SIZE:
+        sys.exit(f"{path}: 'gait <name>' missing or longer than "
+                 f"{NAME_SIZE - 1} characters")
+    return name, keyframes
+
+
+def varint(value):
+    zigzag = (value << 1) ^ (value >> 63)
+    out = bytearray()
+    while True:
+        byte = zigzag & 0x7F
+        zigzag >>= 7
+        if zigzag:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def crc16_ccitt(data, seed=0xFFFF):
+    """Same as Zephyr's crc16_ccitt()."""
+    for byte in data:
+        e = (seed ^ byte) & 0xFF
+        f = (e ^ (e << 4)) & 0xFF
+        seed = ((seed >> 8) ^ (f << 8) ^ (f << 3) ^ (f >> 4)) & 0xFFFF
+    return seed
+
+
+def encode(name, keyframes):
+    quantum = QUANTUM_CENTI_MM / 100
+    previous = [[0, 0, 0] for _ in range(NB_LEGS)]
+    data = bytearray()
+    for kf in keyframes:
+        axes = 0
+        deltas = bytearray()
+        for leg in range(NB_LEGS):
+            for axis, value in enumerate(kf.legs.get(leg, [None] * 3)):
+                if value is None:
+                    continue
+                quanta = round(value / quantum)
+                axes |= 1 << (3 * leg + axis)
+                deltas += varint(quanta - previous[leg][axis])
+                previous[leg][axis] = quanta
+        data += struct.pack("<BH", kf.speed | (kf.joint << 2), axes) + deltas
+    header = HEADER.pack(MAGIC, VERSION, QUANTUM_CENTI_MM, len(keyframes),
+                         len(data), crc16_ccitt(data), name.encode())
+    return header + data
+
+
+def c_function(name, keyframes):
+    """The gait as it would be written in gait.c."""
+    lines = [f"void gait_{name}(unsigned int step)", "{",
+             "    while (step-- > 0)", "    {"]
+    for kf in keyframes:
+        lines.append("        state_lock(K_FOREVER);")
+        lines.append(f"        g_state.move_speed = "
+                     f"g_config.{SPEED_FIELDS[kf.speed]};")
+        call = "set_site_joint" if kf.joint else "set_site"
+        for leg, coords in sorted(kf.legs.items()):
+            args = ", ".join("KEEP" if c is None else repr(c) for c in coords)
+            lines.append(f"        {call}({leg}, {args});")
+        lines.append("        state_unlock();")
+        lines.append("        wait_all_reach();")
+    lines += ["    }", "}"]
+    return "\n".join(lines) + "\n"
+
+
+C_PRELUDE = """\
+struct k_timeout { long long ticks; };
+struct robot_config { double leg_move_speed, body_move_speed,
+                      stand_seat_speed, spot_turn_speed; };
+struct robot_state { double move_speed; };
+extern const struct robot_config g_config;
+extern struct robot_state g_state;
+extern const double KEEP;
+int state_lock(struct k_timeout timeout);
+int state_unlock(void);
+int set_site(int leg, double x, double y, double z);
+int set_site_joint(int leg, double x, double y, double z);
+void wait_all_reach(void);
+#define K_FOREVER ((struct k_timeout){-1})
+"""
+
+
+def compiled_size(source):
+    """text + data of the C function built with $CC -Os, None on failure."""
+    cc = os.environ.get("CC", "cc")
+    with tempfile.TemporaryDirectory() as tmp:
+        src = os.path.join(tmp, "gait.c")
+        obj = os.path.join(tmp, "gait.o")
+        with open(src, "w") as f:
+            f.write(C_PRELUDE + source)
+        try:
+            subprocess.run([cc, "-Os", "-c", src, "-o", obj], check=True,
+                           capture_output=True)
+            size = os.environ.get("SIZE", "size")
+            out = subprocess.run([size, obj], check=True, capture_output=True,
+                                 text=True).stdout.splitlines()[1].split()
+        except (OSError, subprocess.CalledProcessError) as error:
+            print(f"can't compile the C equivalent: {error}", file=sys.stderr)
+            return None
+    return int(out[0]) + int(out[1]), cc
+
+
+def load(path, config):
+    geometry = robot_geometry.read_config(config)
+    symbols = {**geometry, **robot_geometry.derive(geometry)}
+    name, keyframes = parse(path, symbols)
+    return name, keyframes, encode(name, keyframes)
+
+
+def cmd_encode(args):
+    name, keyframes, blob = load(args.gait, args.config)
+    if args.output:
+        with open(args.output, "wb") as f:
+            f.write(blob)
+    if args.inc:
+        with open(args.inc, "w") as f:
+            for i in range(0, len(blob), 12):
+                f.write(", ".join(f"0x{b:02x}" for b in blob[i:i + 12])
+                        + ",\n")
+    moves = sum(len(kf.legs) for kf in keyframes)
+    print(f"{name}: {len(keyframes)} keyframes, {moves} leg moves, "
+          f"{len(blob)} bytes ({HEADER.size} header)")
+    if args.compare:
+        source = c_function(name, keyframes)
+        compiled = compiled_size(source)
+        print(f"C equivalent: {len(source)} bytes of source", end="")
+        if compiled:
+            print(f", {compiled[0]} bytes of code and data ({compiled[1]} -Os)"
+                  f", {compiled[0] / len(blob):.1f}x the asset")
+        else:
+            print()
+
+
+class Robot:
+    def __init__(self, host, port):
+        self.sock = socket.create_connection((host, port), timeout=10)
+        self.lines = self.sock.makefile("r")
+
+    def send(self, line):
+        self.sock.sendall((line + "\n").encode())
+
+    def read_gait(self):
+        """Next GAIT reply, ACK and DONE lines are skipped."""
+        while True:
+            line = self.lines.readline()
+            if not line:
+                sys.exit("robot closed the connection")
+            if line.startswith("GAIT"):
+                return line.split()
+
+
+def cmd_upload(args):
+    name, _, blob = load(args.gait, args.config)
+    robot = Robot(args.host, args.port)
+    robot.send(f"gput {len(blob)}")
+    reply = robot.read_gait()
+    if reply[1] != "ready":
+        sys.exit(" ".join(reply))
+    for i in range(0, len(blob), UPLOAD_CHUNK):
+        robot.send("gdat " + blob[i:i + UPLOAD_CHUNK].hex())
+    reply = robot.read_gait()
+    print(" ".join(reply))
+    if reply[1] != "stored":
+        sys.exit(1)
+    print(f"run it with: g.{name} [times]")
+
+
+def cmd_list(args):
+    robot = Robot(args.host, args.port)
+    robot.send("glist")
+    while True:
+        reply = robot.read_gait()
+        print(" ".join(reply[1:]))
+        if reply[1] == "end":
+            break
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--config", help="build's .config, for the geometry")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    encode_parser = sub.add_parser("encode")
+    encode_parser.add_argument("gait")
+    encode_parser.add_argument("-o", "--output", help="binary asset to write")
+    encode_parser.add_argument("--inc", help="C array initializer to write")
+    encode_parser.add_argument("--compare", action="store_true")
+    encode_parser.set_defaults(fn=cmd_encode)
+
+    for name, fn in (("upload", cmd_upload), ("list", cmd_list)):
+        robot_parser = sub.add_parser(name)
+        if name == "upload":
+            robot_parser.add_argument("gait")
+        robot_parser.add_argument("--host", default="127.0.0.1")
+        robot_parser.add_argument("--port", type=int, default=5000)
+        robot_parser.set_defaults(fn=fn)
+
+    args = parser.parse_args()
+    args.fn(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+"""Turns a CTF trace of the gait trace points into a timeline and a summary.
+
+The trace is captured on the simulated robot (see tracing_native_sim.conf)
+and decoded with babeltrace2; only the named events of include/trace_points.h
+are used:
+
+    ./build/zephyr/zephyr.exe -trace-file=trace/channel0_0
+    tools/gait_trace.py trace                  # runs babeltrace2 on it
+    tools/gait_trace.py --text decoded.txt     # already decoded output
+
+Per keyframe it reports how long the legs took to reach their targets after
+the gait thread set them (motion) and how long the gait thread took to notice
+(wake); per command, the time from dequeue to the first keyframe and the
+whole duration.
+"""
+
+import argparse
+import os
+import re
+import shutil
+import statistics
+import subprocess
+import sys
+
+# "[1.234567890] ... named_event: ... name = "keyframe_set", arg0 = 2, arg1 = 7"
+EVENT_RE = re.compile(
+    r"^\[(?:(\d+):(\d+):)?(\d+\.\d+)\].*named_event.*"
+    r'name = "(\w+)".*arg0 = (\d+).*arg1 = (\d+)')
+
+
+def parse(lines):
+    """Yields (time_us, name, arg0, arg1) for every named event."""
+    for line in lines:
+        match = EVENT_RE.search(line)
+        if not match:
+            continue
+        hours, minutes, seconds, name, arg0, arg1 = match.groups()
+        t = float(seconds) + 60 * int(minutes or 0) + 3600 * int(hours or 0)
+        yield t * 1e6, name, int(arg0), int(arg1)
+
+
+def decode(trace_dir):
+    """Runs babeltrace2 on the trace directory, adding the CTF metadata."""
+    metadata = os.path.join(trace_dir, "metadata")
+    if not os.path.exists(metadata):
+        zephyr_base = os.environ.get("ZEPHYR_BASE")
+        if not zephyr_base:
+            sys.exit(f"{metadata} missing and ZEPHYR_BASE not set")
+        shutil.copy(os.path.join(zephyr_base,
+                                 "subsys/tracing/ctf/tsdl/metadata"), metadata)
+    out = subprocess.run(["babeltrace2", "--clock-seconds", trace_dir],
+                         check=True, capture_output=True, text=True)
+    return out.stdout.splitlines()
+
+
+class Keyframe:
+    def __init__(self, index):
+        self.index = index
+        self.set_us = None
+        self.legs = set()
+        self.reached_us = {}
+        self.wake_us = None
+
+    def motion_us(self):
+        if self.set_us is None or not self.reached_us:
+            return None
+        return max(self.reached_us.values()) - self.set_us
+
+    def wake_latency_us(self):
+        if self.wake_us is None or not self.reached_us:
+            return None
+        return self.wake_us - max(self.reached_us.values())
+
+
+class Command:
+    def __init__(self, cmd_id, times, dequeued_us):
+        self.id = cmd_id
+        self.times = times
+        self.dequeued_us = dequeued_us
+        self.done_us = None
+        self.keyframes = []
+
+
+def build(events):
+    keyframes = {}
+    commands = []
+    current = None
+    frames = []
+
+    def keyframe(index):
+        if index not in keyframes:
+            keyframes[index] = Keyframe(index)
+            if current is not None:
+                current.keyframes.append(keyframes[index])
+        return keyframes[index]
+
+    for t, name, arg0, arg1 in events:
+        if name == "cmd_dequeued":
+            current = Command(arg0, arg1, t)
+            commands.append(current)
+        elif name == "cmd_done":
+            if current is not None and current.id == arg0:
+                current.done_us = t
+            current = None
+        elif name == "keyframe_set":
+            kf = keyframe(arg1)
+            kf.legs.add(arg0)
+            if kf.set_us is None:
+                kf.set_us = t
+        elif name == "target_reached":
+            keyframe(arg1).reached_us[arg0] = t
+        elif name == "gait_wake":
+            keyframe(arg0).wake_us = t
+        elif name == "servo_frame":
+            frames.append(t)
+    return commands, frames
+
+
+def ms(us):
+    return "-" if us is None else f"{us / 1000:.2f}"
+
+
+def print_timeline(commands):
+    for cmd in commands:
+        total = None if cmd.done_us is None else cmd.done_us - cmd.dequeued_us
+        print(f"cmd {cmd.id} x{cmd.times}: {ms(total)} ms, "
+              f"{len(cmd.keyframes)} keyframes")
+        for kf in cmd.keyframes:
+            start = None if kf.set_us is None else kf.set_us - cmd.dequeued_us
+            legs = ",".join(str(leg) for leg in sorted(kf.legs))
+            print(f"  kf {kf.index:5d} legs {legs:8s} at +{ms(start)} ms  "
+                  f"motion {ms(kf.motion_us())} ms  "
+                  f"wake {ms(kf.wake_latency_us())} ms")
+
+
+def summary_line(label, values):
+    values = [v for v in values if v is not None]
+    if not values:
+        print(f"{label:24s} no samples")
+        return
+    print(f"{label:24s} n={len(values):5d} mean={ms(statistics.mean(values))} "
+          f"p50={ms(statistics.median(values))} max={ms(max(values))} ms")
+
+
+def print_summary(commands, frames):
+    keyframes = [kf for cmd in commands for kf in cmd.keyframes]
+    print("--- summary ---")
+    summary_line("command duration",
+                 [c.done_us - c.dequeued_us for c in commands
+                  if c.done_us is not None])
+    summary_line("dequeue to 1st keyframe",
+                 [c.keyframes[0].set_us - c.dequeued_us for c in commands
+                  if c.keyframes and c.keyframes[0].set_us is not None])
+    summary_line("keyframe motion", [kf.motion_us() for kf in keyframes])
+    summary_line("gait wake latency",
+                 [kf.wake_latency_us() for kf in keyframes])
+    summary_line("servo frame period",
+                 [b - a for a, b in zip(frames, frames[1:])])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("trace", nargs="?",
+                        help="directory holding the CTF stream (channel0_0)")
+    parser.add_argument("--text", help="babeltrace2 text output to parse")
+    parser.add_argument("--summary-only", action="store_true")
+    args = parser.parse_args()
+
+    if args.text:
+        with open(args.text) as f:
+            lines = f.read().splitlines()
+    elif args.trace:
+        lines = decode(args.trace)
+    else:
+        parser.error("a trace directory or --text is required")
+
+    commands, frames = build(parse(lines))
+    if not commands:
+        sys.exit("no gait command found in the trace")
+    if not args.summary_only:
+        print_timeline(commands)
+    print_summary(commands, frames)
+
+
+if __name__ == "__main__":
+    main()
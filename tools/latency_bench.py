@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""Measures where the latency of a command goes, from its bytes reaching the
+robot to the first servo move.
+
+The firmware is built with the profiling, which stamps every command when it
+is received, queued, taken by the gait thread, when it sets its first leg
+target and when a servo first moves. This client sends commands one at a time
+(each waits for the DONE of the previous one) and then reads the per stage
+distributions with `prof`:
+
+    west build -b native_sim -- -DCONF_FILE=prj_native_sim.conf \\
+        -DCONFIG_SPIDER_PROFILING=y
+    tools/latency_bench.py --exe build/zephyr/zephyr.exe --count 50
+
+--pipeline sends them all at once instead, to see the queueing.
+"""
+
+import argparse
+import socket
+import subprocess
+import sys
+import time
+
+STAGES = [
+    ("lat_enqueue", "received -> queued"),
+    ("lat_dequeue", "queued -> gait thread"),
+    ("lat_site", "gait thread -> 1st set_site"),
+    ("lat_servo", "1st set_site -> 1st servo"),
+    ("lat_total", "received -> 1st servo"),
+]
+
+
+class Robot:
+    def __init__(self, host, port):
+        self.sock = socket.create_connection((host, port), timeout=30)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.lines = self.sock.makefile("r")
+
+    def send(self, line):
+        self.sock.sendall((line + "\n").encode())
+
+    def read_until(self, prefix):
+        while True:
+            line = self.lines.readline()
+            if not line:
+                raise ConnectionError("robot closed the connection")
+            if line.startswith(prefix):
+                return line.split()
+
+    def prof(self):
+        """{phase: {"n": .., "min": .., ...}} in ns, from the `prof` reply."""
+        self.send("prof")
+        phases = {}
+        while "lat_total" not in phases:
+            line = self.lines.readline()
+            if not line:
+                raise ConnectionError("robot closed the connection")
+            fields = line.split()
+            if fields[:1] == ["ACK"]:
+                break  # not a server command: built without the profiling
+            if fields[:1] == ["PROF"]:
+                phases[fields[1]] = {k: int(v) for k, v in
+                                     (f.split("=") for f in fields[2:])}
+        return phases
+
+    def close(self):
+        self.send("close")
+        self.sock.close()
+
+
+def connect(host, port, timeout_s):
+    deadline = time.monotonic() + timeout_s
+    while True:
+        try:
+            return Robot(host, port)
+        except OSError:
+            if time.monotonic() > deadline:
+                raise
+            time.sleep(0.1)
+
+
+def run(robot, commands, count, pipeline):
+    """Sends the commands, returns the client side send -> ACK times (ms)."""
+    acks = []
+    sequence = [commands[i % len(commands)] for i in range(count)]
+    if pipeline:
+        for command in sequence:
+            robot.send(command)
+        for _ in sequence:
+            robot.read_until("DONE")
+        return acks
+
+    for command in sequence:
+        start = time.monotonic()
+        robot.send(command)
+        ack = robot.read_until("ACK")
+        acks.append((time.monotonic() - start) * 1000)
+        if ack[2] != "accepted":
+            sys.exit(f"{command}: {' '.join(ack)}")
+        robot.read_until("DONE")
+    return acks
+
+
+def ms(ns):
+    return f"{ns / 1e6:8.2f}"
+
+
+def report(phases, acks):
+    total = phases["lat_total"]["mean"] or 1
+    print(f"{'stage':30s} {'n':>5s} {'min':>8s} {'mean':>8s} {'p99':>8s} "
+          f"{'max':>8s}  share (ms)")
+    for name, label in STAGES:
+        p = phases[name]
+        share = "" if name == "lat_total" else f"{100 * p['mean'] / total:5.1f}%"
+        print(f"{label:30s} {p['n']:5d} {ms(p['min'])} {ms(p['mean'])} "
+              f"{ms(p['p99'])} {ms(p['max'])}  {share}")
+    if acks:
+        acks.sort()
+        print(f"client send -> ACK: min {acks[0]:.2f} "
+              f"p50 {acks[len(acks) // 2]:.2f} max {acks[-1]:.2f} ms")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--exe", help="native_sim zephyr.exe to launch")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=5000)
+    parser.add_argument("--count", type=int, default=20)
+    parser.add_argument("--commands", default="stand,sf 1,sb 1,sit",
+                        help="comma separated commands, sent in turn")
+    parser.add_argument("--pipeline", action="store_true",
+                        help="send all the commands without waiting")
+    args = parser.parse_args()
+
+    proc = None
+    if args.exe:
+        proc = subprocess.Popen([args.exe, f"--port={args.port}"],
+                                stdout=subprocess.DEVNULL,
+                                stderr=subprocess.DEVNULL)
+    try:
+        robot = connect(args.host, args.port, 10)
+        robot.send("prof reset")
+        acks = run(robot, args.commands.split(","), args.count, args.pipeline)
+        phases = robot.prof()
+        if "lat_total" not in phases:
+            sys.exit("no latency reported, is CONFIG_SPIDER_PROFILING set?")
+        report(phases, acks)
+        robot.close()
+    finally:
+        if proc is not None:
+            proc.terminate()
+            proc.wait()
+
+
+if __name__ == "__main__":
+    main()
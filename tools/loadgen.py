@@ -0,0 +1,261 @@
+#!/usr/bin/env python3
+"""Replays command sessions or synthetic workloads against the TCP server.
+
+Each connection sends its commands at the given rate while a reader matches
+the ACK, DONE and CANCEL lines to them. At the end it reports how many were
+accepted, coalesced, rejected, dropped (`full`), completed and cancelled,
+with the send -> ACK and send -> DONE latencies.
+
+    tools/loadgen.py --exe build/zephyr/zephyr.exe replay telnet
+    tools/loadgen.py --host 192.168.1.100 synthetic --rate 5 --count 100 \\
+        --mix "sf:4,tl:1,tr:1,wave:1" --concurrency 2
+
+Session files hold one command per line, `<command> [times]`, optionally
+preceded by `+<ms>` to wait before sending it; `#` starts a comment. A line
+ending with a host and a port (`stand 192.168.1.100 5000`, as in the telnet
+file) also gives the robot to connect to. The server serves one client at a
+time: with --concurrency the other connections wait in its listen backlog
+until the previous one is done and closed, which shows in their send -> ACK
+times.
+"""
+
+import argparse
+import random
+import re
+import socket
+import statistics
+import subprocess
+import sys
+import threading
+import time
+
+TARGET_RE = re.compile(r"^(.*?)\s+(\d+\.\d+\.\d+\.\d+)\s+(\d+)$")
+
+
+class Command:
+    def __init__(self, text, delay_ms=0):
+        self.text = text
+        self.delay_ms = delay_ms
+        self.sent = None
+        self.acked = None
+        self.ack = None
+        self.id = None
+        self.merged_id = None
+        self.done = None
+        self.cancelled = False
+        self.robot_times = None  # enqueued, started, finished (robot us)
+
+
+class Connection(threading.Thread):
+    """One client: sends its commands and collects the replies."""
+
+    def __init__(self, host, port, commands, period_s, drain_s):
+        super().__init__(daemon=True)
+        self.host = host
+        self.port = port
+        self.commands = commands
+        self.period_s = period_s
+        self.drain_s = drain_s
+        self.connect_s = None
+        self.by_id = {}
+        self.pending_acks = []
+        self.lock = threading.Lock()
+        self.error = None
+
+    def read_replies(self, lines):
+        for line in lines:
+            fields = line.split()
+            now = time.monotonic()
+            with self.lock:
+                if fields[:1] == ["ACK"] and self.pending_acks:
+                    cmd = self.pending_acks.pop(0)
+                    cmd.acked, cmd.id, cmd.ack = now, int(fields[1]), fields[2]
+                    cmd.merged_id = int(fields[3]) if len(fields) > 3 else None
+                    self.by_id[cmd.id] = cmd
+                elif fields[:1] in (["DONE"], ["CANCEL"]):
+                    done_id = int(fields[1])
+                    for cmd in self.commands:
+                        if cmd.id == done_id or cmd.merged_id == done_id:
+                            cmd.done = now
+                            cmd.cancelled = fields[0] == "CANCEL"
+                            if not cmd.cancelled:
+                                cmd.robot_times = [int(f) for f in fields[3:6]]
+
+    def outstanding(self):
+        with self.lock:
+            return [c for c in self.commands if c.sent is not None and (
+                c.acked is None or
+                (c.ack in ("accepted", "coalesced") and c.done is None))]
+
+    def run(self):
+        start = time.monotonic()
+        try:
+            sock = socket.create_connection((self.host, self.port), timeout=60)
+        except OSError as e:
+            self.error = str(e)
+            return
+        self.connect_s = time.monotonic() - start
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        reader = threading.Thread(target=self.read_replies,
+                                  args=(sock.makefile("r"),), daemon=True)
+        reader.start()
+
+        next_send = time.monotonic()
+        for cmd in self.commands:
+            next_send = max(next_send, time.monotonic()) + cmd.delay_ms / 1000
+            time.sleep(max(0, next_send - time.monotonic()))
+            with self.lock:
+                cmd.sent = time.monotonic()
+                self.pending_acks.append(cmd)
+            # Blocks while the robot holds the window closed (backpressure)
+            sock.sendall((cmd.text + "\n").encode())
+            next_send += self.period_s
+
+        # Leave only once served, the next client is accepted after the close
+        deadline = time.monotonic() + self.drain_s
+        while self.outstanding() and time.monotonic() < deadline:
+            time.sleep(0.05)
+        try:
+            sock.sendall(b"close\n")
+        except OSError:
+            pass
+        sock.close()
+
+
+def parse_session(path):
+    commands, target = [], None
+    with open(path) as f:
+        for line in f:
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+            delay = 0
+            if line.startswith("+"):
+                delay_text, _, line = line[1:].partition(" ")
+                delay = int(delay_text)
+            match = TARGET_RE.match(line)
+            if match:
+                line, target = match.group(1), (match.group(2),
+                                                int(match.group(3)))
+            commands.append(Command(line.strip(), delay))
+    return commands, target
+
+
+def synthetic(mix, count, max_times, seed):
+    rng = random.Random(seed)
+    names, weights = [], []
+    for entry in mix.split(","):
+        name, _, weight = entry.partition(":")
+        names.append(name.strip())
+        weights.append(float(weight or 1))
+    return [Command(f"{name} {rng.randint(1, max_times)}")
+            for name in rng.choices(names, weights, k=count)]
+
+
+def percentiles(label, values_s):
+    if not values_s:
+        print(f"{label:20s} no samples")
+        return
+    values = sorted(v * 1000 for v in values_s)
+    p99 = values[min(len(values) - 1, int(len(values) * 0.99))]
+    print(f"{label:20s} n={len(values):5d} min={values[0]:8.1f} "
+          f"p50={statistics.median(values):8.1f} p99={p99:8.1f} "
+          f"max={values[-1]:8.1f} ms")
+
+
+def report(connections, elapsed_s):
+    commands = [c for conn in connections for c in conn.commands]
+    sent = [c for c in commands if c.sent is not None]
+    acks = {}
+    for c in sent:
+        acks[c.ack or "no ack"] = acks.get(c.ack or "no ack", 0) + 1
+    completed = [c for c in sent if c.done is not None and not c.cancelled]
+    cancelled = [c for c in sent if c.cancelled]
+
+    print(f"sent {len(sent)} commands in {elapsed_s:.1f} s "
+          f"({len(sent) / elapsed_s:.2f}/s) on {len(connections)} "
+          "connection(s)")
+    print("acks: " + ", ".join(f"{k}={v}" for k, v in sorted(acks.items())))
+    print(f"completed {len(completed)}, cancelled {len(cancelled)}, "
+          f"dropped {acks.get('full', 0)}, "
+          f"outstanding {sum(len(c.outstanding()) for c in connections)}")
+    percentiles("connect", [c.connect_s for c in connections
+                            if c.connect_s is not None])
+    percentiles("send -> ACK", [c.acked - c.sent for c in sent
+                                if c.acked is not None])
+    percentiles("send -> DONE", [c.done - c.sent for c in completed])
+    percentiles("robot queue wait", [(c.robot_times[1] - c.robot_times[0]) / 1e6
+                                     for c in completed if c.robot_times])
+    percentiles("robot execution", [(c.robot_times[2] - c.robot_times[1]) / 1e6
+                                    for c in completed if c.robot_times])
+    for conn in connections:
+        if conn.error:
+            print(f"connection failed: {conn.error}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--exe", help="native_sim zephyr.exe to launch")
+    parser.add_argument("--host")
+    parser.add_argument("--port", type=int)
+    parser.add_argument("--concurrency", type=int, default=1,
+                        help="client connections, each sending every command")
+    parser.add_argument("--drain-s", type=float, default=60,
+                        help="how long a connection waits for its outstanding "
+                        "DONEs before closing")
+    sub = parser.add_subparsers(dest="mode", required=True)
+    replay = sub.add_parser("replay", help="replay a session file")
+    replay.add_argument("session")
+    replay.add_argument("--rate", type=float, default=0,
+                        help="commands per second and connection, 0 to only "
+                        "follow the delays of the file")
+    synth = sub.add_parser("synthetic", help="random commands")
+    synth.add_argument("--rate", type=float, default=2,
+                       help="commands per second and connection")
+    synth.add_argument("--count", type=int, default=50,
+                       help="commands per connection")
+    synth.add_argument("--mix", default="sf:4,sb:2,tl:1,tr:1,stand:1,wave:1",
+                       help="comma separated command:weight")
+    synth.add_argument("--max-times", type=int, default=3)
+    synth.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    target = None
+    if args.mode == "replay":
+        session, target = parse_session(args.session)
+        if not session:
+            sys.exit(f"no command in {args.session}")
+        workloads = [parse_session(args.session)[0]
+                     for _ in range(args.concurrency)]
+    else:
+        workloads = [synthetic(args.mix, args.count, args.max_times,
+                               args.seed + i)
+                     for i in range(args.concurrency)]
+    host = args.host or (target[0] if target and not args.exe else "127.0.0.1")
+    port = args.port or (target[1] if target else 5000)
+    period_s = 1 / args.rate if args.rate > 0 else 0
+
+    proc = None
+    if args.exe:
+        proc = subprocess.Popen([args.exe, f"--port={port}"],
+                                stdout=subprocess.DEVNULL,
+                                stderr=subprocess.DEVNULL)
+        time.sleep(0.5)
+    try:
+        connections = [Connection(host, port, commands, period_s,
+                                  args.drain_s)
+                       for commands in workloads]
+        start = time.monotonic()
+        for conn in connections:
+            conn.start()
+        for conn in connections:
+            conn.join()
+        report(connections, time.monotonic() - start)
+    finally:
+        if proc is not None:
+            proc.terminate()
+            proc.wait()
+
+
+if __name__ == "__main__":
+    main()
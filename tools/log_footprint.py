@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""Measures what log_production.conf saves: image size and motor tick time.
+
+Builds each of these twice, with the default logging and with the production
+profile (-DEXTRA_CONF_FILE=log_production.conf), then compares:
+- the firmware for the robot board: flash and RAM used by zephyr.elf;
+- the simulated robot with the profiling: the `tick` phase of `prof` while it
+  walks, the cost of a tick without errors;
+- tests/log_limit on native_sim: the `LOG_COST` line, the logging time of a
+  tick where the 12 PWM writes fail, logged each time and with
+  LOG_ERR_LIMITED().
+
+    tools/log_footprint.py
+
+Needs west and the Zephyr SDK; the build directories go in --build-dir.
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+from elftools.elf.constants import SH_FLAGS
+from elftools.elf.elffile import ELFFile
+
+from latency_bench import connect
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+PROFILES = [("default", []),
+            ("production", ["-DEXTRA_CONF_FILE=log_production.conf"])]
+WALK = ["stand", "sf 5", "sb 5", "tl 2", "tr 2", "sit"]
+
+
+def build(board, source, build_dir, cmake_args):
+    cmd = ["west", "build", "-p", "auto", "-d", build_dir, source]
+    if board:
+        cmd += ["-b", board]
+    if cmake_args:
+        cmd += ["--"] + cmake_args
+    subprocess.run(cmd, cwd=ROOT, check=True, stdout=subprocess.DEVNULL)
+    return os.path.join(build_dir, "zephyr")
+
+
+def image_size(elf_path):
+    """(flash, ram) in bytes: the loaded sections, the writable ones in RAM
+    and their initial values in flash as well."""
+    flash = ram = 0
+    with open(elf_path, "rb") as f:
+        for section in ELFFile(f).iter_sections():
+            flags = section["sh_flags"]
+            if not flags & SH_FLAGS.SHF_ALLOC:
+                continue
+            loaded = section["sh_type"] != "SHT_NOBITS"
+            if flags & SH_FLAGS.SHF_WRITE:
+                ram += section["sh_size"]
+                if loaded:
+                    flash += section["sh_size"]
+            elif loaded:
+                flash += section["sh_size"]
+    return flash, ram
+
+
+def tick_phase(exe, port):
+    proc = subprocess.Popen([exe, f"--port={port}"],
+                            stdout=subprocess.DEVNULL,
+                            stderr=subprocess.DEVNULL)
+    try:
+        robot = connect("127.0.0.1", port, 10)
+        robot.send("prof reset")
+        for command in WALK:
+            robot.send(command)
+            robot.read_until("DONE")
+        phases = robot.prof()
+        robot.close()
+    finally:
+        proc.terminate()
+        proc.wait()
+    if "tick" not in phases:
+        sys.exit("no tick reported, is CONFIG_SPIDER_PROFILING set?")
+    return phases["tick"]
+
+
+def log_cost(exe):
+    out = subprocess.run([exe], capture_output=True, text=True,
+                         timeout=60).stdout
+    match = re.search(r"LOG_COST tick_logged_ns=(\d+) tick_limited_ns=(\d+)",
+                      out)
+    if not match:
+        sys.exit(f"{exe}: no LOG_COST line")
+    return int(match[1]), int(match[2])
+
+
+def us(ns):
+    return f"{ns / 1e3:9.1f}"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--board", help="robot board, the CMakeLists.txt one "
+                        "when not given")
+    parser.add_argument("--build-dir", default="build/log_footprint")
+    parser.add_argument("--port", type=int, default=5000)
+    args = parser.parse_args()
+
+    results = {}
+    for name, extra in PROFILES:
+        out = os.path.join(args.build_dir, name)
+        zephyr = build(args.board, ".", os.path.join(out, "robot"), extra)
+        flash, ram = image_size(os.path.join(zephyr, "zephyr.elf"))
+
+        zephyr = build("native_sim", ".", os.path.join(out, "sim"),
+                       ["-DCONF_FILE=prj_native_sim.conf",
+                        "-DCONFIG_SPIDER_PROFILING=y"] + extra)
+        tick = tick_phase(os.path.join(zephyr, "zephyr.exe"), args.port)
+
+        # printk kept off the dictionary backend to read LOG_COST
+        zephyr = build("native_sim", "tests/log_limit",
+                       os.path.join(out, "log_limit"),
+                       ["-DCONFIG_LOG_PRINTK=n"] + extra)
+        logged, limited = log_cost(os.path.join(zephyr, "zephyr.exe"))
+        results[name] = (flash, ram, tick, logged, limited)
+
+    print(f"{'profile':12s} {'flash':>8s} {'ram':>8s} {'tick mean':>9s} "
+          f"{'tick p99':>9s} {'logged':>9s} {'limited':>9s}  (bytes, us)")
+    for name, (flash, ram, tick, logged, limited) in results.items():
+        print(f"{name:12s} {flash:8d} {ram:8d} {us(tick['mean'])} "
+              f"{us(tick['p99'])} {us(logged)} {us(limited)}")
+    base, prod = results["default"], results["production"]
+    print(f"{'saved':12s} {base[0] - prod[0]:8d} {base[1] - prod[1]:8d} "
+          f"{us(base[2]['mean'] - prod[2]['mean'])} "
+          f"{us(base[2]['p99'] - prod[2]['p99'])} "
+          f"{us(base[3] - prod[4])}")
+
+
+if __name__ == "__main__":
+    main()
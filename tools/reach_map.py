@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""Generates the leg workspace reachability map used by set_site().
+
+The inverse kinematics of a leg only depend on the horizontal distance of the
+foot from the hip, w = sqrt(x^2 + y^2) signed by x, and on its height z (the
+coxa angle gamma is always within the servo range). The map is a bitmap over
+a (w, z) grid: a cell is set when the IK of cartesian_to_polar() is defined
+at its corners and centre, so any target inside a set cell can be reached.
+Joint angles beyond the servo range are not rejected: the gestures rely on
+the femur servo saturating (polar_to_servo() clamps them).
+
+    tools/reach_map.py --out reach_map_data.c   # write the table
+    tools/reach_map.py --plot                   # show the workspace
+
+The build generates the table for the configured legs with
+tools/robot_geometry.py; the leg lengths default to the Kconfig ones.
+"""
+
+import argparse
+import math
+import sys
+
+def ik(a, b, c, w, z):
+    """Angles (alpha, beta) in degrees as cartesian_to_polar(), None if the
+    target is out of reach."""
+    v = w - c
+    r2 = v * v + z * z
+    if r2 == 0:
+        return None
+    arg_alpha = (a * a - b * b + r2) / 2 / a / math.sqrt(r2)
+    arg_beta = (a * a + b * b - r2) / 2 / a / b
+    if abs(arg_alpha) > 1 or abs(arg_beta) > 1:
+        return None
+    alpha = math.degrees(math.atan2(z, v) + math.acos(arg_alpha))
+    return alpha, math.degrees(math.acos(arg_beta))
+
+
+def reachable(a, b, c, w, z):
+    return ik(a, b, c, w, z) is not None
+
+
+def build(a, b, c, cell):
+    """Returns (w_min, z_min, cols, rows, cells) with cells[row][col]."""
+    w_max = math.ceil((a + b + c) / cell) * cell
+    z_max = math.ceil((a + b) / cell) * cell
+    cols = int(2 * w_max / cell)
+    rows = int(2 * z_max / cell)
+    cells = []
+    for row in range(rows):
+        z0 = -z_max + row * cell
+        line = []
+        for col in range(cols):
+            w0 = -w_max + col * cell
+            points = [(w0, z0), (w0 + cell, z0), (w0, z0 + cell),
+                      (w0 + cell, z0 + cell),
+                      (w0 + cell / 2, z0 + cell / 2)]
+            line.append(all(reachable(a, b, c, w, z) for w, z in points))
+        cells.append(line)
+    return -w_max, -z_max, cols, rows, cells
+
+
+def write_c(path, args, w_min, z_min, cols, rows, cells):
+    bits = [cells[row][col] for row in range(rows) for col in range(cols)]
+    words = []
+    for i in range(0, len(bits), 32):
+        word = 0
+        for j, bit in enumerate(bits[i:i + 32]):
+            word |= bit << j
+        words.append(word)
+
+    with open(path, "w") as f:
+        f.write("/* Generated by tools/reach_map.py, do not edit. */\n")
+        f.write('#include "reach_map.h"\n\n')
+        f.write("const struct reach_map_info reach_map_info = {\n")
+        f.write(f"    .length_a = {args.length_a},\n")
+        f.write(f"    .length_b = {args.length_b},\n")
+        f.write(f"    .length_c = {args.length_c},\n")
+        f.write(f"    .w_min = {w_min},\n")
+        f.write(f"    .z_min = {z_min},\n")
+        f.write(f"    .cell_mm = {args.cell},\n")
+        f.write(f"    .cols = {cols},\n")
+        f.write(f"    .rows = {rows},\n")
+        f.write("};\n\n")
+        f.write(f"const uint32_t reach_map_bits[{len(words)}] = {{\n")
+        for i in range(0, len(words), 6):
+            f.write("    " + ", ".join(f"0x{w:08x}" for w in words[i:i + 6])
+                    + ",\n")
+        f.write("};\n")
+
+
+def plot(w_min, z_min, cols, rows, cells, cell):
+    print(f"w from {w_min} to {-w_min} mm (columns), z from {-z_min} (top) "
+          f"to {z_min} mm, {cell} mm cells")
+    for row in reversed(range(rows)):
+        print("".join("#" if c else "." for c in cells[row]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--length-a", type=float, default=55.0)
+    parser.add_argument("--length-b", type=float, default=77.5)
+    parser.add_argument("--length-c", type=float, default=27.5)
+    parser.add_argument("--cell", type=int, default=2, help="cell size, mm")
+    parser.add_argument("--out", help="C file to write")
+    parser.add_argument("--plot", action="store_true")
+    args = parser.parse_args()
+
+    w_min, z_min, cols, rows, cells = build(args.length_a, args.length_b,
+                                            args.length_c, args.cell)
+    reachable_cells = sum(map(sum, cells))
+    print(f"{cols}x{rows} cells, {reachable_cells} reachable "
+          f"({100 * reachable_cells / (cols * rows):.1f}%), "
+          f"{(cols * rows + 31) // 32 * 4} bytes", file=sys.stderr)
+    if args.plot:
+        plot(w_min, z_min, cols, rows, cells, args.cell)
+    if args.out:
+        write_c(args.out, args, w_min, z_min, cols, rows, cells)
+
+
+if __name__ == "__main__":
+    main()
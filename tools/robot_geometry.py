@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Generates the robot geometry constants from the Kconfig values.
+
+The dimensions of the robot are declared once, as CONFIG_SPIDER_GEOM_* in
+tenths of mm (Kconfig.spider). This script reads them from the build's .config
+and writes, at build time:
+
+- a header defining them in mm along with the constants derived from them (boot
+  height, turn sites), computed with the formulas init_robot_state() used at
+  boot,
+- the leg workspace map of tools/reach_map.py for the same legs.
+
+    tools/robot_geometry.py --config build/zephyr/.config \\
+        --header robot_geometry.h --reach-map reach_map_data.c
+
+Without --config the Kconfig defaults are used.
+"""
+
+import argparse
+import math
+import os
+import re
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import reach_map  # noqa: E402
+
+# Kconfig suffix and default, in tenths of mm
+GEOMETRY = {
+    "LENGTH_A": 550,
+    "LENGTH_B": 775,
+    "LENGTH_C": 275,
+    "LENGTH_SIDE": 710,
+    "Z_ABSOLUTE": -280,
+    "Z_DEFAULT": -500,
+    "Z_UP": -300,
+    "X_DEFAULT": 620,
+    "X_OFFSET": 0,
+    "Y_START": 0,
+    "Y_STEP": 400,
+}
+
+REACH_MAP_CELL_MM = 2
+
+
+def read_config(path):
+    """Geometry in mm, from the .config file or the defaults."""
+    values = dict(GEOMETRY)
+    if path:
+        with open(path) as f:
+            for line in f:
+                match = re.match(r"CONFIG_SPIDER_GEOM_(\w+)=(-?\d+)$",
+                                 line.strip())
+                if match and match.group(1) in values:
+                    values[match.group(1)] = int(match.group(2))
+    return {name.lower(): value / 10 for name, value in values.items()}
+
+
+def derive(g):
+    """Constants derived from the geometry, as init_robot_state() did."""
+    d = {"z_boot": g["z_absolute"]}
+    val_2x_l = 2.0 * g["x_default"] + g["length_side"]
+
+    d["temp_a"] = math.sqrt(val_2x_l ** 2.0 + g["y_step"] ** 2.0)
+    d["temp_b"] = 2.0 * (g["y_start"] + g["y_step"]) + g["length_side"]
+    d["temp_c"] = math.sqrt(
+        val_2x_l ** 2.0 +
+        (2.0 * g["y_start"] + g["y_step"] + g["length_side"]) ** 2.0)
+    d["temp_alpha"] = math.acos(
+        (d["temp_a"] ** 2.0 + d["temp_b"] ** 2.0 - d["temp_c"] ** 2.0) /
+        (2.0 * d["temp_a"] * d["temp_b"]))
+
+    # Sites of the turn gaits
+    d["turn_x1"] = (d["temp_a"] - g["length_side"]) / 2.0
+    d["turn_y1"] = g["y_start"] + g["y_step"] / 2.0
+    d["turn_x0"] = d["turn_x1"] - d["temp_b"] * math.cos(d["temp_alpha"])
+    d["turn_y0"] = (d["temp_b"] * math.sin(d["temp_alpha"]) - d["turn_y1"] -
+                    g["length_side"])
+    return d
+
+
+def literal(value):
+    return f"({value!r})" if value < 0 else repr(value)
+
+
+def write_header(path, geometry, derived):
+    with open(path, "w") as f:
+        f.write("/* Generated by tools/robot_geometry.py, do not edit. */\n")
+        f.write("#ifndef ROBOT_GEOMETRY_H\n#define ROBOT_GEOMETRY_H\n\n")
+        f.write("/* Declared in Kconfig, mm */\n")
+        for name, value in geometry.items():
+            f.write(f"#define ROBOT_{name.upper()} {literal(value)}\n")
+        f.write("\n/* Derived */\n")
+        for name, value in derived.items():
+            f.write(f"#define ROBOT_{name.upper()} {literal(value)}\n")
+        f.write("\n#endif\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--config", help="the build's .config")
+    parser.add_argument("--header", help="header to write")
+    parser.add_argument("--reach-map", help="workspace map C file to write")
+    args = parser.parse_args()
+
+    geometry = read_config(args.config)
+    derived = derive(geometry)
+    if args.header:
+        write_header(args.header, geometry, derived)
+    if args.reach_map:
+        a, b, c = (geometry[k] for k in ("length_a", "length_b", "length_c"))
+        w_min, z_min, cols, rows, cells = reach_map.build(a, b, c,
+                                                          REACH_MAP_CELL_MM)
+        map_args = argparse.Namespace(length_a=a, length_b=b, length_c=c,
+                                      cell=REACH_MAP_CELL_MM)
+        reach_map.write_c(args.reach_map, map_args, w_min, z_min, cols, rows,
+                          cells)
+    if not args.header and not args.reach_map:
+        for name, value in {**geometry, **derived}.items():
+            print(f"{name:12s} {value:.4f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""Measures how well scheduled commands start in lockstep across robots.
+
+Launches several native_sim robots on the same host (one TCP port each),
+estimates each robot clock offset with the `sync` exchange, schedules the same
+command on all of them at a common host instant with `@<uptime_us>` and
+compares the start times reported in their DONE events.
+
+    west build -b native_sim -- -DCONF_FILE=prj_native_sim.conf
+    tools/sync_check.py --exe build/zephyr/zephyr.exe --robots 3
+"""
+
+import argparse
+import socket
+import statistics
+import subprocess
+import sys
+import time
+
+
+def host_us():
+    return time.monotonic_ns() // 1000
+
+
+class Robot:
+    def __init__(self, host, port):
+        self.port = port
+        self.sock = socket.create_connection((host, port), timeout=10)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.lines = self.sock.makefile("r")
+        self.offset_us = 0
+        self.rtt_us = 0
+
+    def send(self, line):
+        self.sock.sendall((line + "\n").encode())
+
+    def read_until(self, prefix):
+        while True:
+            line = self.lines.readline()
+            if not line:
+                raise ConnectionError(f"robot on port {self.port} closed")
+            if line.startswith(prefix):
+                return line.split()
+
+    def sync(self, samples):
+        """NTP style offset (robot - host), kept from the fastest round trip."""
+        best = None
+        for _ in range(samples):
+            t1 = host_us()
+            self.send(f"sync {t1}")
+            _, echoed, t2, t3 = self.read_until("SYNC")
+            t4 = host_us()
+            assert int(echoed) == t1
+            t2, t3 = int(t2), int(t3)
+            rtt = (t4 - t1) - (t3 - t2)
+            offset = ((t2 - t1) + (t3 - t4)) // 2
+            if best is None or rtt < best[0]:
+                best = (rtt, offset)
+        self.rtt_us, self.offset_us = best
+
+    def close(self):
+        self.send("close")
+        self.sock.close()
+
+
+def connect(host, port, timeout_s):
+    deadline = time.monotonic() + timeout_s
+    while True:
+        try:
+            return Robot(host, port)
+        except OSError:
+            if time.monotonic() > deadline:
+                raise
+            time.sleep(0.1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--exe", help="native_sim zephyr.exe to launch")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--robots", type=int, default=3)
+    parser.add_argument("--base-port", type=int, default=5000)
+    parser.add_argument("--samples", type=int, default=16,
+                        help="sync exchanges per robot")
+    parser.add_argument("--lead-ms", type=int, default=500,
+                        help="how far in the future commands are scheduled")
+    parser.add_argument("--runs", type=int, default=5)
+    parser.add_argument("--command", default="sf 1")
+    args = parser.parse_args()
+
+    procs = []
+    if args.exe:
+        for i in range(args.robots):
+            procs.append(subprocess.Popen(
+                [args.exe, f"--port={args.base_port + i}"],
+                stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL))
+
+    try:
+        robots = [connect(args.host, args.base_port + i, 10)
+                  for i in range(args.robots)]
+        spreads = []
+        for run in range(args.runs):
+            for robot in robots:
+                robot.sync(args.samples)
+
+            target = host_us() + args.lead_ms * 1000
+            for robot in robots:
+                robot.send(f"{args.command} @{target + robot.offset_us}")
+            starts = []
+            for robot in robots:
+                ack = robot.read_until("ACK")
+                if ack[2] != "accepted":
+                    sys.exit(f"port {robot.port}: {' '.join(ack)}")
+                done = robot.read_until("DONE")
+                starts.append(int(done[4]) - robot.offset_us)
+
+            errors = [s - target for s in starts]
+            spread = max(starts) - min(starts)
+            spreads.append(spread)
+            print(f"run {run}: spread {spread} us, start error "
+                  + ", ".join(f"{e:+d}" for e in errors) + " us, rtt "
+                  + ", ".join(str(r.rtt_us) for r in robots) + " us")
+
+        print(f"spread over {args.runs} runs: "
+              f"mean {statistics.mean(spreads):.0f} us, max {max(spreads)} us")
+        for robot in robots:
+            robot.close()
+    finally:
+        for proc in procs:
+            proc.terminate()
+            proc.wait()
+
+
+if __name__ == "__main__":
+    main()